@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "render_context.h"
+#include "program_cache.h"
+#include "gpu_profiler.h"
+#include "state_cache.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+#include "resource.h"
+#include "vertex_compression.h"
+#include "trace.h"
+
+// opengl_bench: renders a fixed scene for N warmup and M measured frames at a fixed resolution with
+// vsync off and reports CPU frame time percentiles, GPU time, draw calls and triangles as JSON.
+// runs headless by default (EGL/OSMesa, e.g. Mesa llvmpipe on CI) so it can gate merges.
+//
+// usage: opengl_bench [--warmup N] [--frames M] [--width W] [--height H] [--objects K]
+//                     [--path naive|queue|mdi] [--vertex-format fp32|compressed] [--window]
+//                     [--headless-backend egl|osmesa] [--out file.json]
+//   naive: one glUniform + glDrawElements per object in submission order
+//   queue: objects go through the sort-keyed RenderQueue
+//   mdi:   the RenderQueue in batched mode, one glMultiDrawElementsIndirect for the whole grid
+//   --vertex-format: MeshVertex (48 bytes) or CompressedVertex (20 bytes) vertices
+
+namespace {
+  struct BenchOptions {
+    unsigned int warmupFrames = 60;
+    unsigned int measuredFrames = 600;
+    int width = 1280;
+    int height = 720;
+    unsigned int objects = 1024;
+    std::string path = "naive";
+    std::string vertexFormat = "compressed";
+    bool window = false;
+    std::string headlessBackend;
+    std::string outPath;
+  };
+
+  struct Percentiles {
+    double mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+    size_t samples = 0;
+  };
+
+  Percentiles computePercentiles(std::vector<double> values) {
+    Percentiles result;
+    if (values.empty())
+      return result;
+    std::sort(values.begin(), values.end());
+    auto at = [&](double p) { return values[std::min(values.size() - 1, static_cast<size_t>(std::ceil(p * values.size())) - 1)]; };
+    double sum = 0;
+    for (double v : values)
+      sum += v;
+    result.mean = sum / values.size();
+    result.p50 = at(0.50);
+    result.p95 = at(0.95);
+    result.p99 = at(0.99);
+    result.max = values.back();
+    result.samples = values.size();
+    return result;
+  }
+
+  std::string percentilesJson(const Percentiles& p) {
+    char buffer[192];
+    std::snprintf(buffer, sizeof(buffer), "{\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"samples\": %zu}",
+                  p.mean, p.p50, p.p95, p.p99, p.max, p.samples);
+    return buffer;
+  }
+
+  bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--warmup" && hasValue)
+        options.warmupFrames = std::stoul(argv[++i]);
+      else if (arg == "--frames" && hasValue)
+        options.measuredFrames = std::stoul(argv[++i]);
+      else if (arg == "--width" && hasValue)
+        options.width = std::stoi(argv[++i]);
+      else if (arg == "--height" && hasValue)
+        options.height = std::stoi(argv[++i]);
+      else if (arg == "--objects" && hasValue)
+        options.objects = std::max(1ul, std::stoul(argv[++i]));
+      else if (arg == "--path" && hasValue)
+        options.path = argv[++i];
+      else if (arg == "--vertex-format" && hasValue)
+        options.vertexFormat = argv[++i];
+      else if (arg == "--window")
+        options.window = true;
+      else if (arg == "--headless-backend" && hasValue)
+        options.headlessBackend = argv[++i];
+      else if (arg == "--out" && hasValue)
+        options.outPath = argv[++i];
+      else {
+        std::cout << "Unknown option " << arg << std::endl;
+        return false;
+      }
+    }
+    if (options.path != "naive" && options.path != "queue" && options.path != "mdi") {
+      std::cout << "Unknown path " << options.path << std::endl;
+      return false;
+    }
+    if (options.vertexFormat != "fp32" && options.vertexFormat != "compressed") {
+      std::cout << "Unknown vertex format " << options.vertexFormat << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // scene: a grid of quads, one draw call each
+  class QuadGridScene {
+  public:
+    QuadGridScene(unsigned int objects, ProgramBinaryCache& cache, bool batched, bool compressed) : objects(objects) {
+      // the batched vertex shader reads the per-object offset from the queue's draw data buffer, through
+      // the extension's gl_BaseInstanceARB or, on 4.6 without it, the core gl_BaseInstance
+      const char* batchedShader = GLAD_GL_ARB_shader_draw_parameters ? "bench_mdi.vert" : "bench_mdi_460.vert";
+      program = cache.createProgram({{batched ? batchedShader : "bench.vert", GL_VERTEX_SHADER}, {"quad.frag", GL_FRAGMENT_SHADER}});
+      offsetScaleLocation = glGetUniformLocation(program, "uOffsetScale");
+
+      MeshVertex vertices[] = {
+        {{ 0.5f,  0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+        {{ 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+        {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+        {{-0.5f,  0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}}
+      };
+      unsigned int indices[] = {0, 1, 3, 1, 2, 3};
+      // the position decode is folded into each object's offset/scale, so both formats share the shaders
+      PositionDecode decode = {0.0f, 0.0f, 0.0f, 1.0f};
+      if (compressed) {
+        CompressedVertex compressedVertices[4];
+        decode = compressVertices(vertices, 4, compressedVertices);
+        vertexBuffer = Buffer(sizeof(compressedVertices), compressedVertices, 0);
+        vertexArray.setVertexBuffer(0, vertexBuffer, 0, sizeof(CompressedVertex));
+        vertexArray.setAttributes(0, vertexLayout<CompressedVertex>());
+        bytesPerVertex = sizeof(CompressedVertex);
+      } else {
+        vertexBuffer = Buffer(sizeof(vertices), vertices, 0);
+        vertexArray.setVertexBuffer(0, vertexBuffer, 0, sizeof(MeshVertex));
+        vertexArray.setAttributes(0, vertexLayout<MeshVertex>());
+        bytesPerVertex = sizeof(MeshVertex);
+      }
+      indexBuffer = Buffer(sizeof(indices), indices, 0);
+      vertexArray.setIndexBuffer(indexBuffer);
+
+      unsigned int columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(objects))));
+      float cell = 2.0f / columns;
+      for (unsigned int i = 0; i < objects; i++) {
+        float x = -1.0f + cell * (i % columns + 0.5f);
+        float y = -1.0f + cell * (i / columns + 0.5f);
+        float scale = cell * 0.8f;
+        offsetScale.push_back({x + decode[0] * scale, y + decode[1] * scale, scale * decode[3], scale * decode[3]});
+      }
+    }
+
+    ~QuadGridScene() {
+      glDeleteProgram(program);
+    }
+
+    void render(StateCache& state) {
+      glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      state.useProgram(program);
+      state.bindVertexArray(vertexArray.id());
+      for (auto& os : offsetScale) {
+        glUniform4f(offsetScaleLocation, os[0], os[1], os[2], os[3]);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      }
+      drawCalls = objects;
+      apiDrawCalls = objects;
+      triangles = objects * 2ull;
+    }
+
+    void renderQueued(StateCache& state, RenderQueue& queue) {
+      if (material == ~0u)
+        material = queue.addMaterial({program});
+      glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      DrawPacket packet;
+      packet.material = material;
+      packet.vao = vertexArray.id();
+      packet.indexCount = 6;
+      packet.uniformLocation = offsetScaleLocation;
+      for (unsigned int i = 0; i < objects; i++) {
+        packet.uniform = offsetScale[i];
+        // scattered depths so the sort has something to do
+        packet.depth = static_cast<float>((i * 2654435761u) & 0xFFFF) / 65535.0f;
+        queue.submit(RenderQueue::Opaque, packet);
+      }
+      queue.execute(state);
+      drawCalls = objects;
+      apiDrawCalls = queue.lastStats().drawCalls;
+      triangles = objects * 2ull;
+    }
+
+    const char* name() const { return "quad_grid"; }
+    // draws the scene consists of, and the GL draw calls it took to issue them
+    unsigned long long drawCalls = 0;
+    unsigned long long apiDrawCalls = 0;
+    unsigned long long triangles = 0;
+    size_t bytesPerVertex = 0;
+
+  private:
+    unsigned int objects;
+    unsigned int program;
+    int offsetScaleLocation;
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    VertexArray vertexArray;
+    std::vector<std::array<float, 4>> offsetScale;
+    uint32_t material = ~0u;
+  };
+}
+
+int main(int argc, char* argv[])
+{
+  BenchOptions options;
+  if (!parseOptions(argc, argv, options))
+    return -1;
+
+  ContextSettings contextSettings;
+  contextSettings.width = options.width;
+  contextSettings.height = options.height;
+  contextSettings.title = "opengl_bench";
+  contextSettings.headlessBackend = options.headlessBackend;
+  contextSettings.maxFrames = 0;
+  std::unique_ptr<RenderContext> context = options.window ? createWindowContext(contextSettings) : createHeadlessContext(contextSettings);
+  if (!context)
+    return -1;
+  // vsync off, the benchmark measures how fast frames can be produced
+  context->setSwapInterval(0);
+  int width, height;
+  context->framebufferSize(width, height);
+  glViewport(0, 0, width, height);
+
+  std::vector<double> cpuFrameMs, gpuFrameMs;
+  unsigned long long drawCalls = 0, apiDrawCalls = 0, triangles = 0;
+  {
+    ProgramBinaryCache programCache(SHADER_CACHE_PATH);
+    RenderQueue renderQueue;
+    bool queued = options.path != "naive";
+    if (options.path == "mdi" && !renderQueue.setBatching(true)) {
+      std::cout << "ERROR::BENCH::MDI_NOT_SUPPORTED needs GL 4.6, or 4.3 / ARB_multi_draw_indirect and ARB_shader_draw_parameters" << std::endl;
+      return -1;
+    }
+    // commands and per-object data of the batched path are streamed through a persistent mapping
+    std::unique_ptr<StreamBuffer> streamBuffer;
+    if (renderQueue.batching()) {
+      streamBuffer = std::make_unique<StreamBuffer>(options.objects * (5 * sizeof(uint32_t) + 4 * sizeof(float)) + 1024);
+      renderQueue.setStreamBuffer(streamBuffer.get());
+    }
+    QuadGridScene scene(options.objects, programCache, renderQueue.batching(), options.vertexFormat == "compressed");
+    // GPU frame times come from the profiler's timestamp ring, read back a few frames late
+    GpuProfiler gpuProfiler;
+    StateCache stateCache;
+    StateCache::Counters warmupStateCalls;
+    gpuProfiler.setReportInterval(0.0);
+    gpuProfiler.setFrameCallback([&](unsigned long long frame, double ms) {
+      if (frame >= options.warmupFrames)
+        gpuFrameMs.push_back(ms);
+    });
+
+    glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer());
+    for (unsigned int frame = 0; frame < options.warmupFrames + options.measuredFrames; frame++) {
+      bool measured = frame >= options.warmupFrames;
+      auto start = std::chrono::steady_clock::now();
+      gpuProfiler.beginFrame();
+      stateCache.beginFrame();
+      // the totals so far are the warmup frames'
+      if (frame == options.warmupFrames)
+        warmupStateCalls = stateCache.total();
+      if (streamBuffer)
+        streamBuffer->beginFrame();
+      if (queued)
+        scene.renderQueued(stateCache, renderQueue);
+      else
+        scene.render(stateCache);
+      if (streamBuffer)
+        streamBuffer->endFrame();
+      gpuProfiler.endFrame();
+      context->present();
+      // headless presents don't throttle, finishing keeps the frames from piling up in the driver
+      if (!context->window())
+        glFinish();
+      context->pollEvents();
+      auto stop = std::chrono::steady_clock::now();
+      if (measured)
+        cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    gpuProfiler.flush();
+    // closes the last frame into the totals
+    stateCache.beginFrame();
+    double measuredFrames = std::max(options.measuredFrames, 1u);
+    double stateCallsIssued = (stateCache.total().issued - warmupStateCalls.issued) / measuredFrames;
+    double stateCallsSkipped = (stateCache.total().skipped - warmupStateCalls.skipped) / measuredFrames;
+    drawCalls = scene.drawCalls;
+    apiDrawCalls = scene.apiDrawCalls;
+    triangles = scene.triangles;
+
+    Percentiles cpu = computePercentiles(cpuFrameMs);
+    Percentiles gpu = computePercentiles(gpuFrameMs);
+    std::string json = "{\n";
+    json += "  \"scene\": \"" + std::string(scene.name()) + "\",\n";
+    json += "  \"path\": \"" + options.path + "\",\n";
+    json += "  \"vertex_format\": \"" + options.vertexFormat + "\",\n";
+    json += "  \"bytes_per_vertex\": " + std::to_string(scene.bytesPerVertex) + ",\n";
+    json += "  \"backend\": \"" + std::string(context->backendName()) + "\",\n";
+    json += "  \"gl_renderer\": \"" + jsonEscape(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + "\",\n";
+    json += "  \"gl_version\": \"" + jsonEscape(reinterpret_cast<const char*>(glGetString(GL_VERSION))) + "\",\n";
+    json += "  \"width\": " + std::to_string(width) + ",\n";
+    json += "  \"height\": " + std::to_string(height) + ",\n";
+    json += "  \"warmup_frames\": " + std::to_string(options.warmupFrames) + ",\n";
+    json += "  \"measured_frames\": " + std::to_string(options.measuredFrames) + ",\n";
+    json += "  \"cpu_frame_ms\": " + percentilesJson(cpu) + ",\n";
+    json += "  \"gpu_frame_ms\": " + percentilesJson(gpu) + ",\n";
+    json += "  \"draw_calls_per_frame\": " + std::to_string(drawCalls) + ",\n";
+    if (streamBuffer)
+      json += "  \"stream_buffer_stalls\": " + std::to_string(streamBuffer->stalls()) + ",\n";
+    json += "  \"api_draw_calls_per_frame\": " + std::to_string(apiDrawCalls) + ",\n";
+    json += "  \"draws_per_second\": " + std::to_string(cpu.mean > 0 ? static_cast<unsigned long long>(drawCalls * 1000.0 / cpu.mean) : 0) + ",\n";
+    json += "  \"triangles_per_frame\": " + std::to_string(triangles) + ",\n";
+    json += "  \"state_calls_issued_per_frame\": " + std::to_string(stateCallsIssued) + ",\n";
+    json += "  \"state_calls_skipped_per_frame\": " + std::to_string(stateCallsSkipped) + "\n";
+    json += "}\n";
+    std::cout << json;
+    if (!options.outPath.empty()) {
+      std::ofstream file(options.outPath, std::ios::trunc);
+      file << json;
+      if (!file.good()) {
+        std::cout << "ERROR::BENCH::CANNOT_WRITE " << options.outPath << std::endl;
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+    glad extension lookup microbenchmark
+
+    Runs gladLoadGLLoader against a fake driver that only implements
+    glGetString/glGetIntegerv/glGetStringi and reports a configurable number of
+    extensions, so the cost of find_extensionsGL can be measured without a GL
+    context. Every other entry point resolves to NULL, which leaves the
+    extension queries as the dominant cost.
+
+    400 extensions take about 120 us per load in the default (unoptimized)
+    build and about 40 us at -O2, against about 1150 us and 850 us for the
+    strcmp scan it replaced.
+
+    usage: glad_ext_bench [extension count] [iterations]
+*/
+#include <glad/glad.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_FAKE_EXTS 4096
+
+static char fake_exts[MAX_FAKE_EXTS][64];
+static int num_fake_exts = 400;
+
+static const GLubyte* APIENTRY fake_glGetString(GLenum name) {
+    return (const GLubyte*)(name == GL_VERSION ? "4.6.0 glad_ext_bench" : "glad_ext_bench");
+}
+
+static const GLubyte* APIENTRY fake_glGetStringi(GLenum name, GLuint index) {
+    (void)name;
+    return (const GLubyte*)fake_exts[index];
+}
+
+static void APIENTRY fake_glGetIntegerv(GLenum name, GLint *data) {
+    *data = name == GL_NUM_EXTENSIONS ? num_fake_exts : 0;
+}
+
+static void* fake_load(const char *name) {
+    if(strcmp(name, "glGetString") == 0) return (void*)fake_glGetString;
+    if(strcmp(name, "glGetStringi") == 0) return (void*)fake_glGetStringi;
+    if(strcmp(name, "glGetIntegerv") == 0) return (void*)fake_glGetIntegerv;
+    return NULL;
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 1000;
+    int i;
+    double start, elapsed;
+
+    if(argc > 1) num_fake_exts = atoi(argv[1]);
+    if(argc > 2) iterations = atoi(argv[2]);
+    if(num_fake_exts < 2 || num_fake_exts > MAX_FAKE_EXTS || iterations < 1) {
+        printf("usage: glad_ext_bench [extension count 2..%d] [iterations]\n", MAX_FAKE_EXTS);
+        return 1;
+    }
+
+    /* mostly names glad doesn't know, plus two real ones at both ends of the list */
+    for(i = 0; i < num_fake_exts; i++) {
+        snprintf(fake_exts[i], sizeof(fake_exts[i]), "GL_VENDOR_benchmark_extension_%d", i);
+    }
+    strcpy(fake_exts[0], "GL_ARB_buffer_storage");
+    strcpy(fake_exts[num_fake_exts - 1], "GL_KHR_debug");
+
+    start = now_us();
+    for(i = 0; i < iterations; i++) {
+        if(!gladLoadGLLoader((GLADloadproc)fake_load)) {
+            printf("gladLoadGLLoader failed\n");
+            return 1;
+        }
+    }
+    elapsed = now_us() - start;
+
+    if(!GLAD_GL_ARB_buffer_storage || !GLAD_GL_KHR_debug || GLAD_GL_KHR_parallel_shader_compile) {
+        printf("extension detection is wrong\n");
+        return 1;
+    }
+    printf("{\"extensions\": %d, \"iterations\": %d, \"us_per_load\": %.2f}\n",
+        num_fake_exts, iterations, elapsed / iterations);
+    return 0;
+}
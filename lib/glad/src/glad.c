@@ -768,7 +768,12 @@ int gladLoadGL(void) {
 
     if(open_gl()) {
         status = gladLoadGLLoader(&get_proc);
+#ifdef GLAD_LAZY_LOAD
+        /* lazy trampolines keep resolving through get_proc, libGL stays open */
+        (void)close_gl;
+#else
         close_gl();
+#endif
     }
 
     return status;
@@ -783,38 +788,93 @@ struct gladGLversionStruct GLVersion = { 0, 0 };
 static int max_loaded_major;
 static int max_loaded_minor;
 
-static const char *exts = NULL;
-static int num_exts_i = 0;
-static char **exts_i = NULL;
+/* Extension lookup: get_exts copies every extension name into one arena
+ * allocation and indexes it with an open addressing hash set, so each of the
+ * several hundred has_ext queries in find_extensionsGL is O(1) instead of a
+ * linear scan over all extensions the driver reports. */
+static char *exts_arena = NULL;
+static const char **exts_set = NULL;
+static unsigned int exts_set_mask = 0;
+
+static unsigned int hash_ext(const char *ext, size_t *len) {
+    /* FNV-1a */
+    unsigned int hash = 2166136261u;
+    const char *c = ext;
+    while(*c != '\0' && *c != ' ') {
+        hash ^= (unsigned char)*c++;
+        hash *= 16777619u;
+    }
+    *len = (size_t)(c - ext);
+    return hash;
+}
+
+static int alloc_exts(int count, size_t bytes) {
+    unsigned int size = 16;
+    while(size < (unsigned int)count * 2) size <<= 1;
+    /* hash slots first so they stay pointer aligned, name bytes behind them */
+    exts_arena = (char*)calloc(1, size * sizeof(*exts_set) + bytes);
+    if(exts_arena == NULL) return 0;
+    exts_set = (const char **)exts_arena;
+    exts_set_mask = size - 1;
+    return 1;
+}
+
+static void insert_ext(const char *ext) {
+    size_t len;
+    unsigned int slot = hash_ext(ext, &len) & exts_set_mask;
+    while(exts_set[slot] != NULL) {
+        if(strcmp(exts_set[slot], ext) == 0) return;
+        slot = (slot + 1) & exts_set_mask;
+    }
+    exts_set[slot] = ext;
+}
 
 static int get_exts(void) {
+    char *str;
+    int index;
+    int count = 0;
+    size_t bytes = 0;
 #ifdef _GLAD_IS_SOME_NEW_VERSION
     if(max_loaded_major < 3) {
 #endif
-        exts = (const char *)glGetString(GL_EXTENSIONS);
-#ifdef _GLAD_IS_SOME_NEW_VERSION
-    } else {
-        int index;
-
-        num_exts_i = 0;
-        glGetIntegerv(GL_NUM_EXTENSIONS, &num_exts_i);
-        if (num_exts_i > 0) {
-            exts_i = (char **)malloc((size_t)num_exts_i * (sizeof *exts_i));
+        const char *exts = (const char *)glGetString(GL_EXTENSIONS);
+        const char *c;
+        if(exts == NULL) return 0;
+        bytes = strlen(exts) + 1;
+        for(c = exts; *c != '\0'; c++) {
+            if(*c != ' ' && (c == exts || *(c - 1) == ' ')) count++;
         }
+        if(!alloc_exts(count, bytes)) return 0;
 
-        if (exts_i == NULL) {
-            return 0;
+        /* split the space separated list in place inside the arena */
+        str = exts_arena + (exts_set_mask + 1) * sizeof(*exts_set);
+        memcpy(str, exts, bytes);
+        for(index = 0; str[index] != '\0'; index++) {
+            if(str[index] == ' ') {
+                str[index] = '\0';
+            } else if(index == 0 || str[index - 1] == '\0') {
+                insert_ext(str + index);
+            }
         }
-
-        for(index = 0; index < num_exts_i; index++) {
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    } else {
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        if(count < 0) count = 0;
+        for(index = 0; index < count; index++) {
             const char *gl_str_tmp = (const char*)glGetStringi(GL_EXTENSIONS, index);
-            size_t len = strlen(gl_str_tmp);
+            if(gl_str_tmp != NULL) bytes += strlen(gl_str_tmp) + 1;
+        }
+        if(!alloc_exts(count, bytes)) return 0;
 
-            char *local_str = (char*)malloc((len+1) * sizeof(char));
-            if(local_str != NULL) {
-                memcpy(local_str, gl_str_tmp, (len+1) * sizeof(char));
-            }
-            exts_i[index] = local_str;
+        str = exts_arena + (exts_set_mask + 1) * sizeof(*exts_set);
+        for(index = 0; index < count; index++) {
+            const char *gl_str_tmp = (const char*)glGetStringi(GL_EXTENSIONS, index);
+            size_t len;
+            if(gl_str_tmp == NULL) continue;
+            len = strlen(gl_str_tmp) + 1;
+            memcpy(str, gl_str_tmp, len);
+            insert_ext(str);
+            str += len;
         }
     }
 #endif
@@ -822,55 +882,24 @@ static int get_exts(void) {
 }
 
 static void free_exts(void) {
-    if (exts_i != NULL) {
-        int index;
-        for(index = 0; index < num_exts_i; index++) {
-            free((char *)exts_i[index]);
-        }
-        free((void *)exts_i);
-        exts_i = NULL;
-    }
+    free((void *)exts_arena);
+    exts_arena = NULL;
+    exts_set = NULL;
+    exts_set_mask = 0;
 }
 
 static int has_ext(const char *ext) {
-#ifdef _GLAD_IS_SOME_NEW_VERSION
-    if(max_loaded_major < 3) {
-#endif
-        const char *extensions;
-        const char *loc;
-        const char *terminator;
-        extensions = exts;
-        if(extensions == NULL || ext == NULL) {
-            return 0;
-        }
-
-        while(1) {
-            loc = strstr(extensions, ext);
-            if(loc == NULL) {
-                return 0;
-            }
-
-            terminator = loc + strlen(ext);
-            if((loc == extensions || *(loc - 1) == ' ') &&
-                (*terminator == ' ' || *terminator == '\0')) {
-                return 1;
-            }
-            extensions = terminator;
-        }
-#ifdef _GLAD_IS_SOME_NEW_VERSION
-    } else {
-        int index;
-        if(exts_i == NULL) return 0;
-        for(index = 0; index < num_exts_i; index++) {
-            const char *e = exts_i[index];
+    size_t len;
+    unsigned int slot;
+    if(exts_set == NULL || ext == NULL) return 0;
 
-            if(exts_i[index] != NULL && strcmp(e, ext) == 0) {
-                return 1;
-            }
+    slot = hash_ext(ext, &len) & exts_set_mask;
+    while(exts_set[slot] != NULL) {
+        if(strcmp(exts_set[slot], ext) == 0) {
+            return 1;
         }
+        slot = (slot + 1) & exts_set_mask;
     }
-#endif
-
     return 0;
 }
 int GLAD_GL_VERSION_1_0 = 0;
@@ -9792,7 +9821,19 @@ static void find_coreGL(void) {
 	}
 }
 
+#ifdef GLAD_LAZY_LOAD
+/* glad_lazy.c */
+void* glad_lazy_trampoline(const char *name);
+GLADloadproc glad_lazy_loader = NULL;
+#endif
+
 int gladLoadGLLoader(GLADloadproc load) {
+#ifdef GLAD_LAZY_LOAD
+	/* the load_GL_* groups below install trampolines instead of resolving,
+	 * the real pointer is looked up through glad_lazy_loader on first call */
+	glad_lazy_loader = load;
+	load = (GLADloadproc)glad_lazy_trampoline;
+#endif
 	GLVersion.major = 0; GLVersion.minor = 0;
 	glGetString = (PFNGLGETSTRINGPROC)load("glGetString");
 	if(glGetString == NULL) return 0;
@@ -0,0 +1,8 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+// xy = offset, zw = scale of this object in clip space
+uniform vec4 uOffsetScale;
+void main()
+{
+  gl_Position = vec4(aPos.xy * uOffsetScale.zw + uOffsetScale.xy, aPos.z, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout (location = 0) in vec3 aPos;
+// per-draw data of the batched render queue, indexed by the baseInstance of the indirect command
+// xy = offset, zw = scale of this object in clip space
+layout (std430, binding = 0) readonly buffer DrawData {
+  vec4 drawData[];
+};
+void main()
+{
+  vec4 offsetScale = drawData[gl_BaseInstanceARB];
+  gl_Position = vec4(aPos.xy * offsetScale.zw + offsetScale.xy, aPos.z, 1.0);
+}
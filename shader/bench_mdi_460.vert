@@ -0,0 +1,12 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+// per-draw data of the batched render queue, indexed by the baseInstance of the indirect command
+// xy = offset, zw = scale of this object in clip space
+layout (std430, binding = 0) readonly buffer DrawData {
+  vec4 drawData[];
+};
+void main()
+{
+  vec4 offsetScale = drawData[gl_BaseInstance];
+  gl_Position = vec4(aPos.xy * offsetScale.zw + offsetScale.xy, aPos.z, 1.0);
+}
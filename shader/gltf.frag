@@ -0,0 +1,20 @@
+#version 410 core
+// material factors, 3 texels per material (gltf_loader.h)
+uniform samplerBuffer uMaterials;
+// the material's base color texture, white without one
+uniform sampler2D uBaseColorTexture;
+in vec3 vNormal;
+in vec2 vUV;
+flat in int vMaterial;
+out vec4 FragColor;
+
+void main()
+{
+  vec4 baseColor = texelFetch(uMaterials, vMaterial * 3) * texture(uBaseColorTexture, vUV);
+  vec4 emissive = texelFetch(uMaterials, vMaterial * 3 + 1);
+  if (baseColor.a < emissive.w)
+    discard;
+  // one directional light from the viewer's upper left, both faces lit
+  float diffuse = abs(dot(normalize(vNormal), normalize(vec3(-0.4, 0.6, 0.7))));
+  FragColor = vec4(baseColor.rgb * (0.25 + 0.75 * diffuse) + emissive.rgb, baseColor.a);
+}
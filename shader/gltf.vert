@@ -0,0 +1,54 @@
+#version 410 core
+#ifdef COMPRESSED_VERTEX
+// cooked scene (cooked_mesh.h): CompressedVertex, the node matrix includes the mesh's position decode
+layout (location = 0) in vec4 aPosition;
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aTangent;
+layout (location = 3) in vec2 aUV;
+#else
+// glTF primitive as stored in the file (gltf_loader.h), attributes of any float or normalized type
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec4 aTangent;
+layout (location = 3) in vec2 aUV;
+#endif
+// world matrices, 4 texels (columns) per node
+uniform samplerBuffer uNodes;
+// x = node, y = material
+uniform vec4 uDraw;
+// xyz = scene bounds center, w = 1 / bounds radius
+uniform vec4 uSceneFit;
+out vec3 vNormal;
+out vec2 vUV;
+flat out int vMaterial;
+
+#ifdef COMPRESSED_VERTEX
+vec3 octahedralDecode(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+  return normalize(n);
+}
+#endif
+
+void main()
+{
+  int node = int(uDraw.x) * 4;
+  mat4 world = mat4(texelFetch(uNodes, node), texelFetch(uNodes, node + 1), texelFetch(uNodes, node + 2), texelFetch(uNodes, node + 3));
+#ifdef COMPRESSED_VERTEX
+  vec3 normal = octahedralDecode(aNormal);
+  vec3 local = aPosition.xyz;
+#else
+  // a primitive without normals reads the generic attribute (0, 0, 0)
+  vec3 normal = dot(aNormal, aNormal) > 0.0 ? aNormal : vec3(0.0, 0.0, 1.0);
+  vec3 local = aPosition;
+#endif
+  vNormal = normalize(mat3(world) * normal);
+  // glTF images start at the top row, textures at the bottom one
+  vUV = vec2(aUV.x, 1.0 - aUV.y);
+  vMaterial = int(uDraw.y);
+  // orthographic view down -z that fits the scene bounds
+  vec3 position = ((world * vec4(local, 1.0)).xyz - uSceneFit.xyz) * uSceneFit.w;
+  gl_Position = vec4(position.xy, -position.z, 1.0);
+}
@@ -1,6 +1,28 @@
 #version 410 core
-layout (location = 0) in vec3 aPos;
+// compressed vertex (vertex_compression.h): snorm16 position relative to the mesh bounds with the
+// tangent sign in w, octahedral normal and tangent, half float uv
+layout (location = 0) in vec4 aPosition;
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aTangent;
+layout (location = 3) in vec2 aUV;
+// xyz = bounds center, w = scale
+uniform vec4 uPositionDecode;
+out vec3 vNormal;
+out vec4 vTangent;
+out vec2 vUV;
+
+vec3 octahedralDecode(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+  return normalize(n);
+}
+
 void main()
 {
-  gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
-}
\ No newline at end of file
+  vNormal = octahedralDecode(aNormal);
+  vTangent = vec4(octahedralDecode(aTangent), aPosition.w < 0.0 ? -1.0 : 1.0);
+  vUV = aUV;
+  gl_Position = vec4(aPosition.xyz * uPositionDecode.w + uPositionDecode.xyz, 1.0);
+}
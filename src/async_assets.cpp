@@ -0,0 +1,162 @@
+#include "async_assets.h"
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "cpu_profiler.h"
+#include "mapped_file.h"
+// declarations only, the implementation is compiled with tinygltf (gltf_loader.cpp)
+#include "stb_image.h"
+
+namespace {
+  // bytes a job faults in at once
+  constexpr size_t PREFETCH_BYTES = 1 << 20;
+
+  // stb_image starts at the top row, GL at the bottom one
+  std::vector<uint8_t> bottomRowFirst(const stbi_uc* decoded, int width, int height) {
+    size_t row = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> texels(row * height);
+    for (int y = 0; y < height; y++)
+      std::memcpy(texels.data() + row * (height - 1 - y), decoded + row * y, row);
+    return texels;
+  }
+}
+
+AssetLoader::AssetLoader(JobSystem& jobs, AsyncProgramBuilder& programs)
+  : jobs(jobs), programs(programs), mainThread(std::this_thread::get_id()) {}
+
+AsyncFileReader& AssetLoader::fileReader() {
+  // its block pool and ring are only worth setting up for a streamed load
+  std::call_once(fileReaderOnce, [this] { files = std::make_unique<AsyncFileReader>(jobs); });
+  return *files;
+}
+
+bool AssetLoader::Schedule::await_ready() const {
+  if (affinity == JobSystem::Affinity::MainThread)
+    return std::this_thread::get_id() == loader.mainThread;
+  return loader.jobs.workerCount() == 0;
+}
+
+void AssetLoader::Schedule::await_suspend(std::coroutine_handle<> handle) const {
+  loader.jobs.submit([handle] { handle.resume(); }, {}, affinity);
+}
+
+void AssetLoader::NextFrame::await_suspend(std::coroutine_handle<> handle) const {
+  std::lock_guard<std::mutex> lock(loader.frameMutex);
+  loader.frameWaiters.push_back(handle);
+}
+
+void AssetLoader::update() {
+  CPU_ZONE("asset loads");
+  std::vector<std::coroutine_handle<>> waiters;
+  {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    waiters.swap(frameWaiters);
+  }
+  // resumed as MainThread jobs like the onMainThread() steps, so a parallelFor inside one of them
+  // can't start another load's GL step; the ones that await nextFrame() again land in the fresh list
+  for (std::coroutine_handle<> waiter : waiters)
+    jobs.submit([waiter] { waiter.resume(); }, {}, JobSystem::Affinity::MainThread);
+  jobs.runMainThreadJobs();
+}
+
+Task<GltfScene> AssetLoader::loadMesh(std::string path, GltfScene::Upload upload) {
+  co_await onWorker();
+  // streamed loads read around the page cache, there is nothing to fault in ahead of them
+  if (upload != GltfScene::Upload::Streamed) {
+    // the pages stay in the page cache for the phases below, not in the resident set
+    CPU_ZONE("mesh prefetch");
+    MappedFile file(path);
+    if (file) {
+      const uint8_t* data = file.data();
+      jobs.parallelFor(file.size(), PREFETCH_BYTES, [&](size_t begin, size_t end) {
+        volatile uint8_t sink = 0;
+        for (size_t offset = begin; offset < end; offset += 4096)
+          sink = sink + data[offset];
+        file.release(begin, end - begin);
+      });
+    }
+  }
+  GltfScene scene;
+  bool prepared;
+  {
+    CPU_ZONE("mesh prepare");
+    AsyncFileReader* reader = upload == GltfScene::Upload::Streamed ? &fileReader() : nullptr;
+    prepared = scene.prepare(path, upload, &jobs, reader);
+  }
+  if (!prepared)
+    co_return scene;
+  // the images decode on the workers while the GL thread uploads the geometry
+  std::vector<Task<Texture>> textures;
+  for (GltfScene::Image& image : scene.images()) {
+    if (!image.encoded.empty())
+      textures.push_back(loadTexture(std::move(image.encoded), path + " image " + std::to_string(textures.size())));
+    else if (!image.path.empty())
+      textures.push_back(loadTexture(image.path));
+    else
+      textures.emplace_back();
+    if (textures.back())
+      textures.back().start();
+  }
+  co_await onMainThread();
+  // a staging piece per frame, the render loop keeps going in between
+  while (scene.uploadStep())
+    co_await nextFrame();
+  // started tasks have to finish before they go, a failed upload included
+  for (size_t i = 0; i < textures.size(); i++) {
+    while (textures[i] && !textures[i].done())
+      co_await nextFrame();
+    if (textures[i])
+      scene.setTexture(i, std::move(textures[i].result()));
+  }
+  if (scene)
+    scene.stats().print(path);
+  co_return scene;
+}
+
+Task<Texture> AssetLoader::loadTexture(std::string path) {
+  co_await onWorker();
+  int width = 0, height = 0, channels = 0;
+  std::vector<uint8_t> texels;
+  {
+    CPU_ZONE("texture decode");
+    stbi_uc* decoded = stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!decoded) {
+      std::cout << "ERROR::TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+      co_return Texture();
+    }
+    texels = bottomRowFirst(decoded, width, height);
+    stbi_image_free(decoded);
+  }
+  co_await onMainThread();
+  co_return Texture(width, height, texels.data());
+}
+
+Task<Texture> AssetLoader::loadTexture(std::vector<uint8_t> encoded, std::string name) {
+  co_await onWorker();
+  int width = 0, height = 0, channels = 0;
+  std::vector<uint8_t> texels;
+  {
+    CPU_ZONE("texture decode");
+    stbi_uc* decoded = encoded.size() <= INT_MAX
+      ? stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, 4) : nullptr;
+    if (!decoded) {
+      std::cout << "ERROR::TEXTURE::LOAD_FAILED " << name << "\n" << stbi_failure_reason() << std::endl;
+      co_return Texture();
+    }
+    texels = bottomRowFirst(decoded, width, height);
+    stbi_image_free(decoded);
+    encoded = {};
+  }
+  co_await onMainThread();
+  co_return Texture(width, height, texels.data());
+}
+
+Task<unsigned int> AssetLoader::compileProgram(std::vector<ShaderStage> stages, std::vector<std::string> defines) {
+  co_await onMainThread();
+  unsigned int handle = programs.submit(stages, defines);
+  // the builder finishes programs in poll(), once per frame
+  while (!programs.isReady(handle) && !programs.hasFailed(handle))
+    co_await nextFrame();
+  co_return programs.program(handle);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_file.h"
+#include "gltf_loader.h"
+#include "job_system.h"
+#include "program_builder.h"
+#include "resource.h"
+#include "task.h"
+
+// assetLoader: co_await-able loads on the job system, e.g. scene = co_await assets.loadMesh(path).
+// a load hops between threads by awaiting:
+//  - onWorker(): resumes in a job on a worker, for file reads and decoding (inline without workers)
+//  - onMainThread(): resumes in update() on the thread that owns the GL context, for uploads (inline
+//    when already there)
+//  - nextFrame(): resumes in the next update(), to poll something that finishes over frames
+// so a coroutine reads like the blocking code it replaces and the render loop never waits on it. the
+// loads take their arguments by value, references wouldn't outlive the caller's frame.
+//  - loadMesh: a worker faults the file into the page cache and runs GltfScene::prepare (fanning out
+//    across the workers), then the GL thread uploads it one GltfScene::uploadStep per frame;
+//    Upload::Streamed skips the prefetch, jobs read the file piece by piece around the page cache with
+//    the loader's AsyncFileReader (created by the first streamed load and shared by the ones after it)
+//    and the GL thread only copies the pieces that are in. the images the scene's materials sample
+//    load as loadTexture tasks alongside, the scene is done once they are in too
+//  - loadTexture: decoded to RGBA8 by stb_image on a worker, a mipmapped Texture on the GL thread
+//  - compileProgram: an AsyncProgramBuilder build, 0 if it failed; GCC 12 rejects a braced stage list
+//    inside the co_await expression, build the vector first
+// create it on the GL thread and call update() there once per frame, after AsyncProgramBuilder::poll().
+// -----------------------------------
+class AssetLoader {
+public:
+  AssetLoader(JobSystem& jobs, AsyncProgramBuilder& programs);
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  struct Schedule {
+    AssetLoader& loader;
+    JobSystem::Affinity affinity;
+
+    bool await_ready() const;
+    void await_suspend(std::coroutine_handle<> handle) const;
+    void await_resume() const noexcept {}
+  };
+  struct NextFrame {
+    AssetLoader& loader;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const;
+    void await_resume() const noexcept {}
+  };
+  Schedule onWorker() { return {*this, JobSystem::Affinity::Any}; }
+  Schedule onMainThread() { return {*this, JobSystem::Affinity::MainThread}; }
+  NextFrame nextFrame() { return {*this}; }
+
+  // the scene is empty when the file can't be loaded
+  Task<GltfScene> loadMesh(std::string path, GltfScene::Upload upload = GltfScene::Upload::Auto);
+  // an empty Texture when the file can't be decoded
+  Task<Texture> loadTexture(std::string path);
+  // the same for an image that is already in memory, e.g. embedded in a glTF file; name is for errors
+  Task<Texture> loadTexture(std::vector<uint8_t> encoded, std::string name);
+  Task<unsigned int> compileProgram(std::vector<ShaderStage> stages, std::vector<std::string> defines = {});
+
+  // GL thread, once per frame: runs the main thread steps that are ready and resumes nextFrame()
+  void update();
+  // GL thread: polls programs and updates until a started task is done, e.g. before exiting
+  template <typename T>
+  void wait(const Task<T>& task) {
+    while (task && !task.done()) {
+      programs.poll();
+      update();
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  AsyncFileReader& fileReader();
+
+  JobSystem& jobs;
+  AsyncProgramBuilder& programs;
+  std::once_flag fileReaderOnce;
+  std::unique_ptr<AsyncFileReader> files;
+  std::thread::id mainThread;
+  std::mutex frameMutex;
+  std::vector<std::coroutine_handle<>> frameWaiters;
+};
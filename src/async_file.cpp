@@ -0,0 +1,404 @@
+#include "async_file.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include "cpu_profiler.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define ASYNC_FILE_IO_URING 1
+#endif
+#endif
+#ifndef ASYNC_FILE_IO_URING
+#define ASYNC_FILE_IO_URING 0
+#endif
+
+namespace {
+#ifdef _WIN32
+  intptr_t openFile(const std::string& path, bool) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    return file == INVALID_HANDLE_VALUE ? -1 : reinterpret_cast<intptr_t>(file);
+  }
+
+  void closeFile(intptr_t file) {
+    CloseHandle(reinterpret_cast<HANDLE>(file));
+  }
+
+  int64_t readAt(intptr_t file, uint64_t offset, uint8_t* data, size_t length) {
+    // a synchronous handle still reads at the OVERLAPPED offset, threads don't share a file pointer
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD read = 0;
+    if (!ReadFile(reinterpret_cast<HANDLE>(file), data, static_cast<DWORD>(length), &read, &overlapped))
+      return GetLastError() == ERROR_HANDLE_EOF ? 0 : -EIO;
+    return read;
+  }
+#else
+  intptr_t openFile(const std::string& path, bool direct) {
+    int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_DIRECT
+    if (direct)
+      flags |= O_DIRECT;
+#else
+    (void)direct;
+#endif
+    return open(path.c_str(), flags);
+  }
+
+  void closeFile(intptr_t file) {
+    close(static_cast<int>(file));
+  }
+
+  int64_t readAt(intptr_t file, uint64_t offset, uint8_t* data, size_t length) {
+    ssize_t result;
+    do
+      result = pread(static_cast<int>(file), data, length, static_cast<off_t>(offset));
+    while (result < 0 && errno == EINTR);
+    return result < 0 ? -errno : result;
+  }
+#endif
+}
+
+#if ASYNC_FILE_IO_URING
+// the submission and completion rings shared with the kernel, mapped from the ring's descriptor
+struct AsyncFileReader::Ring {
+  int fd = -1;
+  void* sqRing = MAP_FAILED;
+  void* cqRing = MAP_FAILED;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqRingSize = 0;
+  size_t cqRingSize = 0;
+  size_t sqesSize = 0;
+  uint32_t* sqTail = nullptr;
+  uint32_t* sqMask = nullptr;
+  uint32_t* sqArray = nullptr;
+  uint32_t* cqHead = nullptr;
+  uint32_t* cqTail = nullptr;
+  uint32_t* cqMask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+  // queued since the last io_uring_enter
+  unsigned int pending = 0;
+  bool fixed = false;
+  // READV reads the iovec when it is submitted, one per block
+  iovec iovecs[QUEUE_DEPTH];
+
+  // nullptr when the kernel has no io_uring or doesn't allow it (io_uring_disabled, seccomp)
+  static std::unique_ptr<Ring> create(uint8_t* blocks) {
+    io_uring_params params = {};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params));
+    if (fd < 0)
+      return nullptr;
+    auto ring = std::make_unique<Ring>();
+    ring->fd = fd;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // since 5.4 both rings are one mapping
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+      ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+    ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED)
+      return nullptr;
+    ring->cqRing = single ? ring->sqRing : mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cqRing == MAP_FAILED)
+      return nullptr;
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (ring->sqes == MAP_FAILED)
+      return nullptr;
+    uint8_t* sq = static_cast<uint8_t*>(ring->sqRing);
+    uint8_t* cq = static_cast<uint8_t*>(ring->cqRing);
+    ring->sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    ring->cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // registering pins the blocks once, it counts against RLIMIT_MEMLOCK
+    iovec registered[QUEUE_DEPTH];
+    for (unsigned int i = 0; i < QUEUE_DEPTH; i++)
+      registered[i] = {blocks + i * BLOCK_BYTES, BLOCK_BYTES};
+    ring->fixed = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, registered, QUEUE_DEPTH) == 0;
+    return ring;
+  }
+
+  ~Ring() {
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+      munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+      munmap(sqRing, sqRingSize);
+    // closing the ring unregisters the blocks
+    if (fd >= 0)
+      close(fd);
+  }
+};
+#else
+struct AsyncFileReader::Ring {
+  bool fixed = false;
+};
+#endif
+
+AsyncFileReader::AsyncFileReader(JobSystem& jobs) : jobs(jobs) {
+  blocks = static_cast<uint8_t*>(::operator new(QUEUE_DEPTH * BLOCK_BYTES, std::align_val_t(DIRECT_ALIGNMENT)));
+#if ASYNC_FILE_IO_URING
+  ring = Ring::create(blocks);
+#endif
+}
+
+AsyncFileReader::~AsyncFileReader() {
+  // the jobs of past streams find nothing to read, but they still point here
+  for (const JobSystem::JobHandle& job : readJobs)
+    jobs.wait(job);
+  // reads the ring lost track of may still land in the blocks
+  if (unusable) {
+    ring.release();
+    return;
+  }
+  ring.reset();
+  ::operator delete(blocks, std::align_val_t(DIRECT_ALIGNMENT));
+}
+
+bool AsyncFileReader::registeredBuffers() const {
+  return ring && ring->fixed;
+}
+
+bool AsyncFileReader::stream(const std::string& path, uint64_t offset, uint64_t size, const Consumer& consumer, bool preferDirect) {
+  if (size == 0)
+    return true;
+  std::lock_guard<std::mutex> lock(streamMutex);
+  CPU_ZONE("file stream");
+  if (unusable) {
+    std::cout << "ERROR::ASYNC_FILE::UNUSABLE " << path << std::endl;
+    return false;
+  }
+  bool direct = ring && (preferDirect || size >= DIRECT_BYTES);
+  intptr_t file = openFile(path, direct);
+  if (file < 0 && direct) {
+    direct = false;
+    file = openFile(path, false);
+  }
+  if (file < 0) {
+    std::cout << "ERROR::ASYNC_FILE::CANNOT_OPEN " << path << std::endl;
+    return false;
+  }
+  // O_DIRECT reads whole aligned blocks, the consumer only sees the range
+  uint64_t first = direct ? offset / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT : offset;
+  uint64_t end = offset + size;
+  uint64_t blockCount = (end - first + BLOCK_BYTES - 1) / BLOCK_BYTES;
+
+  // block b reads into slot b % QUEUE_DEPTH, which is free again once block b - QUEUE_DEPTH was consumed
+  struct Slot {
+    uint64_t block = 0;
+    size_t needed = 0;   // bytes of the range in this block
+    size_t done = 0;
+    bool direct = false; // issued on the O_DIRECT descriptor
+    bool ready = false;
+  };
+  std::vector<Slot> slots(QUEUE_DEPTH);
+  // O_DIRECT descriptors replaced by buffered ones, reads may still hold them
+  std::vector<intptr_t> retired;
+  auto issue = [&](unsigned int index) {
+    Slot& slot = slots[index];
+    size_t length = direct ? (slot.needed + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT : slot.needed;
+    slot.direct = direct;
+    queue({index, file, first + slot.block * BLOCK_BYTES + slot.done, blocks + index * BLOCK_BYTES + slot.done, length - slot.done});
+  };
+
+  uint64_t issued = 0, delivered = 0;
+  size_t inFlight = 0;
+  bool failed = false;
+  std::vector<Completion> completions;
+  while (delivered < blockCount) {
+    while (!failed && issued < blockCount && issued < delivered + QUEUE_DEPTH) {
+      unsigned int index = static_cast<unsigned int>(issued % QUEUE_DEPTH);
+      slots[index] = {issued, static_cast<size_t>(std::min<uint64_t>(BLOCK_BYTES, end - (first + issued * BLOCK_BYTES))), 0, false, false};
+      issue(index);
+      inFlight++;
+      issued++;
+    }
+    // after a failure the reads in flight still target the blocks, they are waited for
+    if (inFlight == 0)
+      break;
+    if (!complete(completions)) {
+      // the kernel may still write into the blocks and can't be waited on: they are left to it and the
+      // reader fails from here on
+      unusable = true;
+      failed = true;
+      break;
+    }
+    for (const Completion& completion : completions) {
+      inFlight--;
+      Slot& slot = slots[completion.slot];
+      if (failed)
+        continue;
+      // the file system has no O_DIRECT for this file after all, the rest is read buffered
+      if (completion.result == -EINVAL && slot.direct) {
+        if (direct) {
+          retired.push_back(file);
+          direct = false;
+          file = openFile(path, false);
+        }
+        if (file >= 0) {
+          issue(completion.slot);
+          inFlight++;
+          continue;
+        }
+      }
+      if (completion.result <= 0) {
+        std::cout << "ERROR::ASYNC_FILE::READ_FAILED " << path << ": "
+                  << (completion.result < 0 ? std::strerror(static_cast<int>(-completion.result)) : "unexpected end of file") << std::endl;
+        failed = true;
+        continue;
+      }
+      slot.done += static_cast<size_t>(completion.result);
+      if (slot.done < slot.needed) {
+        issue(completion.slot);
+        inFlight++;
+        continue;
+      }
+      slot.ready = true;
+    }
+    while (!failed && delivered < issued && slots[delivered % QUEUE_DEPTH].ready) {
+      unsigned int index = static_cast<unsigned int>(delivered % QUEUE_DEPTH);
+      Slot& slot = slots[index];
+      uint64_t blockStart = first + slot.block * BLOCK_BYTES;
+      size_t skip = static_cast<size_t>(offset - std::min(offset, blockStart));
+      consumer(blockStart + skip - offset, blocks + index * BLOCK_BYTES + skip, slot.needed - skip);
+      slot.ready = false;
+      delivered++;
+    }
+  }
+  if (file >= 0)
+    closeFile(file);
+  for (intptr_t descriptor : retired)
+    closeFile(descriptor);
+  return !failed && delivered == blockCount;
+}
+
+void AsyncFileReader::queue(const Read& read) {
+#if ASYNC_FILE_IO_URING
+  if (ring) {
+    // the kernel only reads the tail, the entries before it are ours until it moves
+    uint32_t tail = std::atomic_ref<uint32_t>(*ring->sqTail).load(std::memory_order_relaxed);
+    uint32_t index = tail & *ring->sqMask;
+    io_uring_sqe& entry = ring->sqes[index];
+    std::memset(&entry, 0, sizeof(entry));
+    entry.fd = static_cast<int>(read.file);
+    entry.off = read.offset;
+    entry.user_data = read.slot;
+    if (ring->fixed) {
+      entry.opcode = IORING_OP_READ_FIXED;
+      entry.addr = reinterpret_cast<uint64_t>(read.data);
+      entry.len = static_cast<uint32_t>(read.length);
+      entry.buf_index = static_cast<uint16_t>(read.slot);
+    } else {
+      ring->iovecs[read.slot] = {read.data, read.length};
+      entry.opcode = IORING_OP_READV;
+      entry.addr = reinterpret_cast<uint64_t>(&ring->iovecs[read.slot]);
+      entry.len = 1;
+    }
+    ring->sqArray[index] = index;
+    std::atomic_ref<uint32_t>(*ring->sqTail).store(tail + 1, std::memory_order_release);
+    ring->pending++;
+    return;
+  }
+#endif
+  {
+    std::lock_guard<std::mutex> lock(workMutex);
+    work.push_back(read);
+  }
+  std::erase_if(readJobs, [this](const JobSystem::JobHandle& job) { return jobs.finished(job); });
+  readJobs.push_back(jobs.submit([this] { runQueuedRead(); }));
+}
+
+bool AsyncFileReader::complete(std::vector<Completion>& completions) {
+  completions.clear();
+#if ASYNC_FILE_IO_URING
+  if (ring) {
+    // one system call submits the batch and waits for the first completion
+    while (true) {
+      long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (submitted >= 0) {
+        ring->pending -= static_cast<unsigned int>(submitted);
+        break;
+      }
+      int error = errno;
+      // interrupted, or the kernel is short of memory for the moment
+      if (error == EINTR || error == EAGAIN || error == EBUSY) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::cout << "ERROR::ASYNC_FILE::IO_URING_ENTER " << std::strerror(error) << std::endl;
+      if (ring->pending == 0)
+        return false;
+      // a failed call consumed none of the queued reads: they are taken back and complete as cancelled,
+      // the ones the kernel already has are waited for as usual
+      uint32_t tail = std::atomic_ref<uint32_t>(*ring->sqTail).load(std::memory_order_relaxed);
+      for (uint32_t i = tail - ring->pending; i != tail; i++)
+        completions.push_back({static_cast<unsigned int>(ring->sqes[i & *ring->sqMask].user_data), -ECANCELED});
+      std::atomic_ref<uint32_t>(*ring->sqTail).store(tail - ring->pending, std::memory_order_release);
+      ring->pending = 0;
+      return true;
+    }
+    uint32_t head = std::atomic_ref<uint32_t>(*ring->cqHead).load(std::memory_order_relaxed);
+    uint32_t tail = std::atomic_ref<uint32_t>(*ring->cqTail).load(std::memory_order_acquire);
+    for (; head != tail; head++) {
+      const io_uring_cqe& entry = ring->cqes[head & *ring->cqMask];
+      completions.push_back({static_cast<unsigned int>(entry.user_data), entry.res});
+    }
+    // hands the entries back to the kernel
+    std::atomic_ref<uint32_t>(*ring->cqHead).store(head, std::memory_order_release);
+    return true;
+  }
+#endif
+  // reads that no job has taken yet are read right here instead of waiting for a worker
+  std::unique_lock<std::mutex> lock(workMutex);
+  while (completed.empty()) {
+    if (work.empty()) {
+      completionSignal.wait(lock, [&] { return !completed.empty(); });
+      break;
+    }
+    lock.unlock();
+    runQueuedRead();
+    lock.lock();
+  }
+  completions.swap(completed);
+  return true;
+}
+
+bool AsyncFileReader::runQueuedRead() {
+  Read read;
+  {
+    std::lock_guard<std::mutex> lock(workMutex);
+    if (work.empty())
+      return false;
+    read = work.front();
+    work.pop_front();
+  }
+  int64_t result = readAt(read.file, read.offset, read.data, read.length);
+  {
+    std::lock_guard<std::mutex> lock(workMutex);
+    completed.push_back({read.slot, result});
+  }
+  completionSignal.notify_one();
+  return true;
+}
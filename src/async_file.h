@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "job_system.h"
+
+// asyncFileReader: reads a file range with QUEUE_DEPTH block reads in flight, for streaming large assets.
+//  - Linux io_uring (raw syscalls, no liburing): reads go into the submission ring and a single
+//    io_uring_enter submits the whole batch and reaps what completed. the block pool is registered with
+//    the ring once (IORING_OP_READ_FIXED), the kernel doesn't pin and map pages per read; without the
+//    memlock for that, plain READV. ranges of at least DIRECT_BYTES are read O_DIRECT, by DMA into the
+//    blocks around the page cache, where the file system allows it
+//  - elsewhere, or when the kernel has no io_uring: jobs on the JobSystem's workers pread (ReadFile on
+//    Windows) the blocks; the streaming thread reads queued blocks itself while it waits, so this works
+//    without workers as well
+// stream() hands the blocks to a consumer in file order on the calling thread, a block that completes
+// early waits in its slot; the slot is only reused once the consumer is done with it. one stream runs
+// at a time, concurrent callers wait for their turn; the pool, ring and registration are set up once, one
+// reader per process is enough (AssetLoader owns it). O_DIRECT pays off for data read once and uploaded,
+// a file that is read again soon is better off in the page cache (MappedFile).
+// -----------------------------------
+class AsyncFileReader {
+public:
+  enum class Backend { IoUring, Jobs };
+  static constexpr size_t BLOCK_BYTES = 512 << 10;
+  static constexpr unsigned int QUEUE_DEPTH = 32;
+  static constexpr uint64_t DIRECT_BYTES = 64 << 20;
+  // O_DIRECT file offsets, lengths and buffers are multiples of it
+  static constexpr size_t DIRECT_ALIGNMENT = 4096;
+
+  // offset relative to the start of the streamed range
+  using Consumer = std::function<void(uint64_t offset, const uint8_t* data, size_t size)>;
+
+  explicit AsyncFileReader(JobSystem& jobs);
+  ~AsyncFileReader();
+  AsyncFileReader(const AsyncFileReader&) = delete;
+  AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+  // [offset, offset + size) of the file; false (and an error printed) when it can't be opened or read,
+  // the consumer may have seen the blocks before the failing one. either way no read is left in flight.
+  // preferDirect reads the range O_DIRECT however small it is, e.g. a piece of a range of DIRECT_BYTES or more
+  bool stream(const std::string& path, uint64_t offset, uint64_t size, const Consumer& consumer, bool preferDirect = false);
+
+  Backend backend() const { return ring ? Backend::IoUring : Backend::Jobs; }
+  bool registeredBuffers() const;
+
+private:
+  struct Ring;
+  struct Read {
+    unsigned int slot = 0;  // the block it reads into
+    intptr_t file = -1;
+    uint64_t offset = 0;
+    uint8_t* data = nullptr;
+    size_t length = 0;
+  };
+  struct Completion {
+    unsigned int slot = 0;
+    int64_t result = 0;  // bytes read or -errno
+  };
+
+  void queue(const Read& read);
+  // submits what is queued and waits for at least one completion
+  bool complete(std::vector<Completion>& completions);
+  // job pool fallback: pops a queued read and runs it, false when there was none
+  bool runQueuedRead();
+
+  JobSystem& jobs;
+
+  std::mutex streamMutex;
+  // set when the ring can't be waited on with reads in flight, streams fail from then on
+  bool unusable = false;
+  uint8_t* blocks = nullptr;  // QUEUE_DEPTH * BLOCK_BYTES, DIRECT_ALIGNMENT aligned
+  std::unique_ptr<Ring> ring;
+
+  // job pool fallback: a job per queued read, each takes whichever read is next
+  std::vector<JobSystem::JobHandle> readJobs;
+  std::mutex workMutex;
+  std::condition_variable completionSignal;
+  std::deque<Read> work;
+  std::vector<Completion> completed;
+};
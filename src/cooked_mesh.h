@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "vertex_compression.h"
+
+// cookedMesh: the binary scene format asset_cooker writes (tools/asset_cooker.cpp) and
+// GltfScene::load reads for EXTENSION files. it is laid out for a memory mapping: a header with
+// one (offset, size) per section, every section SECTION_ALIGNMENT aligned and an array of one of the
+// structs below, all little endian. loading it is validating the header, casting section pointers and
+// uploading; vertices, indices, node matrices and materials go to GL byte for byte.
+//  - Vertices: CompressedVertex, the primitives of a mesh share one position decode
+//  - Indices: 16 or 32 bit per primitive (PRIMITIVE_SHORT_INDICES), each LOD 4 byte aligned, below
+//    the primitive's vertexCount; the loader range checks the sections but trusts the values
+//  - Meshes, Primitives, Lods: LOD 0 is the optimized full mesh, the rest are cluster simplified and
+//    index the same vertices, with their object space error
+//  - Meshlets, MeshletVertices (uint32, relative to the primitive's baseVertex), MeshletTriangles
+//    (3 bytes each): MeshOptimizer::buildMeshlets of LOD 0
+//  - Materials: GltfScene::MATERIAL_TEXELS texels each, the glTF default material last
+//  - NodeMatrices: world matrix times the mesh's position decode (column major), NODE_TEXELS texels
+//    each; Nodes: parent and mesh, parents before children
+// a format change bumps VERSION, older files are rejected and have to be cooked again.
+// -----------------------------------
+namespace CookedMesh {
+  constexpr uint32_t MAGIC = 0x4853454D;  // "MESH"
+  constexpr uint32_t VERSION = 1;
+  constexpr size_t SECTION_ALIGNMENT = 64;
+  constexpr const char* EXTENSION = ".cmesh";
+
+  enum Section : uint32_t {
+    Vertices, Indices, Meshes, Primitives, Lods, Meshlets, MeshletVertices, MeshletTriangles, Materials,
+    NodeMatrices, Nodes, SectionCount
+  };
+
+  struct SectionRange {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+    uint32_t vertexStride;  // sizeof(CompressedVertex) when cooked
+    uint32_t reserved;
+    float boundsMin[3];     // world space, all mesh nodes
+    float boundsMax[3];
+    SectionRange sections[SectionCount];
+  };
+
+  struct Mesh {
+    uint32_t firstPrimitive;
+    uint32_t primitiveCount;
+    float positionDecode[4];  // PositionDecode of every primitive's vertices
+    float boundsMin[3];       // object space
+    float boundsMax[3];
+  };
+
+  constexpr uint32_t PRIMITIVE_SHORT_INDICES = 1;
+  constexpr uint32_t PRIMITIVE_BLEND = 2;
+
+  struct Primitive {
+    uint32_t baseVertex;    // into Vertices
+    uint32_t vertexCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t material;      // entry of Materials
+    uint32_t flags;
+  };
+
+  struct Lod {
+    uint64_t indexOffset;   // bytes into Indices
+    uint32_t indexCount;
+    float error;            // bound on how far a vertex moved, object space
+  };
+
+  struct Meshlet {
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+  };
+
+  struct Material {
+    float baseColorFactor[4];
+    float emissiveFactor[3];
+    float alphaCutoff;      // 0 unless alphaMode MASK
+    float metallicFactor;
+    float roughnessFactor;
+    float baseColorTexture; // glTF texture index, -1 = none
+    float normalTexture;
+  };
+
+  struct Node {
+    int32_t parent;
+    int32_t mesh;
+  };
+
+  static_assert(sizeof(Header) == 48 + 16 * SectionCount && sizeof(Mesh) == 48 && sizeof(Primitive) == 32 && sizeof(Lod) == 16 &&
+                sizeof(Meshlet) == 48 && sizeof(Material) == 48 && sizeof(Node) == 8, "cooked structs must not have padding");
+
+  constexpr size_t alignSection(size_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+  }
+}
@@ -0,0 +1,96 @@
+#include "cpu_profiler.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace CpuProfiler {
+  std::atomic<bool> enabled{true};
+
+  namespace {
+    // rings stay alive after their thread exits, so a dump still sees the zones of finished workers
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadRing>> registry;
+
+    // ticks are mapped onto the trace clock by a linear fit between a pair of (ticks, steady_clock)
+    // samples taken at startup and one taken at dump time
+    struct ClockPair {
+      int64_t ticks;
+      std::chrono::steady_clock::time_point time;
+    };
+    const ClockPair startPair{now(), std::chrono::steady_clock::now()};
+
+    struct TickConversion {
+      double startUs;
+      double usPerTick;
+
+      double toTraceUs(int64_t ticks) const { return startUs + (ticks - startPair.ticks) * usPerTick; }
+      double durationUs(int64_t ticks) const { return ticks * usPerTick; }
+    };
+
+    TickConversion tickConversion() {
+#ifdef CPU_PROFILER_TSC
+      // a few milliseconds between the samples keep the fit precise
+      if (std::chrono::steady_clock::now() - startPair.time < std::chrono::milliseconds(10))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      ClockPair dumpPair{now(), std::chrono::steady_clock::now()};
+      double elapsedUs = std::chrono::duration<double, std::micro>(dumpPair.time - startPair.time).count();
+      return {traceTimeUs(startPair.time), elapsedUs / static_cast<double>(dumpPair.ticks - startPair.ticks)};
+#else
+      return {traceTimeUs(startPair.time), std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration(1)).count()};
+#endif
+    }
+  }
+
+  ThreadRing& registerThread() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.push_back(std::make_unique<ThreadRing>());
+    ThreadRing& ring = *registry.back();
+    ring.threadId = static_cast<uint32_t>(registry.size() - 1);
+    ring.threadName = "thread " + std::to_string(ring.threadId);
+    return ring;
+  }
+
+  void setThreadName(const std::string& name) {
+    ThreadRing& ring = threadRing();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    ring.threadName = name;
+  }
+
+  std::vector<TraceEvent> collect() {
+    TickConversion conversion = tickConversion();
+    std::vector<TraceEvent> events;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& ring : registry) {
+      uint64_t end = ring->writeIndex.load(std::memory_order_acquire);
+      uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+      std::vector<Zone> zones;
+      zones.reserve(end - begin);
+      for (uint64_t i = begin; i < end; i++)
+        zones.push_back(ring->zones[i % RING_SIZE]);
+      // the owner keeps writing while we copy; slots it reached again may be torn, skip them
+      uint64_t written = ring->writeIndex.load(std::memory_order_acquire);
+      uint64_t valid = written > RING_SIZE ? written - RING_SIZE : 0;
+      for (uint64_t i = begin; i < end; i++) {
+        if (i < valid)
+          continue;
+        const Zone& zone = zones[i - begin];
+        events.push_back({zone.name, "cpu", conversion.toTraceUs(zone.start), conversion.durationUs(zone.stop - zone.start), ring->threadId});
+      }
+    }
+    return events;
+  }
+
+  bool writeChromeTrace(const std::string& path, const std::vector<TraceEvent>& extraEvents,
+                        const std::vector<std::pair<uint32_t, std::string>>& extraThreads) {
+    std::vector<TraceEvent> events = collect();
+    events.insert(events.end(), extraEvents.begin(), extraEvents.end());
+    std::vector<std::pair<uint32_t, std::string>> threads;
+    {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      for (auto& ring : registry)
+        threads.emplace_back(ring->threadId, ring->threadName);
+    }
+    threads.insert(threads.end(), extraThreads.begin(), extraThreads.end());
+    return ::writeChromeTrace(path, events, threads);
+  }
+}
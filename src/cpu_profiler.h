@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define CPU_PROFILER_TSC 1
+#endif
+#include "trace.h"
+
+// cpuProfiler: scoped CPU zones that stay compiled into release builds. every thread records into
+// its own fixed-size ring (no locks, no allocation after the first zone of the thread), old zones
+// are overwritten. a dump copies the rings into Chrome trace / Perfetto JSON on request.
+// a zone costs two timestamp reads (rdtsc on x86-64, steady_clock elsewhere; converted at dump time)
+// and one ring store, a disabled profiler one relaxed load.
+//
+// usage: CPU_ZONE("update"); times the rest of the enclosing scope
+// -----------------------------------
+namespace CpuProfiler {
+  // zones recorded per thread before the oldest are overwritten
+  constexpr size_t RING_SIZE = 1 << 16;
+
+  struct Zone {
+    const char* name;
+    int64_t start;
+    int64_t stop;
+  };
+
+  struct ThreadRing {
+    Zone zones[RING_SIZE];
+    // total number of zones written, the slot is writeIndex % RING_SIZE
+    std::atomic<uint64_t> writeIndex{0};
+    uint32_t threadId = 0;
+    std::string threadName;
+  };
+
+  extern std::atomic<bool> enabled;
+
+  ThreadRing& registerThread();
+  // the calling thread's ring, registered on first use
+  inline ThreadRing& threadRing() {
+    thread_local ThreadRing* ring = nullptr;
+    if (!ring)
+      ring = &registerThread();
+    return *ring;
+  }
+  // label the calling thread in the trace
+  void setThreadName(const std::string& name);
+
+  inline void record(const char* name, int64_t start, int64_t stop) {
+    ThreadRing& ring = threadRing();
+    uint64_t index = ring.writeIndex.load(std::memory_order_relaxed);
+    ring.zones[index % RING_SIZE] = {name, start, stop};
+    // publish after the slot is written, readers acquire writeIndex
+    ring.writeIndex.store(index + 1, std::memory_order_release);
+  }
+
+  // raw ticks, only meaningful to collect()
+  inline int64_t now() {
+#ifdef CPU_PROFILER_TSC
+    return static_cast<int64_t>(__rdtsc());
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+  // zones of all threads that are still in their rings, oldest first per thread
+  std::vector<TraceEvent> collect();
+  // cpu zones together with events of other sources (e.g. the GPU profiler) in one file
+  bool writeChromeTrace(const std::string& path, const std::vector<TraceEvent>& extraEvents = {},
+                        const std::vector<std::pair<uint32_t, std::string>>& extraThreads = {});
+}
+
+// cpuZone: RAII helper behind CPU_ZONE, name must outlive the dump (string literals)
+// -----------------------------------
+class CpuZone {
+public:
+  explicit CpuZone(const char* name) : name(name), start(CpuProfiler::enabled.load(std::memory_order_relaxed) ? CpuProfiler::now() : 0) {}
+  ~CpuZone() {
+    if (start != 0)
+      CpuProfiler::record(name, start, CpuProfiler::now());
+  }
+  CpuZone(const CpuZone&) = delete;
+  CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+  const char* name;
+  int64_t start;
+};
+
+#define CPU_ZONE_CONCAT_INNER(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_INNER(a, b)
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
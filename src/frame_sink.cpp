@@ -0,0 +1,35 @@
+#include "frame_sink.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+PpmFrameSink::PpmFrameSink(std::string directory, unsigned int every) : directory(std::move(directory)), every(every ? every : 1) {
+  std::error_code ec;
+  std::filesystem::create_directories(this->directory, ec);
+}
+
+void PpmFrameSink::consume(const unsigned char* pixels, int width, int height, uint64_t frameIndex) {
+  if (frameIndex % every != 0)
+    return;
+  char name[32];
+  std::snprintf(name, sizeof(name), "/frame_%06llu.ppm", static_cast<unsigned long long>(frameIndex));
+  std::ofstream file(directory + name, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cout << "ERROR::FRAME_SINK::CANNOT_WRITE " << directory + name << std::endl;
+    return;
+  }
+  file << "P6\n" << width << " " << height << "\n255\n";
+  // PPM is top row first and RGB only
+  std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+  for (int y = height - 1; y >= 0; y--) {
+    const unsigned char* src = pixels + static_cast<size_t>(y) * width * 4;
+    for (int x = 0; x < width; x++) {
+      row[x * 3 + 0] = src[x * 4 + 0];
+      row[x * 3 + 1] = src[x * 4 + 1];
+      row[x * 3 + 2] = src[x * 4 + 2];
+    }
+    file.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+}
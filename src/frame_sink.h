@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// frameSink: receives the frames of a headless context instead of glfwSwapBuffers
+// -----------------------------------
+class FrameSink {
+public:
+  virtual ~FrameSink() = default;
+  // false skips the readback completely (benchmarks, smoke tests)
+  virtual bool wantsPixels() const { return false; }
+  // tightly packed RGBA8 rows, bottom row first (GL convention)
+  virtual void consume(const unsigned char*, int, int, uint64_t) {}
+};
+
+// frameSink: writes every n-th frame as binary PPM into a directory
+// -----------------------------------
+class PpmFrameSink : public FrameSink {
+public:
+  PpmFrameSink(std::string directory, unsigned int every = 1);
+  bool wantsPixels() const override { return true; }
+  void consume(const unsigned char* pixels, int width, int height, uint64_t frameIndex) override;
+
+private:
+  std::string directory;
+  unsigned int every;
+};
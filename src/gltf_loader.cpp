@@ -0,0 +1,1143 @@
+#include "gltf_loader.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <glad/glad.h>
+#include "async_file.h"
+#include "cooked_mesh.h"
+#include "job_system.h"
+#include "mapped_file.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+
+// tinygltf (and the stb_image it decodes images with) is compiled into this file only
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include "tiny_gltf.h"
+
+namespace {
+  using Matrix = std::array<float, 16>;
+
+  constexpr Matrix IDENTITY = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+  // column major, a * b
+  Matrix multiply(const Matrix& a, const Matrix& b) {
+    Matrix result;
+    for (int column = 0; column < 4; column++)
+      for (int row = 0; row < 4; row++) {
+        float sum = 0.0f;
+        for (int k = 0; k < 4; k++)
+          sum += a[k * 4 + row] * b[column * 4 + k];
+        result[column * 4 + row] = sum;
+      }
+    return result;
+  }
+
+  // matrix, or translation * rotation * scale
+  Matrix localMatrix(const tinygltf::Node& node) {
+    Matrix local = IDENTITY;
+    if (node.matrix.size() == 16) {
+      for (int i = 0; i < 16; i++)
+        local[i] = static_cast<float>(node.matrix[i]);
+      return local;
+    }
+    float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f;
+    if (node.rotation.size() == 4) {
+      x = static_cast<float>(node.rotation[0]);
+      y = static_cast<float>(node.rotation[1]);
+      z = static_cast<float>(node.rotation[2]);
+      w = static_cast<float>(node.rotation[3]);
+    }
+    float scale[3] = {1.0f, 1.0f, 1.0f};
+    if (node.scale.size() == 3)
+      for (int i = 0; i < 3; i++)
+        scale[i] = static_cast<float>(node.scale[i]);
+    float rotation[9] = {
+      1 - 2 * (y * y + z * z), 2 * (x * y + z * w),     2 * (x * z - y * w),
+      2 * (x * y - z * w),     1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+      2 * (x * z + y * w),     2 * (y * z - x * w),     1 - 2 * (x * x + y * y)
+    };
+    for (int column = 0; column < 3; column++)
+      for (int row = 0; row < 3; row++)
+        local[column * 4 + row] = rotation[column * 3 + row] * scale[column];
+    if (node.translation.size() == 3)
+      for (int i = 0; i < 3; i++)
+        local[12 + i] = static_cast<float>(node.translation[i]);
+    return local;
+  }
+
+  bool endsWith(const std::string& text, const std::string& suffix) {
+    if (text.size() < suffix.size())
+      return false;
+    return std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(),
+                      [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); });
+  }
+
+  double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct AttributeSemantic {
+    const char* name;
+    unsigned int location;
+  };
+  constexpr AttributeSemantic ATTRIBUTES[] = {{"POSITION", 0}, {"NORMAL", 1}, {"TANGENT", 2}, {"TEXCOORD_0", 3}};
+
+  // bytes a job copies or faults in at once
+  constexpr size_t JOB_BYTES = 1 << 20;
+
+  // body over [0, count) on the job system's threads, or right here without one
+  void forRange(JobSystem* jobs, size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+    if (jobs)
+      jobs->parallelFor(count, grain, body);
+    else if (count > 0)
+      body(0, count);
+  }
+
+  // Direct: the driver copies out of the source bytes; Staged: each piece goes into the next partition
+  // of a StreamBuffer ring and the GPU copies it out while the CPU fills the following ones, beginFrame
+  // only waits when it comes around to a piece still being copied. the CPU copies (or the page faults
+  // ahead of a direct upload) are spread over the job system's threads, GL is only called from this one.
+  // a Transfer advances one piece per step(), a direct one all at once, so a caller can spread a large
+  // buffer over frames. Streamed: a job streams each piece of a file range from an AsyncFileReader into
+  // the staging partition while the frames go on, a step() hands the piece read since the last one to
+  // the GPU and starts reading the next
+  class Uploader {
+  public:
+    struct Transfer {
+      const uint8_t* data = nullptr;
+      size_t size = 0;
+      MappedFile* file = nullptr;
+      size_t offset = 0;  // bytes uploaded so far
+      Buffer buffer;
+      // streamed: the range starts at fileOffset of path, failed once a piece can't be read
+      std::string path;
+      uint64_t fileOffset = 0;
+      bool failed = false;
+    };
+
+    // files is only read with Upload::Streamed and has to outlive the uploader
+    Uploader(GltfScene::Upload upload, JobSystem* jobs, AsyncFileReader* files) : jobs(jobs) {
+      if (upload == GltfScene::Upload::Auto)
+        upload = immutableBufferStorage() ? GltfScene::Upload::Staged : GltfScene::Upload::Direct;
+      if (upload == GltfScene::Upload::Staged || upload == GltfScene::Upload::Streamed)
+        staging = std::make_unique<StreamBuffer>(GltfScene::STAGING_BYTES);
+      if (upload == GltfScene::Upload::Streamed)
+        this->files = files;
+    }
+    // the read job fills staging memory
+    ~Uploader() { wait(); }
+
+    bool staged() const { return staging != nullptr; }
+    bool streamed() const { return files != nullptr; }
+    bool ioUring() const { return files && files->backend() == AsyncFileReader::Backend::IoUring; }
+
+    // data inside a mapped file has its pages released behind the copy, piece by piece when staged
+    Transfer begin(const uint8_t* data, size_t size, MappedFile* file = nullptr) {
+      Transfer transfer;
+      transfer.data = data;
+      transfer.size = size;
+      transfer.file = file;
+      if (staging)
+        transfer.buffer = Buffer(size, nullptr, 0);
+      return transfer;
+    }
+
+    // blocks until the streamed piece in flight is read, the next step() uploads it
+    void wait() {
+      if (reading)
+        jobs->wait(reading);
+    }
+
+    // streamed only: the first piece is read before the transfer's first step()
+    Transfer begin(const std::string& path, uint64_t fileOffset, size_t size) {
+      Transfer transfer = begin(nullptr, size);
+      transfer.path = path;
+      transfer.fileOffset = fileOffset;
+      read(transfer);
+      return transfer;
+    }
+
+    // uploads the next piece and returns its size, the buffer is complete once offset reaches size. 0
+    // while a streamed piece is still being read
+    size_t step(Transfer& transfer) {
+      if (!transfer.path.empty())
+        return stepStreamed(transfer);
+      const uint8_t* data = transfer.data;
+      auto release = [&](size_t offset, size_t length) {
+        if (transfer.file && *transfer.file)
+          transfer.file->release(static_cast<size_t>(data - transfer.file->data()) + offset, length);
+      };
+      if (!staging) {
+        // a mapped source would fault page by page inside the driver's copy
+        if (jobs && transfer.file && *transfer.file)
+          forRange(jobs, transfer.size, JOB_BYTES, [data](size_t begin, size_t end) {
+            volatile uint8_t sink = 0;
+            for (size_t offset = begin; offset < end; offset += 4096)
+              sink = sink + data[offset];
+          });
+        transfer.buffer = Buffer(transfer.size, data, 0);
+        release(0, transfer.size);
+        transfer.offset = transfer.size;
+        return transfer.size;
+      }
+      size_t offset = transfer.offset;
+      size_t piece = std::min(GltfScene::STAGING_BYTES, transfer.size - offset);
+      staging->beginFrame();
+      StreamBuffer::Allocation allocation = staging->allocate(piece, 4);
+      uint8_t* target = static_cast<uint8_t*>(allocation.data);
+      forRange(jobs, piece, JOB_BYTES, [&](size_t begin, size_t end) {
+        std::memcpy(target + begin, data + offset + begin, end - begin);
+      });
+      staging->flush();
+      staging->storage().copyTo(transfer.buffer, static_cast<size_t>(allocation.offset), offset, piece);
+      staging->endFrame();
+      release(offset, piece);
+      transfer.offset += piece;
+      return piece;
+    }
+
+  private:
+    // the piece after transfer.offset into the next staging partition, on a worker when there is one
+    void read(Transfer& transfer) {
+      readPiece = std::min(GltfScene::STAGING_BYTES, transfer.size - transfer.offset);
+      staging->beginFrame();
+      readAllocation = staging->allocate(readPiece, 4);
+      uint8_t* target = static_cast<uint8_t*>(readAllocation.data);
+      // pieces of a large section stay O_DIRECT like the whole section would be
+      auto work = [this, target, path = transfer.path, offset = transfer.fileOffset + transfer.offset,
+                   size = readPiece, direct = transfer.size >= AsyncFileReader::DIRECT_BYTES] {
+        readSucceeded = files->stream(path, offset, size, [target](uint64_t blockOffset, const uint8_t* data, size_t length) {
+          std::memcpy(target + blockOffset, data, length);
+        }, direct);
+      };
+      if (jobs && jobs->workerCount() > 0)
+        reading = jobs->submit(work);
+      else
+        work();
+    }
+
+    size_t stepStreamed(Transfer& transfer) {
+      if (reading && !jobs->finished(reading))
+        return 0;
+      reading.reset();
+      if (!readSucceeded) {
+        transfer.failed = true;
+        return 0;
+      }
+      size_t piece = readPiece;
+      staging->flush();
+      staging->storage().copyTo(transfer.buffer, static_cast<size_t>(readAllocation.offset), transfer.offset, piece);
+      staging->endFrame();
+      transfer.offset += piece;
+      if (transfer.offset < transfer.size)
+        read(transfer);
+      return piece;
+    }
+
+    JobSystem* jobs;
+    std::unique_ptr<StreamBuffer> staging;
+    AsyncFileReader* files = nullptr;
+    // the streamed piece in flight
+    JobSystem::JobHandle reading;
+    StreamBuffer::Allocation readAllocation;
+    size_t readPiece = 0;
+    bool readSucceeded = false;
+  };
+
+  // a section of a cooked file as an array; the header's ranges are validated before any of these
+  template <typename T>
+  std::span<const T> cookedSection(const MappedFile& file, CookedMesh::Section section) {
+    const CookedMesh::SectionRange& range = reinterpret_cast<const CookedMesh::Header*>(file.data())->sections[section];
+    return {reinterpret_cast<const T*>(file.data() + range.offset), static_cast<size_t>(range.size / sizeof(T))};
+  }
+
+  struct BufferSpan {
+    const uint8_t* data;
+    size_t size;
+  };
+
+  // tinygltf would decode every image to RGBA8 while it parses, one after the other; keepImage keeps
+  // the encoded bytes for GltfScene::images() instead, the caller decodes them in parallel
+  bool keepImage(tinygltf::Image*, const int index, std::string*, std::string*, int, int, const unsigned char* bytes, int size, void* images) {
+    auto& kept = *static_cast<std::vector<GltfScene::Image>*>(images);
+    if (index < 0)
+      return false;
+    if (static_cast<size_t>(index) >= kept.size())
+      kept.resize(static_cast<size_t>(index) + 1);
+    kept[index].encoded.assign(bytes, bytes + size);
+    return true;
+  }
+
+  // glb: 12 byte header (magic, version, length), then chunks of (length, type, data padded to 4 bytes),
+  // the JSON chunk first and an optional binary chunk after it; all little endian
+  constexpr uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+  constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+  constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+  struct GlbChunks {
+    const char* json = nullptr;
+    size_t jsonLength = 0;
+    const uint8_t* bin = nullptr;
+    size_t binLength = 0;
+  };
+
+  uint32_t readUint32(const uint8_t* bytes) {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+
+  bool splitGlb(const MappedFile& file, GlbChunks& chunks, std::string& error) {
+    const uint8_t* bytes = file.data();
+    if (file.size() < 20 || readUint32(bytes) != GLB_MAGIC || readUint32(bytes + 4) != 2) {
+      error = "not a glTF 2.0 binary";
+      return false;
+    }
+    size_t length = std::min<size_t>(readUint32(bytes + 8), file.size());
+    size_t offset = 12;
+    while (offset + 8 <= length) {
+      size_t chunkLength = readUint32(bytes + offset);
+      uint32_t chunkType = readUint32(bytes + offset + 4);
+      if (chunkLength > length - offset - 8) {
+        error = "chunk reaches past the end of the file";
+        return false;
+      }
+      if (chunkType == GLB_CHUNK_JSON && !chunks.json) {
+        chunks.json = reinterpret_cast<const char*>(bytes + offset + 8);
+        chunks.jsonLength = chunkLength;
+      } else if (chunkType == GLB_CHUNK_BIN && !chunks.bin) {
+        chunks.bin = bytes + offset + 8;
+        chunks.binLength = chunkLength;
+      }
+      offset += 8 + (chunkLength + 3) / 4 * 4;
+    }
+    if (!chunks.json)
+      error = "no JSON chunk";
+    return chunks.json != nullptr;
+  }
+
+  int accessorType(const std::string& type) {
+    if (type == "SCALAR") return TINYGLTF_TYPE_SCALAR;
+    if (type == "VEC2") return TINYGLTF_TYPE_VEC2;
+    if (type == "VEC3") return TINYGLTF_TYPE_VEC3;
+    if (type == "VEC4") return TINYGLTF_TYPE_VEC4;
+    if (type == "MAT2") return TINYGLTF_TYPE_MAT2;
+    if (type == "MAT3") return TINYGLTF_TYPE_MAT3;
+    if (type == "MAT4") return TINYGLTF_TYPE_MAT4;
+    return -1;
+  }
+
+  // the part of a glTF document GltfScene uses, read with the JSON parser tinygltf bundles into a model
+  // whose buffers have no data; images are only referenced, animations, skins and extensions are left out
+  bool parseGltfJson(const char* text, size_t length, tinygltf::Model& model, std::string& error) {
+    nlohmann::json document = nlohmann::json::parse(text, text + length, nullptr, false);
+    if (document.is_discarded() || !document.is_object()) {
+      error = "invalid JSON chunk";
+      return false;
+    }
+    const nlohmann::json empty = nlohmann::json::array();
+    auto list = [&](const char* key) -> const nlohmann::json& {
+      auto found = document.find(key);
+      return found != document.end() && found->is_array() ? *found : empty;
+    };
+    try {
+      for (const nlohmann::json& source : list("buffers")) {
+        tinygltf::Buffer buffer;
+        buffer.uri = source.value("uri", std::string());
+        model.buffers.push_back(buffer);
+      }
+      for (const nlohmann::json& source : list("bufferViews")) {
+        tinygltf::BufferView view;
+        view.buffer = source.value("buffer", -1);
+        view.byteOffset = source.value("byteOffset", size_t(0));
+        view.byteLength = source.value("byteLength", size_t(0));
+        view.byteStride = source.value("byteStride", size_t(0));
+        view.target = source.value("target", 0);
+        model.bufferViews.push_back(view);
+      }
+      for (const nlohmann::json& source : list("accessors")) {
+        tinygltf::Accessor accessor;
+        accessor.bufferView = source.value("bufferView", -1);
+        accessor.byteOffset = source.value("byteOffset", size_t(0));
+        accessor.normalized = source.value("normalized", false);
+        accessor.componentType = source.value("componentType", -1);
+        accessor.count = source.value("count", size_t(0));
+        accessor.type = accessorType(source.value("type", std::string()));
+        accessor.minValues = source.value("min", std::vector<double>());
+        accessor.maxValues = source.value("max", std::vector<double>());
+        accessor.sparse.isSparse = source.contains("sparse");
+        model.accessors.push_back(accessor);
+      }
+      for (const nlohmann::json& source : list("meshes")) {
+        tinygltf::Mesh mesh;
+        mesh.name = source.value("name", std::string());
+        for (const nlohmann::json& primitiveSource : source.value("primitives", nlohmann::json::array())) {
+          tinygltf::Primitive primitive;
+          primitive.attributes = primitiveSource.value("attributes", std::map<std::string, int>());
+          primitive.indices = primitiveSource.value("indices", -1);
+          primitive.material = primitiveSource.value("material", -1);
+          primitive.mode = primitiveSource.value("mode", TINYGLTF_MODE_TRIANGLES);
+          mesh.primitives.push_back(primitive);
+        }
+        model.meshes.push_back(mesh);
+      }
+      for (const nlohmann::json& source : list("materials")) {
+        tinygltf::Material material;
+        material.emissiveFactor = source.value("emissiveFactor", std::vector<double>{0.0, 0.0, 0.0});
+        material.alphaMode = source.value("alphaMode", std::string("OPAQUE"));
+        material.alphaCutoff = source.value("alphaCutoff", 0.5);
+        material.doubleSided = source.value("doubleSided", false);
+        material.normalTexture.index = source.value("normalTexture", nlohmann::json::object()).value("index", -1);
+        nlohmann::json pbr = source.value("pbrMetallicRoughness", nlohmann::json::object());
+        material.pbrMetallicRoughness.baseColorFactor = pbr.value("baseColorFactor", std::vector<double>{1.0, 1.0, 1.0, 1.0});
+        material.pbrMetallicRoughness.metallicFactor = pbr.value("metallicFactor", 1.0);
+        material.pbrMetallicRoughness.roughnessFactor = pbr.value("roughnessFactor", 1.0);
+        material.pbrMetallicRoughness.baseColorTexture.index = pbr.value("baseColorTexture", nlohmann::json::object()).value("index", -1);
+        model.materials.push_back(material);
+      }
+      for (const nlohmann::json& source : list("textures")) {
+        tinygltf::Texture texture;
+        texture.source = source.value("source", -1);
+        model.textures.push_back(texture);
+      }
+      for (const nlohmann::json& source : list("images")) {
+        tinygltf::Image image;
+        image.uri = source.value("uri", std::string());
+        image.bufferView = source.value("bufferView", -1);
+        image.mimeType = source.value("mimeType", std::string());
+        model.images.push_back(image);
+      }
+      for (const nlohmann::json& source : list("nodes")) {
+        tinygltf::Node node;
+        node.mesh = source.value("mesh", -1);
+        node.children = source.value("children", std::vector<int>());
+        node.matrix = source.value("matrix", std::vector<double>());
+        node.translation = source.value("translation", std::vector<double>());
+        node.rotation = source.value("rotation", std::vector<double>());
+        node.scale = source.value("scale", std::vector<double>());
+        model.nodes.push_back(node);
+      }
+      for (const nlohmann::json& source : list("scenes")) {
+        tinygltf::Scene scene;
+        scene.nodes = source.value("nodes", std::vector<int>());
+        model.scenes.push_back(scene);
+      }
+      model.defaultScene = document.value("scene", -1);
+    } catch (const nlohmann::json::exception& exception) {
+      error = exception.what();
+      return false;
+    }
+    return true;
+  }
+}
+
+void GltfScene::Stats::print(const std::string& name) const {
+  double seconds = (parseMilliseconds + uploadMilliseconds) / 1000.0;
+  double megabytes = bufferBytes / (1024.0 * 1024.0);
+  std::cout << "glTF " << name << ": " << megabytes << " MB in " << parseMilliseconds + uploadMilliseconds << " ms ("
+            << (cooked ? "validate " : "parse ") << parseMilliseconds << " ms, upload " << uploadMilliseconds << " ms), "
+            << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s, " << triangles << " triangles, "
+            << (seconds > 0.0 ? triangles / seconds / 1e6 : 0.0) << " Mtris/s, ";
+  if (cooked)
+    std::cout << bufferViews << " uploads, " << primitives << " primitives, " << lods << " LODs, " << meshlets << " meshlets; cooked, ";
+  else
+    std::cout << bufferViews << " buffer view uploads for " << accessors << " accessors, " << primitives << " primitives; "
+              << (mapped ? "mapped, " : "read by tinygltf, ");
+  std::cout << (streamed ? (ioUring ? "streamed (io_uring)" : "streamed (pread)") : staged ? "staged" : "direct") << " uploads, peak RSS " << peakResidentBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+std::vector<GltfScene::Node> GltfScene::flattenNodes(const tinygltf::Model& model) {
+  // the default scene (or the first one) depth first, parents before their children; a file without
+  // scenes shows every root node
+  std::vector<int> roots;
+  if (!model.scenes.empty()) {
+    int scene = model.defaultScene >= 0 && model.defaultScene < static_cast<int>(model.scenes.size()) ? model.defaultScene : 0;
+    roots = model.scenes[scene].nodes;
+  } else {
+    std::vector<bool> isChild(model.nodes.size(), false);
+    for (const tinygltf::Node& node : model.nodes)
+      for (int child : node.children)
+        if (child >= 0 && child < static_cast<int>(model.nodes.size()))
+          isChild[child] = true;
+    for (size_t i = 0; i < model.nodes.size(); i++)
+      if (!isChild[i])
+        roots.push_back(static_cast<int>(i));
+  }
+  std::vector<Node> nodes;
+  std::vector<bool> visited(model.nodes.size(), false);
+  // (glTF node, parent scene node)
+  std::vector<std::pair<int, int>> stack;
+  for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+    stack.push_back({*root, -1});
+  while (!stack.empty()) {
+    auto [index, parent] = stack.back();
+    stack.pop_back();
+    if (index < 0 || index >= static_cast<int>(model.nodes.size()) || visited[index])
+      continue;
+    visited[index] = true;
+    const tinygltf::Node& source = model.nodes[index];
+    Node node;
+    node.parent = parent;
+    node.mesh = source.mesh >= 0 && source.mesh < static_cast<int>(model.meshes.size()) ? source.mesh : -1;
+    node.world = parent >= 0 ? multiply(nodes[parent].world, localMatrix(source)) : localMatrix(source);
+    nodes.push_back(node);
+    int self = static_cast<int>(nodes.size()) - 1;
+    for (auto child = source.children.rbegin(); child != source.children.rend(); ++child)
+      stack.push_back({*child, self});
+  }
+  return nodes;
+}
+
+std::vector<float> GltfScene::packMaterials(const tinygltf::Model& model) {
+  std::vector<float> materialData;
+  materialData.reserve((model.materials.size() + 1) * MATERIAL_TEXELS * 4);
+  auto factor = [](const std::vector<double>& values, size_t i, float fallback) {
+    return i < values.size() ? static_cast<float>(values[i]) : fallback;
+  };
+  for (const tinygltf::Material& material : model.materials) {
+    const tinygltf::PbrMetallicRoughness& pbr = material.pbrMetallicRoughness;
+    for (size_t i = 0; i < 4; i++)
+      materialData.push_back(factor(pbr.baseColorFactor, i, 1.0f));
+    for (size_t i = 0; i < 3; i++)
+      materialData.push_back(factor(material.emissiveFactor, i, 0.0f));
+    // 0 never discards
+    materialData.push_back(material.alphaMode == "MASK" ? static_cast<float>(material.alphaCutoff) : 0.0f);
+    materialData.push_back(static_cast<float>(pbr.metallicFactor));
+    materialData.push_back(static_cast<float>(pbr.roughnessFactor));
+    materialData.push_back(static_cast<float>(pbr.baseColorTexture.index));
+    materialData.push_back(static_cast<float>(material.normalTexture.index));
+  }
+  // the default material: white, not emissive, opaque, fully metallic and rough, untextured
+  materialData.insert(materialData.end(), {1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, -1.0f, -1.0f});
+  return materialData;
+}
+
+// what prepare() leaves to uploadStep(): the file or model the bytes are in and the GL objects to make
+struct GltfScene::Pending {
+  enum class Target { Geometry, Nodes, Materials };
+
+  // the bytes of one Buffer: inside the mapping, the model's buffers or owned (converted indices,
+  // texels); streamed ones are a range of the file instead
+  struct Source {
+    Target target = Target::Geometry;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    bool streamed = false;
+    uint64_t fileOffset = 0;
+    std::vector<uint8_t> owned;
+  };
+
+  // buffer is an index into GltfScene::buffers
+  struct Attribute {
+    unsigned int location;
+    uint32_t buffer;
+    intptr_t offset;
+    int stride;
+    int components;
+    unsigned int type;
+    bool normalized;
+  };
+  struct VertexArraySource {
+    std::vector<Attribute> attributes;
+    int compressedBuffer = -1;  // cooked: every CompressedVertex attribute out of this buffer
+    uint32_t indexBuffer = 0;
+  };
+
+  std::string path;
+  Upload upload = Upload::Auto;
+  JobSystem* jobs = nullptr;
+  AsyncFileReader* files = nullptr;
+  MappedFile file;
+  tinygltf::Model model;
+  // geometry first, in the order of buffers, then the node and material texels
+  std::vector<Source> sources;
+  std::vector<VertexArraySource> vertexArrays;
+  // the vertex array of every primitive
+  std::vector<uint32_t> primitiveVertexArrays;
+
+  // uploadStep() only
+  std::unique_ptr<Uploader> uploader;
+  size_t nextSource = 0;
+  std::optional<Uploader::Transfer> transfer;
+  double uploadMilliseconds = 0.0;
+
+  uint32_t add(Source source) {
+    sources.push_back(std::move(source));
+    return static_cast<uint32_t>(sources.size() - 1);
+  }
+};
+
+GltfScene::GltfScene() = default;
+GltfScene::~GltfScene() = default;
+GltfScene::GltfScene(GltfScene&&) noexcept = default;
+GltfScene& GltfScene::operator=(GltfScene&&) noexcept = default;
+
+bool GltfScene::load(const std::string& path, Upload upload, JobSystem* jobs, AsyncFileReader* files) {
+  if (!prepare(path, upload, jobs, files))
+    return false;
+  while (uploadStep())
+    pending->uploader->wait();
+  return static_cast<bool>(*this);
+}
+
+bool GltfScene::prepare(const std::string& path, Upload upload, JobSystem* jobs, AsyncFileReader* files) {
+  *this = GltfScene();
+  pending = std::make_unique<Pending>();
+  pending->path = path;
+  pending->upload = upload == Upload::Streamed && !files ? Upload::Staged : upload;
+  pending->jobs = jobs;
+  pending->files = files;
+  bool prepared = endsWith(path, CookedMesh::EXTENSION) ? prepareCooked() : prepareGltf();
+  if (!prepared)
+    *this = GltfScene();
+  return prepared;
+}
+
+bool GltfScene::prepareGltf() {
+  Pending& plan = *pending;
+  const std::string& path = plan.path;
+  JobSystem* jobs = plan.jobs;
+  auto start = std::chrono::steady_clock::now();
+  tinygltf::Model& model = plan.model;
+  // where the bytes of each glTF buffer are: inside the mapping or in model.buffers
+  std::vector<BufferSpan> bufferSpans;
+  MappedFile& file = plan.file;
+  if (endsWith(path, ".glb")) {
+    file = MappedFile(path);
+    if (!file)
+      return false;
+    GlbChunks chunks;
+    std::string error;
+    if (!splitGlb(file, chunks, error) || !parseGltfJson(chunks.json, chunks.jsonLength, model, error)) {
+      std::cout << "ERROR::GLTF::LOAD_FAILED " << path << "\n" << error << std::endl;
+      return false;
+    }
+    // the binary chunk is buffer 0; a glb that also references files goes through tinygltf instead
+    bool external = false;
+    for (size_t i = 0; i < model.buffers.size(); i++) {
+      if (!model.buffers[i].uri.empty() || i > 0)
+        external = true;
+      else
+        bufferSpans.push_back({chunks.bin, chunks.binLength});
+    }
+    if (external) {
+      std::cout << "glTF " << path << " references external buffers, reading it through tinygltf" << std::endl;
+      file = MappedFile();
+      bufferSpans.clear();
+      model = tinygltf::Model();
+    } else {
+      loadStats.mapped = true;
+    }
+  }
+  if (!loadStats.mapped) {
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(keepImage, &sourceImages);
+    std::string error, warning;
+    bool loaded = endsWith(path, ".glb") ? loader.LoadBinaryFromFile(&model, &error, &warning, path)
+                                         : loader.LoadASCIIFromFile(&model, &error, &warning, path);
+    if (!warning.empty())
+      std::cout << "WARNING::GLTF " << warning << std::endl;
+    if (!loaded) {
+      std::cout << "ERROR::GLTF::LOAD_FAILED " << path << "\n" << error << std::endl;
+      return false;
+    }
+    for (const tinygltf::Buffer& buffer : model.buffers)
+      bufferSpans.push_back({buffer.data.data(), buffer.data.size()});
+  }
+  for (const BufferSpan& span : bufferSpans)
+    loadStats.bufferBytes += span.size;
+  // everything below reads buffer views through their spans, a malformed file must not reach past them
+  for (const tinygltf::BufferView& view : model.bufferViews)
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(bufferSpans.size()) || view.byteOffset > bufferSpans[view.buffer].size ||
+        view.byteLength > bufferSpans[view.buffer].size - view.byteOffset) {
+      std::cout << "ERROR::GLTF::BUFFER_VIEW_OUT_OF_RANGE " << path << std::endl;
+      return false;
+    }
+
+  // images
+  // ------
+  // left encoded for the caller: tinygltf handed their bytes to keepImage, the mapped path copies them
+  // out of their buffer view or leaves the path of their file
+  sourceImages.resize(model.images.size());
+  for (size_t i = 0; i < model.images.size(); i++) {
+    const tinygltf::Image& image = model.images[i];
+    Image& target = sourceImages[i];
+    if (!target.encoded.empty())
+      continue;
+    if (image.bufferView >= 0 && image.bufferView < static_cast<int>(model.bufferViews.size())) {
+      const tinygltf::BufferView& view = model.bufferViews[image.bufferView];
+      const uint8_t* bytes = bufferSpans[view.buffer].data + view.byteOffset;
+      target.encoded.assign(bytes, bytes + view.byteLength);
+    } else if (!image.uri.empty() && image.uri.rfind("data:", 0) != 0) {
+      target.path = path.substr(0, path.find_last_of("/\\") + 1) + image.uri;
+    } else if (!image.uri.empty()) {
+      std::cout << "WARNING::GLTF::UNSUPPORTED_IMAGE " << i << " is a data URI in a mapped .glb" << std::endl;
+    }
+  }
+  textures.resize(sourceImages.size());
+
+  // buffer views
+  // ------------
+  // one Buffer per view however many accessors read from it, in the order the meshes first use them.
+  // mapped pages are released as soon as their view is on the GPU side; buffer views are interleaved
+  // with the JSON chunk and images, there are no large ranges to stream
+  if (plan.upload == Upload::Streamed)
+    plan.upload = Upload::Staged;
+  std::vector<int> viewBuffers(model.bufferViews.size(), -1);
+  std::vector<bool> accessorUsed(model.accessors.size(), false);
+  auto viewBuffer = [&](int accessorIndex) -> uint32_t {
+    accessorUsed[accessorIndex] = true;
+    int viewIndex = model.accessors[accessorIndex].bufferView;
+    if (viewBuffers[viewIndex] < 0) {
+      const tinygltf::BufferView& view = model.bufferViews[viewIndex];
+      Pending::Source source;
+      source.data = bufferSpans[view.buffer].data + view.byteOffset;
+      source.size = view.byteLength;
+      source.mapped = loadStats.mapped;
+      viewBuffers[viewIndex] = static_cast<int>(plan.add(std::move(source)));
+      loadStats.bufferViews++;
+      loadStats.uploadedBytes += view.byteLength;
+    }
+    return static_cast<uint32_t>(viewBuffers[viewIndex]);
+  };
+  auto readable = [&](int accessorIndex, const char* what) {
+    if (accessorIndex < 0 || accessorIndex >= static_cast<int>(model.accessors.size()))
+      return false;
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    if (accessor.sparse.isSparse || accessor.bufferView < 0 || accessor.bufferView >= static_cast<int>(model.bufferViews.size())) {
+      std::cout << "WARNING::GLTF::UNSUPPORTED_ACCESSOR " << what << " is sparse or has no buffer view" << std::endl;
+      return false;
+    }
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    int stride = accessor.ByteStride(view);
+    int element = tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+    // count is bounded by division, a huge one would overflow byteOffset + (count - 1) * stride
+    if (stride <= 0 || element <= 0 || accessor.count == 0 || accessor.byteOffset > view.byteLength ||
+        view.byteLength - accessor.byteOffset < static_cast<size_t>(element) ||
+        accessor.count > (view.byteLength - accessor.byteOffset - element) / stride + 1) {
+      std::cout << "WARNING::GLTF::INVALID_ACCESSOR " << what << " doesn't fit its buffer view" << std::endl;
+      return false;
+    }
+    return true;
+  };
+
+  // meshes
+  // ------
+  for (const tinygltf::Mesh& mesh : model.meshes) {
+    uint32_t first = static_cast<uint32_t>(primitives.size());
+    for (const tinygltf::Primitive& source : mesh.primitives) {
+      // tinygltf reports a missing mode as -1 in some versions
+      if (source.mode != TINYGLTF_MODE_TRIANGLES && source.mode != -1) {
+        std::cout << "WARNING::GLTF::UNSUPPORTED_MODE " << source.mode << " in mesh " << mesh.name << std::endl;
+        continue;
+      }
+      auto position = source.attributes.find("POSITION");
+      if (position == source.attributes.end() || !readable(position->second, "POSITION"))
+        continue;
+
+      Pending::VertexArraySource vertexArray;
+      for (const AttributeSemantic& semantic : ATTRIBUTES) {
+        auto attribute = source.attributes.find(semantic.name);
+        if (attribute == source.attributes.end() || !readable(attribute->second, semantic.name))
+          continue;
+        const tinygltf::Accessor& accessor = model.accessors[attribute->second];
+        int stride = accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+        if (stride <= 0)
+          continue;
+        vertexArray.attributes.push_back({semantic.location, viewBuffer(attribute->second), static_cast<intptr_t>(accessor.byteOffset), stride,
+                                          tinygltf::GetNumComponentsInType(accessor.type), static_cast<unsigned int>(accessor.componentType),
+                                          accessor.normalized});
+      }
+
+      Primitive primitive;
+      Lod lod;
+      if (source.indices >= 0) {
+        if (!readable(source.indices, "indices"))
+          continue;
+        const tinygltf::Accessor& accessor = model.accessors[source.indices];
+        lod.indexCount = static_cast<unsigned int>(accessor.count);
+        if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+          // GL draws byte indices but can't multi-draw them, they get a 16 bit buffer of their own
+          const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+          const uint8_t* bytes = bufferSpans[view.buffer].data + view.byteOffset + accessor.byteOffset;
+          size_t step = view.byteStride ? view.byteStride : 1;
+          Pending::Source widened;
+          widened.size = accessor.count * sizeof(uint16_t);
+          widened.owned.resize(widened.size);
+          uint16_t* indices = reinterpret_cast<uint16_t*>(widened.owned.data());
+          forRange(jobs, accessor.count, JOB_BYTES, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+              indices[i] = bytes[i * step];
+          });
+          loadStats.uploadedBytes += widened.size;
+          accessorUsed[source.indices] = true;
+          vertexArray.indexBuffer = plan.add(std::move(widened));
+          primitive.shortIndices = true;
+        } else {
+          vertexArray.indexBuffer = viewBuffer(source.indices);
+          lod.indexOffset = accessor.byteOffset;
+          primitive.shortIndices = accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+        }
+      } else {
+        size_t count = model.accessors[position->second].count;
+        Pending::Source sequential;
+        sequential.size = count * sizeof(uint32_t);
+        sequential.owned.resize(sequential.size);
+        uint32_t* indices = reinterpret_cast<uint32_t*>(sequential.owned.data());
+        forRange(jobs, count, JOB_BYTES, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++)
+            indices[i] = static_cast<uint32_t>(i);
+        });
+        loadStats.uploadedBytes += sequential.size;
+        vertexArray.indexBuffer = plan.add(std::move(sequential));
+        lod.indexCount = static_cast<unsigned int>(count);
+      }
+      if (lod.indexCount == 0)
+        continue;
+
+      primitive.material = source.material >= 0 && source.material < static_cast<int>(model.materials.size())
+        ? static_cast<uint32_t>(source.material) : static_cast<uint32_t>(model.materials.size());
+      primitive.blend = primitive.material < model.materials.size() && model.materials[primitive.material].alphaMode == "BLEND";
+      primitive.firstLod = static_cast<uint32_t>(lods.size());
+      lods.push_back(lod);
+      primitives.push_back(primitive);
+      plan.primitiveVertexArrays.push_back(static_cast<uint32_t>(plan.vertexArrays.size()));
+      plan.vertexArrays.push_back(std::move(vertexArray));
+    }
+    meshes.push_back({first, static_cast<uint32_t>(primitives.size()) - first});
+  }
+  loadStats.primitives = primitives.size();
+  loadStats.accessors = std::count(accessorUsed.begin(), accessorUsed.end(), true);
+
+  // node hierarchy
+  // --------------
+  nodes = flattenNodes(model);
+  if (nodes.empty()) {
+    std::cout << "ERROR::GLTF::EMPTY_SCENE " << path << std::endl;
+    return false;
+  }
+
+  // bounds and triangles of every mesh instance; POSITION min/max are required by the spec
+  bool bounded = false;
+  for (const Node& node : nodes) {
+    if (node.mesh < 0)
+      continue;
+    for (uint32_t i = 0; i < meshes[node.mesh][1]; i++)
+      loadStats.triangles += lods[primitives[meshes[node.mesh][0] + i].firstLod].indexCount / 3;
+    for (const tinygltf::Primitive& source : model.meshes[node.mesh].primitives) {
+      auto position = source.attributes.find("POSITION");
+      if (position == source.attributes.end() || position->second < 0 || position->second >= static_cast<int>(model.accessors.size()))
+        continue;
+      const tinygltf::Accessor& accessor = model.accessors[position->second];
+      if (accessor.minValues.size() < 3 || accessor.maxValues.size() < 3)
+        continue;
+      for (int corner = 0; corner < 8; corner++) {
+        float local[3];
+        for (int axis = 0; axis < 3; axis++)
+          local[axis] = static_cast<float>(corner & (1 << axis) ? accessor.maxValues[axis] : accessor.minValues[axis]);
+        for (int axis = 0; axis < 3; axis++) {
+          float world = node.world[axis] * local[0] + node.world[4 + axis] * local[1] + node.world[8 + axis] * local[2] + node.world[12 + axis];
+          lower[axis] = bounded ? std::min(lower[axis], world) : world;
+          upper[axis] = bounded ? std::max(upper[axis], world) : world;
+        }
+        bounded = true;
+      }
+    }
+  }
+
+  // node and material texels
+  // ------------------------
+  Pending::Source nodeData;
+  nodeData.target = Pending::Target::Nodes;
+  nodeData.size = nodes.size() * NODE_TEXELS * 4 * sizeof(float);
+  nodeData.owned.resize(nodeData.size);
+  for (size_t i = 0; i < nodes.size(); i++)
+    std::memcpy(nodeData.owned.data() + i * NODE_TEXELS * 4 * sizeof(float), nodes[i].world.data(), NODE_TEXELS * 4 * sizeof(float));
+  std::vector<float> materials = packMaterials(model);
+  for (const tinygltf::Material& material : model.materials) {
+    int texture = material.pbrMetallicRoughness.baseColorTexture.index;
+    int image = texture >= 0 && texture < static_cast<int>(model.textures.size()) ? model.textures[texture].source : -1;
+    materialImages.push_back(image >= 0 && image < static_cast<int>(sourceImages.size()) ? image : -1);
+  }
+  materialImages.push_back(-1);
+  Pending::Source materialData;
+  materialData.target = Pending::Target::Materials;
+  materialData.size = materials.size() * sizeof(float);
+  materialData.owned.resize(materialData.size);
+  std::memcpy(materialData.owned.data(), materials.data(), materialData.size);
+  loadStats.uploadedBytes += nodeData.size + materialData.size;
+  plan.add(std::move(nodeData));
+  plan.add(std::move(materialData));
+  loadStats.parseMilliseconds = millisecondsSince(start);
+  return true;
+}
+
+bool GltfScene::prepareCooked() {
+  using namespace CookedMesh;
+  Pending& plan = *pending;
+  const std::string& path = plan.path;
+  auto start = std::chrono::steady_clock::now();
+  MappedFile& file = plan.file;
+  file = MappedFile(path);
+  if (!file)
+    return false;
+  auto invalid = [&](const char* reason) {
+    std::cout << "ERROR::GLTF::INVALID_COOKED_FILE " << path << ": " << reason << std::endl;
+    return false;
+  };
+
+  // validation
+  // ----------
+  // nothing is parsed, but the header, the ranges and the indices into the tables below are checked
+  // once here. the index values are not: scanning them would read every index page before the upload
+  // (and around Upload::Streamed). a cooked file is trusted to come from asset_cooker, a corrupt one
+  // can make the GPU fetch past the vertex buffer, core GL doesn't bound that without robust access
+  if (file.size() < sizeof(Header))
+    return invalid("truncated header");
+  const Header& header = *reinterpret_cast<const Header*>(file.data());
+  if (header.magic != MAGIC)
+    return invalid("not a cooked mesh");
+  if (header.version != VERSION)
+    return invalid("cooked by another version, cook it again");
+  if (header.fileSize != file.size() || header.vertexStride != sizeof(CompressedVertex))
+    return invalid("size or vertex format mismatch");
+  constexpr size_t ELEMENT_SIZES[SectionCount] = {sizeof(CompressedVertex), 2, sizeof(Mesh), sizeof(CookedMesh::Primitive), sizeof(CookedMesh::Lod),
+                                                  sizeof(CookedMesh::Meshlet), sizeof(uint32_t), 4, sizeof(CookedMesh::Material),
+                                                  NODE_TEXELS * 4 * sizeof(float), sizeof(CookedMesh::Node)};
+  for (unsigned int i = 0; i < SectionCount; i++) {
+    const SectionRange& range = header.sections[i];
+    if (range.offset % SECTION_ALIGNMENT != 0 || range.offset > file.size() || range.size > file.size() - range.offset ||
+        range.size % ELEMENT_SIZES[i] != 0)
+      return invalid("section out of range");
+  }
+  std::span<const Mesh> cookedMeshes = cookedSection<Mesh>(file, Meshes);
+  std::span<const CookedMesh::Primitive> cookedPrimitives = cookedSection<CookedMesh::Primitive>(file, Primitives);
+  std::span<const CookedMesh::Lod> cookedLods = cookedSection<CookedMesh::Lod>(file, Lods);
+  std::span<const CookedMesh::Node> cookedNodes = cookedSection<CookedMesh::Node>(file, Nodes);
+  size_t vertexCount = header.sections[Vertices].size / sizeof(CompressedVertex);
+  size_t indexBytes = header.sections[Indices].size;
+  size_t meshletCount = header.sections[Meshlets].size / sizeof(CookedMesh::Meshlet);
+  size_t materialCount = header.sections[Materials].size / sizeof(CookedMesh::Material);
+  if (vertexCount == 0 || indexBytes == 0)
+    return invalid("no geometry");
+  if (materialCount == 0 || cookedNodes.empty() || header.sections[NodeMatrices].size / (NODE_TEXELS * 4 * sizeof(float)) != cookedNodes.size())
+    return invalid("no materials or nodes");
+  for (const Mesh& mesh : cookedMeshes)
+    if (mesh.firstPrimitive > cookedPrimitives.size() || mesh.primitiveCount > cookedPrimitives.size() - mesh.firstPrimitive)
+      return invalid("mesh out of range");
+  for (const CookedMesh::Primitive& primitive : cookedPrimitives) {
+    size_t indexSize = primitive.flags & PRIMITIVE_SHORT_INDICES ? sizeof(uint16_t) : sizeof(uint32_t);
+    if (primitive.baseVertex > vertexCount || primitive.vertexCount > vertexCount - primitive.baseVertex ||
+        primitive.baseVertex > static_cast<uint32_t>(INT32_MAX) || primitive.lodCount == 0 ||
+        primitive.firstLod > cookedLods.size() || primitive.lodCount > cookedLods.size() - primitive.firstLod ||
+        primitive.firstMeshlet > meshletCount || primitive.meshletCount > meshletCount - primitive.firstMeshlet ||
+        primitive.material >= materialCount)
+      return invalid("primitive out of range");
+    for (uint32_t i = 0; i < primitive.lodCount; i++) {
+      const CookedMesh::Lod& lod = cookedLods[primitive.firstLod + i];
+      if (lod.indexOffset % indexSize != 0 || lod.indexOffset > indexBytes || lod.indexCount > (indexBytes - lod.indexOffset) / indexSize)
+        return invalid("LOD out of range");
+    }
+  }
+  for (size_t i = 0; i < cookedNodes.size(); i++)
+    if (cookedNodes[i].parent >= static_cast<int32_t>(i) || cookedNodes[i].parent < -1 ||
+        cookedNodes[i].mesh >= static_cast<int32_t>(cookedMeshes.size()) || cookedNodes[i].mesh < -1)
+      return invalid("node out of range");
+  // the images aren't cooked, every material draws untextured
+  materialImages.assign(materialCount, -1);
+  loadStats.cooked = true;
+  loadStats.mapped = true;
+  loadStats.bufferBytes = file.size();
+
+  // sections
+  // --------
+  // vertices and indices of every mesh are one buffer each under a single VAO, primitives only differ in
+  // baseVertex and index offsets; mapped pages are released behind the upload. streamed, every section
+  // but the node matrices (read below anyway) comes from the file instead of the mapping
+  auto addSection = [&](Section section, Pending::Target target) {
+    const SectionRange& range = header.sections[section];
+    Pending::Source source;
+    source.target = target;
+    source.data = file.data() + range.offset;
+    source.size = static_cast<size_t>(range.size);
+    source.mapped = true;
+    source.streamed = plan.upload == Upload::Streamed && section != NodeMatrices;
+    source.fileOffset = range.offset;
+    loadStats.uploadedBytes += source.size;
+    return plan.add(std::move(source));
+  };
+  Pending::VertexArraySource vertexArray;
+  vertexArray.compressedBuffer = static_cast<int>(addSection(Vertices, Pending::Target::Geometry));
+  vertexArray.indexBuffer = addSection(Indices, Pending::Target::Geometry);
+  plan.vertexArrays.push_back(std::move(vertexArray));
+  loadStats.bufferViews = plan.sources.size();
+  // the meshlet sections stay in the file, nothing draws or culls with them yet
+  loadStats.meshlets = meshletCount;
+
+  for (const Mesh& mesh : cookedMeshes)
+    meshes.push_back({mesh.firstPrimitive, mesh.primitiveCount});
+  for (const CookedMesh::Lod& lod : cookedLods)
+    lods.push_back({lod.indexCount, static_cast<uintptr_t>(lod.indexOffset), lod.error});
+  for (const CookedMesh::Primitive& source : cookedPrimitives) {
+    Primitive primitive;
+    primitive.baseVertex = static_cast<int>(source.baseVertex);
+    primitive.shortIndices = (source.flags & PRIMITIVE_SHORT_INDICES) != 0;
+    primitive.material = source.material;
+    primitive.blend = (source.flags & PRIMITIVE_BLEND) != 0;
+    primitive.firstLod = source.firstLod;
+    primitive.lodCount = source.lodCount;
+    primitives.push_back(primitive);
+    plan.primitiveVertexArrays.push_back(0);
+    loadStats.lods += source.lodCount - 1;
+  }
+  loadStats.primitives = primitives.size();
+
+  std::span<const float> matrices = cookedSection<float>(file, NodeMatrices);
+  for (size_t i = 0; i < cookedNodes.size(); i++) {
+    Node node;
+    node.parent = cookedNodes[i].parent;
+    node.mesh = cookedNodes[i].mesh;
+    std::copy_n(matrices.begin() + i * 16, 16, node.world.begin());
+    nodes.push_back(node);
+    if (node.mesh < 0)
+      continue;
+    for (uint32_t p = 0; p < meshes[node.mesh][1]; p++)
+      loadStats.triangles += lods[primitives[meshes[node.mesh][0] + p].firstLod].indexCount / 3;
+  }
+  std::copy_n(header.boundsMin, 3, lower.begin());
+  std::copy_n(header.boundsMax, 3, upper.begin());
+
+  // node matrices and materials are the texel layout already
+  addSection(NodeMatrices, Pending::Target::Nodes);
+  addSection(Materials, Pending::Target::Materials);
+  loadStats.parseMilliseconds = millisecondsSince(start);
+  return true;
+}
+
+bool GltfScene::uploadStep() {
+  if (!pending)
+    return false;
+  Pending& plan = *pending;
+  auto start = std::chrono::steady_clock::now();
+  if (!plan.uploader) {
+    plan.uploader = std::make_unique<Uploader>(plan.upload, plan.jobs, plan.files);
+    loadStats.staged = plan.uploader->staged();
+    loadStats.streamed = plan.uploader->streamed();
+    loadStats.ioUring = plan.uploader->ioUring();
+  }
+  Uploader& uploader = *plan.uploader;
+
+  // buffers
+  // -------
+  // about STAGING_BYTES per step, a direct upload goes in one piece; a streamed piece that is still
+  // being read ends the step early
+  size_t budget = STAGING_BYTES;
+  while (budget > 0 && plan.nextSource < plan.sources.size()) {
+    Pending::Source& source = plan.sources[plan.nextSource];
+    if (!plan.transfer) {
+      if (source.streamed)
+        plan.transfer = uploader.begin(plan.path, source.fileOffset, source.size);
+      else
+        plan.transfer = uploader.begin(source.owned.empty() ? source.data : source.owned.data(), source.size, source.mapped ? &plan.file : nullptr);
+    }
+    size_t uploaded = uploader.step(*plan.transfer);
+    if (plan.transfer->failed) {
+      std::cout << "ERROR::GLTF::INVALID_COOKED_FILE " << plan.path << ": section not read" << std::endl;
+      *this = GltfScene();
+      return false;
+    }
+    if (plan.transfer->offset < plan.transfer->size) {
+      if (uploaded == 0)
+        break;
+      budget -= std::min(budget, uploaded);
+      continue;
+    }
+    budget -= std::min(budget, uploaded);
+    Buffer buffer = std::move(plan.transfer->buffer);
+    plan.transfer.reset();
+    if (source.target == Pending::Target::Nodes)
+      nodeBuffer = std::move(buffer);
+    else if (source.target == Pending::Target::Materials)
+      materialBuffer = std::move(buffer);
+    else
+      buffers.push_back(std::move(buffer));
+    source.owned = {};
+    plan.nextSource++;
+  }
+  if (plan.nextSource < plan.sources.size()) {
+    plan.uploadMilliseconds += millisecondsSince(start);
+    return true;
+  }
+
+  // vertex arrays and texels
+  // ------------------------
+  for (const Pending::VertexArraySource& source : plan.vertexArrays) {
+    VertexArray vao;
+    if (source.compressedBuffer >= 0) {
+      vao.setVertexBuffer(0, buffers[source.compressedBuffer], 0, sizeof(CompressedVertex));
+      vao.setAttributes(0, vertexLayout<CompressedVertex>());
+    }
+    for (const Pending::Attribute& attribute : source.attributes) {
+      vao.setVertexBuffer(attribute.location, buffers[attribute.buffer], attribute.offset, attribute.stride);
+      vao.setAttribute(attribute.location, attribute.location, attribute.components, attribute.type, attribute.normalized, 0);
+    }
+    vao.setIndexBuffer(buffers[source.indexBuffer]);
+    vertexArrays.push_back(std::move(vao));
+  }
+  for (size_t i = 0; i < primitives.size(); i++)
+    primitives[i].vao = vertexArrays[plan.primitiveVertexArrays[i]].id();
+  nodeTexels = BufferTexture(nodeBuffer, GL_RGBA32F);
+  materialTexels = BufferTexture(materialBuffer, GL_RGBA32F);
+
+  // uploads are queued, the time counts until the driver has them
+  glFinish();
+  loadStats.uploadMilliseconds = plan.uploadMilliseconds + millisecondsSince(start);
+  loadStats.peakResidentBytes = ::peakResidentBytes();
+  pending.reset();
+  return false;
+}
+
+void GltfScene::setTexture(size_t image, Texture texture) {
+  // an upload that failed emptied the scene
+  if (image >= textures.size())
+    return;
+  textures[image] = std::move(texture);
+  sourceImages[image] = Image();
+}
+
+unsigned int GltfScene::baseColorTexture(uint32_t material) const {
+  int image = material < materialImages.size() ? materialImages[material] : -1;
+  return image >= 0 ? textures[image].id() : 0;
+}
+
+void GltfScene::submit(RenderQueue& queue, std::span<const uint32_t> materials, int drawLocation, unsigned int lod) const {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i].mesh < 0)
+      continue;
+    const std::array<uint32_t, 2>& range = meshes[nodes[i].mesh];
+    for (uint32_t p = range[0]; p < range[0] + range[1]; p++) {
+      const Primitive& primitive = primitives[p];
+      DrawPacket packet;
+      packet.material = materials[primitive.material];
+      packet.vao = primitive.vao;
+      const Lod& level = lods[primitive.firstLod + std::min(lod, primitive.lodCount - 1)];
+      packet.indexCount = level.indexCount;
+      packet.indexOffset = level.indexOffset;
+      packet.shortIndices = primitive.shortIndices;
+      packet.baseVertex = primitive.baseVertex;
+      packet.uniformLocation = drawLocation;
+      packet.uniform = {static_cast<float>(i), static_cast<float>(primitive.material), 0.0f, 0.0f};
+      queue.submit(primitive.blend ? RenderQueue::Transparent : RenderQueue::Opaque, packet);
+    }
+  }
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "resource.h"
+
+class RenderQueue;
+class JobSystem;
+class AsyncFileReader;
+namespace tinygltf { class Model; }
+
+// gltfScene: a glTF 2.0 file (.gltf with external or embedded buffers, or .glb) loaded through tinygltf
+//  - every buffer view a mesh accessor reads from is uploaded whole as one Buffer, so the accessors of
+//    a view (interleaved attributes, the indices of many primitives) cost a single upload together;
+//    each primitive is a VAO over those buffers at its accessors' offsets and strides
+//  - node world matrices of the default scene go into a buffer texture, NODE_TEXELS RGBA32F texels
+//    (columns) per node; material factors likewise, MATERIAL_TEXELS texels per material
+//  - images stay encoded, images() hands them to the caller to decode (AssetLoader::loadMesh) and
+//    setTexture() takes the textures back; a material samples its base color texture on
+//    BASE_COLOR_TEXTURE_UNIT. cooked scenes keep the texture indices but not the images
+//  - attribute locations: POSITION 0, NORMAL 1, TANGENT 2, TEXCOORD_0 3 (shader/gltf.vert)
+//  - unsigned byte indices are widened to 16 bit, non-indexed primitives get 32 bit indices, other
+//    modes than triangles and sparse accessors are skipped with a warning
+//  - a .glb is memory mapped and only its JSON chunk is parsed, buffer views are uploaded straight out
+//    of the binary chunk and their pages released behind the upload; tinygltf would read the file into
+//    memory and copy the binary chunk once more, about three times the file size at peak. a .glb with
+//    external buffers still goes through tinygltf; images aren't decoded on either path
+// geometry is uploaded as stored, it doesn't go through the mesh optimizer. a cooked scene
+// (CookedMesh::EXTENSION, written by asset_cooker) is optimized, compressed and has LODs: it is mapped,
+// validated and uploaded section by section without any parsing, see cooked_mesh.h.
+// a load is two phases: prepare() parses (or maps and validates) the file and converts indices
+// without any GL call, on any thread; uploadStep() then creates the GL objects about
+// STAGING_BYTES at a time on the thread that owns the context, so a caller can spread a large scene
+// over frames (AssetLoader::loadMesh). load() runs both in one go.
+// given a JobSystem, the CPU side of both fans out across its threads: staged copies out of the file
+// (and the page faults that read it) run in parallel pieces, direct uploads get their pages faulted in
+// by the workers first.
+// Upload::Streamed reads a cooked scene's large sections around the mapping through the given
+// AsyncFileReader (AssetLoader shares one across loads), a staging piece at a time on a worker while
+// the upload steps hand the pieces read so far to the GPU.
+// -----------------------------------
+class GltfScene {
+public:
+  static constexpr unsigned int NODE_TEXELS = 4;
+  // baseColorFactor | emissiveFactor, alphaCutoff | metallic, roughness, baseColorTexture, normalTexture
+  static constexpr unsigned int MATERIAL_TEXELS = 3;
+  // the unit of a Material's base color texture
+  static constexpr unsigned int BASE_COLOR_TEXTURE_UNIT = 0;
+  // texture units the scene's buffer textures are bound to, past the ones a Material uses
+  static constexpr unsigned int NODE_TEXTURE_UNIT = 4;
+  static constexpr unsigned int MATERIAL_TEXTURE_UNIT = 5;
+
+  enum class Upload {
+    Auto,    // Staged where buffers can be mapped persistently, Direct otherwise
+    Direct,  // the driver copies each buffer view out of the file data (glBufferStorage / glBufferData)
+    Staged,  // memcpy into a persistent-mapped StreamBuffer in STAGING_BYTES pieces, then a GPU copy
+    Streamed // cooked scenes: geometry sections are read by an AsyncFileReader (io_uring,
+             // O_DIRECT for large sections) instead of through the mapping, then staged; Staged
+             // for anything else or without a reader
+  };
+  static constexpr size_t STAGING_BYTES = 8 << 20;
+
+  struct Lod {
+    unsigned int indexCount = 0;
+    uintptr_t indexOffset = 0;  // bytes into the VAO's element buffer
+    float error = 0.0f;         // object space distance vertices moved by, 0 for the full mesh
+  };
+
+  struct Primitive {
+    unsigned int vao = 0;
+    int baseVertex = 0;
+    bool shortIndices = false;
+    uint32_t material = 0;      // entry of the material texture, the last one is the glTF default material
+    bool blend = false;         // alphaMode BLEND
+    uint32_t firstLod = 0;      // into lods; LOD 0 is the full mesh, a glTF primitive has only that one
+    uint32_t lodCount = 1;
+  };
+
+  struct Node {
+    int parent = -1;
+    int mesh = -1;
+    std::array<float, 16> world;  // column major; cooked scenes fold the mesh's position decode in
+  };
+
+  // an image as the file has it: the encoded bytes, or the file they are in
+  struct Image {
+    std::string path;
+    std::vector<uint8_t> encoded;
+  };
+
+  struct Stats {
+    size_t bufferBytes = 0;     // binary payload of the file (buffers, embedded images)
+    size_t uploadedBytes = 0;   // sent to GL
+    size_t bufferViews = 0;     // uploads of vertex and index data
+    size_t accessors = 0;       // vertex and index accessors served by them
+    size_t primitives = 0;
+    size_t triangles = 0;       // one instance per node
+    double parseMilliseconds = 0.0;   // prepare()
+    double uploadMilliseconds = 0.0;  // the upload steps, not the frames between them
+    size_t lods = 0;            // cooked: simplified levels beyond LOD 0
+    size_t meshlets = 0;        // cooked: validated, left in the file until something culls with them
+    bool mapped = false;
+    bool cooked = false;
+    bool staged = false;
+    bool streamed = false;
+    bool ioUring = false;       // streamed through io_uring, pread jobs otherwise
+    size_t peakResidentBytes = 0;  // of the process, right after the load
+
+    void print(const std::string& name) const;
+  };
+
+  GltfScene();
+  ~GltfScene();
+  GltfScene(GltfScene&&) noexcept;
+  GltfScene& operator=(GltfScene&&) noexcept;
+
+  // false (and the scene left empty) when tinygltf can't read the file or a cooked file is invalid
+  bool load(const std::string& path, Upload upload = Upload::Auto, JobSystem* jobs = nullptr,
+            AsyncFileReader* files = nullptr);
+  // the CPU phase of load(), false like it. any thread, the scene stays empty until the uploads are done
+  bool prepare(const std::string& path, Upload upload = Upload::Auto, JobSystem* jobs = nullptr,
+               AsyncFileReader* files = nullptr);
+  // the GL phase, GL thread: true while there is more to upload, call it again (e.g. next frame). a
+  // step ends early while a streamed piece is still being read; a streamed section that can't be read
+  // leaves the scene empty
+  bool uploadStep();
+  explicit operator bool() const { return !nodes.empty() && !pending; }
+  bool cooked() const { return loadStats.cooked; }
+
+  // one packet per primitive of every node with a mesh, materials holds the queue material of each
+  // scene material (materialCount()); drawLocation receives (node, material, 0, 0). lod picks the
+  // simplified indices, primitives with fewer LODs draw their last one
+  void submit(RenderQueue& queue, std::span<const uint32_t> materials, int drawLocation, unsigned int lod = 0) const;
+
+  // by glTF image index, empty for a cooked scene; the caller may move the bytes out
+  std::vector<Image>& images() { return sourceImages; }
+  // GL thread: the decoded image, in place of its bytes
+  void setTexture(size_t image, Texture texture);
+  // the glTF default material included
+  size_t materialCount() const { return materialImages.size(); }
+  // 0 when the material has no base color texture or it isn't set (yet)
+  unsigned int baseColorTexture(uint32_t material) const;
+
+  // shared with asset_cooker: the default scene's nodes parents first with their world matrices, and
+  // the material texels, MATERIAL_TEXELS * 4 floats per material with the glTF default material last
+  static std::vector<Node> flattenNodes(const tinygltf::Model& model);
+  static std::vector<float> packMaterials(const tinygltf::Model& model);
+
+  const std::vector<Node>& sceneNodes() const { return nodes; }
+  const BufferTexture& nodeTexture() const { return nodeTexels; }
+  const BufferTexture& materialTexture() const { return materialTexels; }
+  // world space bounds of all mesh nodes
+  const std::array<float, 3>& boundsMin() const { return lower; }
+  const std::array<float, 3>& boundsMax() const { return upper; }
+  const Stats& stats() const { return loadStats; }
+
+private:
+  struct Pending;
+
+  bool prepareGltf();
+  bool prepareCooked();
+
+  std::vector<Buffer> buffers;
+  std::vector<VertexArray> vertexArrays;
+  // meshes[i] = range of primitives
+  std::vector<std::array<uint32_t, 2>> meshes;
+  std::vector<Primitive> primitives;
+  std::vector<Lod> lods;
+  std::vector<Node> nodes;
+  Buffer nodeBuffer;
+  Buffer materialBuffer;
+  BufferTexture nodeTexels;
+  BufferTexture materialTexels;
+  std::vector<Image> sourceImages;
+  std::vector<Texture> textures;
+  // the image of each material's base color texture, -1 for none
+  std::vector<int> materialImages;
+  std::array<float, 3> lower = {};
+  std::array<float, 3> upper = {};
+  Stats loadStats;
+  // between prepare() and the last uploadStep()
+  std::unique_ptr<Pending> pending;
+};
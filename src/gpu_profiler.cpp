@@ -0,0 +1,165 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <glad/glad.h>
+
+GpuProfiler::GpuProfiler(unsigned int maxZonesPerFrame) : maxZones(maxZonesPerFrame + 1) {
+  // timestamp queries are core since 3.3
+  queriesSupported = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+  if (!queriesSupported) {
+    std::cout << "GpuProfiler: timer queries not supported, GPU zones are disabled" << std::endl;
+    gpuToTraceUs = 0.0;
+    return;
+  }
+  for (auto& frame : frames) {
+    frame.queries.resize(maxZones * 2);
+    glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    frame.zones.reserve(maxZones);
+  }
+  // one synchronous read of the GPU clock at startup, never per frame
+  GLint64 gpuNow = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+  gpuToTraceUs = traceNowUs() - gpuNow / 1000.0;
+  lastReport = std::chrono::steady_clock::now();
+}
+
+GpuProfiler::~GpuProfiler() {
+  if (!queriesSupported)
+    return;
+  for (auto& frame : frames)
+    glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+}
+
+void GpuProfiler::beginFrame() {
+  if (!queriesSupported)
+    return;
+  // the slot of this frame was last used LATENCY frames ago, its results are due now
+  FrameQueries& frame = frames[frameIndex % LATENCY];
+  if (frame.pending)
+    collect(frame, false);
+  frame.zones.clear();
+  frame.usedQueries = 0;
+  frame.frameIndex = frameIndex;
+  frame.pending = true;
+  current = &frame;
+  openZones.clear();
+  beginZone("frame");
+}
+
+void GpuProfiler::endFrame() {
+  if (!current)
+    return;
+  // zones left open (early returns without GpuZone) are closed with the frame
+  while (!openZones.empty())
+    endZone(openZones.back());
+  current = nullptr;
+  frameIndex++;
+
+  if (reportInterval > 0.0) {
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastReport).count() >= reportInterval) {
+      lastReport = now;
+      printAverages();
+    }
+  }
+}
+
+int GpuProfiler::beginZone(const char* name) {
+  if (!current || current->usedQueries + 2 > current->queries.size())
+    return -1;
+  PendingZone zone;
+  zone.statIndex = findStat(name, static_cast<int>(openZones.size()));
+  zone.beginQuery = current->usedQueries++;
+  zone.endQuery = current->usedQueries++;
+  glQueryCounter(current->queries[zone.beginQuery], GL_TIMESTAMP);
+  int index = static_cast<int>(current->zones.size());
+  current->zones.push_back(zone);
+  openZones.push_back(index);
+  return index;
+}
+
+void GpuProfiler::endZone(int zone) {
+  if (!current || zone < 0 || openZones.empty() || openZones.back() != zone)
+    return;
+  glQueryCounter(current->queries[current->zones[zone].endQuery], GL_TIMESTAMP);
+  openZones.pop_back();
+}
+
+unsigned int GpuProfiler::findStat(const char* name, int depth) {
+  // a handful of zones per frame, a linear scan beats hashing the name
+  for (unsigned int i = 0; i < stats.size(); i++)
+    if (stats[i].name == name)
+      return i;
+  stats.push_back({name, depth, 0.0, 0.0, 0, 0.0, 0});
+  return static_cast<unsigned int>(stats.size() - 1);
+}
+
+void GpuProfiler::collect(FrameQueries& frame, bool wait) {
+  frame.pending = false;
+  if (frame.zones.empty())
+    return;
+  // the end of the frame zone is the last timestamp written, once it is there all of them are
+  if (!wait) {
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.zones[0].endQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      dropped++;
+      return;
+    }
+  }
+  for (auto& zone : frame.zones) {
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(frame.queries[zone.beginQuery], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.queries[zone.endQuery], GL_QUERY_RESULT, &end);
+    double ms = end > begin ? (end - begin) / 1.0e6 : 0.0;
+    ZoneStats& stat = stats[zone.statIndex];
+    stat.lastMs = ms;
+    stat.totalMs += ms;
+    stat.samples++;
+    stat.intervalMs += ms;
+    stat.intervalSamples++;
+    if (capture && events.size() >= maxEvents)
+      events.erase(events.begin(), events.begin() + events.size() / 2);
+    if (capture)
+      events.push_back({stat.name, "gpu", gpuToTraceUs + begin / 1000.0, ms * 1000.0, TRACE_THREAD_ID});
+  }
+  if (frameCallback)
+    frameCallback(frame.frameIndex, stats[frame.zones[0].statIndex].lastMs);
+}
+
+void GpuProfiler::flush() {
+  for (unsigned long long i = frameIndex > LATENCY ? frameIndex - LATENCY : 0; i < frameIndex; i++) {
+    FrameQueries& frame = frames[i % LATENCY];
+    if (frame.pending)
+      collect(frame, true);
+  }
+}
+
+void GpuProfiler::printAverages() {
+  std::string line = "GPU:";
+  char entry[96];
+  for (auto& stat : stats) {
+    if (stat.intervalSamples == 0)
+      continue;
+    std::snprintf(entry, sizeof(entry), " %s %.3f ms%s", stat.name.c_str(), stat.intervalMs / stat.intervalSamples,
+                  stat.depth == 0 ? " |" : "");
+    line += entry;
+    stat.intervalMs = 0.0;
+    stat.intervalSamples = 0;
+  }
+  if (dropped > 0)
+    line += " (" + std::to_string(dropped) + " frames dropped)";
+  std::cout << line << std::endl;
+}
+
+void GpuProfiler::setCapture(bool enable, size_t eventLimit) {
+  capture = enable;
+  maxEvents = eventLimit;
+  if (capture)
+    events.reserve(std::min<size_t>(maxEvents, 1 << 16));
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string& path) const {
+  return ::writeChromeTrace(path, events, {{TRACE_THREAD_ID, "GPU"}});
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+// gpuProfiler: scoped GPU timing zones from GL_TIMESTAMP queries. every zone writes a timestamp
+// at its begin and end into the query set of the current frame; the sets form a ring that is
+// read back LATENCY frames later, so the CPU never waits on a result. a frame whose results are
+// still not available by then is dropped instead of stalling.
+// per-zone averages are printed to the console once per report interval and, when capturing,
+// every zone is kept as a trace event on the "GPU" track of the Chrome trace.
+// -----------------------------------
+class GpuProfiler {
+public:
+  static constexpr unsigned int LATENCY = 4;
+  static constexpr uint32_t TRACE_THREAD_ID = 1000;
+
+  struct ZoneStats {
+    std::string name;
+    int depth;
+    double lastMs;
+    double totalMs;
+    unsigned long long samples;
+    // accumulated since the last report
+    double intervalMs;
+    unsigned int intervalSamples;
+  };
+
+  explicit GpuProfiler(unsigned int maxZonesPerFrame = 64);
+  ~GpuProfiler();
+
+  // the whole frame is a zone as well ("frame"); zones may nest inside it
+  void beginFrame();
+  void endFrame();
+  // returns a zone index for endZone, or -1 when the frame ran out of queries
+  int beginZone(const char* name);
+  void endZone(int zone);
+
+  // console report of the averages since the last report, at most once per interval (0 disables)
+  void setReportInterval(double seconds) { reportInterval = seconds; }
+  void printAverages();
+
+  // keep zones as trace events; once eventLimit is reached the older half is discarded
+  void setCapture(bool enable, size_t eventLimit = 1 << 20);
+  const std::vector<TraceEvent>& traceEvents() const { return events; }
+  bool writeChromeTrace(const std::string& path) const;
+
+  // called for every frame that was read back with its frame index and GPU time
+  void setFrameCallback(std::function<void(unsigned long long, double)> callback) { frameCallback = std::move(callback); }
+  // waits for the frames still in flight, e.g. at the end of a benchmark
+  void flush();
+
+  const std::vector<ZoneStats>& zones() const { return stats; }
+  bool supported() const { return queriesSupported; }
+  unsigned long long droppedFrames() const { return dropped; }
+
+private:
+  struct PendingZone {
+    unsigned int statIndex;
+    unsigned int beginQuery;
+    unsigned int endQuery;
+  };
+  struct FrameQueries {
+    std::vector<unsigned int> queries;
+    std::vector<PendingZone> zones;
+    unsigned int usedQueries = 0;
+    unsigned long long frameIndex = 0;
+    bool pending = false;
+  };
+
+  unsigned int findStat(const char* name, int depth);
+  void collect(FrameQueries& frame, bool wait);
+
+  unsigned int maxZones;
+  bool queriesSupported;
+  FrameQueries frames[LATENCY];
+  unsigned long long frameIndex = 0;
+  FrameQueries* current = nullptr;
+  std::vector<int> openZones;
+  std::vector<ZoneStats> stats;
+  unsigned long long dropped = 0;
+
+  // GPU timestamps are mapped onto the trace clock through an offset taken at creation
+  double gpuToTraceUs;
+
+  double reportInterval = 1.0;
+  std::chrono::steady_clock::time_point lastReport;
+
+  bool capture = false;
+  size_t maxEvents = 0;
+  std::vector<TraceEvent> events;
+  std::function<void(unsigned long long, double)> frameCallback;
+};
+
+// gpuZone: RAII helper, times the enclosing scope
+// -----------------------------------
+class GpuZone {
+public:
+  GpuZone(GpuProfiler& profiler, const char* name) : profiler(profiler), zone(profiler.beginZone(name)) {}
+  ~GpuZone() { profiler.endZone(zone); }
+  GpuZone(const GpuZone&) = delete;
+  GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+  GpuProfiler& profiler;
+  int zone;
+};
@@ -0,0 +1,225 @@
+#include "job_system.h"
+#include <algorithm>
+#include <string>
+#include "cpu_profiler.h"
+
+struct JobSystem::Job {
+  std::function<void()> work;
+  Affinity affinity = Affinity::Any;
+  // unfinished dependencies, plus one while submit() is still registering them
+  std::atomic<int> blockers{1};
+  std::atomic<bool> done{false};
+  // guards dependents against a dependency finishing while a new dependent registers with it
+  std::mutex mutex;
+  // hold their dependents until they are queued
+  std::vector<JobHandle> dependents;
+};
+
+namespace {
+  // the system a pool thread belongs to and its deque
+  thread_local const JobSystem* currentSystem = nullptr;
+  thread_local size_t currentQueue = 0;
+}
+
+JobSystem::JobSystem(unsigned int workerCount) : mainThread(std::this_thread::get_id()) {
+  if (workerCount == 0)
+    workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  currentSystem = this;
+  currentQueue = 0;
+  for (unsigned int i = 0; i <= workerCount; i++)
+    queues.push_back(std::make_unique<WorkQueue>());
+  for (unsigned int i = 0; i < workerCount; i++)
+    workers.emplace_back(&JobSystem::workerLoop, this, static_cast<size_t>(i + 1));
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    quit = true;
+  }
+  sleepSignal.notify_all();
+  for (std::thread& worker : workers)
+    worker.join();
+  if (currentSystem == this)
+    currentSystem = nullptr;
+}
+
+JobSystem::JobHandle JobSystem::submit(std::function<void()> work, const std::vector<JobHandle>& dependencies, Affinity affinity) {
+  JobHandle job = std::make_shared<Job>();
+  job->work = std::move(work);
+  job->affinity = affinity;
+  for (const JobHandle& dependency : dependencies) {
+    if (!dependency)
+      continue;
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (dependency->done)
+      continue;
+    job->blockers++;
+    dependency->dependents.push_back(job);
+  }
+  // drops the registration guard, queues the job unless a dependency is still running
+  if (--job->blockers == 0)
+    enqueue(job);
+  return job;
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+  grain = std::max<size_t>(grain, 1);
+  if (count <= grain || workers.empty()) {
+    if (count > 0)
+      body(0, count);
+    return;
+  }
+  std::vector<JobHandle> pieces;
+  for (size_t begin = grain; begin < count; begin += grain)
+    pieces.push_back(submit([&body, begin, end = std::min(begin + grain, count)] { body(begin, end); }));
+  // the calling thread takes the first piece itself instead of queueing and stealing it back
+  body(0, grain);
+  for (const JobHandle& piece : pieces)
+    wait(piece);
+}
+
+bool JobSystem::finished(const JobHandle& job) const {
+  return !job || job->done;
+}
+
+void JobSystem::wait(const JobHandle& job) {
+  // inside a MainThread job the main thread only helps with Any jobs
+  bool onMainThread = std::this_thread::get_id() == mainThread && !inMainThreadJob;
+  size_t queue = ownQueue();
+  while (!finished(job)) {
+    if (onMainThread && runMainThreadJob())
+      continue;
+    if (JobHandle next = findWork(queue)) {
+      run(next);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepers++;
+    waiters++;
+    sleepSignal.wait(lock, [&] { return finished(job) || queuedJobs > 0 || (onMainThread && queuedMainThreadJobs > 0); });
+    waiters--;
+    sleepers--;
+  }
+}
+
+size_t JobSystem::runMainThreadJobs() {
+  size_t count = 0;
+  while (runMainThreadJob())
+    count++;
+  return count;
+}
+
+void JobSystem::enqueue(JobHandle job) {
+  if (job->affinity == Affinity::MainThread) {
+    {
+      std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+      mainThreadQueue.jobs.push_back(std::move(job));
+      queuedMainThreadJobs++;
+    }
+    // only the main thread can take it, in wait() or polling
+    wakeWaiters();
+    return;
+  }
+  WorkQueue& queue = *queues[ownQueue()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+    queuedJobs++;
+  }
+  // any sleeper can run it
+  if (sleepers > 0) {
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    sleepSignal.notify_one();
+  }
+}
+
+JobSystem::JobHandle JobSystem::findWork(size_t queue) {
+  {
+    WorkQueue& own = *queues[queue];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      JobHandle job = std::move(own.jobs.back());
+      own.jobs.pop_back();
+      queuedJobs--;
+      return job;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); i++) {
+    WorkQueue& victim = *queues[(queue + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      JobHandle job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      queuedJobs--;
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+bool JobSystem::runMainThreadJob() {
+  JobHandle job;
+  {
+    std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+    if (mainThreadQueue.jobs.empty())
+      return false;
+    job = std::move(mainThreadQueue.jobs.front());
+    mainThreadQueue.jobs.pop_front();
+    queuedMainThreadJobs--;
+  }
+  inMainThreadJob = true;
+  run(job);
+  inMainThreadJob = false;
+  return true;
+}
+
+void JobSystem::run(const JobHandle& job) {
+  {
+    CPU_ZONE("job");
+    job->work();
+  }
+  // the work's captures can go now, the job itself lives on as long as a handle to it does
+  job->work = nullptr;
+  std::vector<JobHandle> released;
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->done = true;
+    released.swap(job->dependents);
+  }
+  for (JobHandle& dependent : released)
+    if (--dependent->blockers == 0)
+      enqueue(std::move(dependent));
+  // someone may be waiting on exactly this job
+  wakeWaiters();
+}
+
+void JobSystem::workerLoop(size_t queue) {
+  currentSystem = this;
+  currentQueue = queue;
+  CpuProfiler::setThreadName("job worker " + std::to_string(queue));
+  while (true) {
+    if (JobHandle job = findWork(queue)) {
+      run(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepers++;
+    sleepSignal.wait(lock, [&] { return quit || queuedJobs > 0; });
+    sleepers--;
+    if (quit)
+      return;
+  }
+}
+
+size_t JobSystem::ownQueue() const {
+  return currentSystem == this ? currentQueue : 0;
+}
+
+void JobSystem::wakeWaiters() {
+  if (waiters == 0)
+    return;
+  // taking the mutex orders the notify after a waiter's predicate check
+  { std::lock_guard<std::mutex> lock(sleepMutex); }
+  sleepSignal.notify_all();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// jobSystem: worker threads that run small jobs, with dependencies between jobs.
+//  - work stealing: every thread owns a deque, the jobs it releases go to the back and it pops from the
+//    back (their data is likely still in its caches); a thread out of work steals from the front of
+//    the others' deques. the deques are short critical sections, not lock free
+//  - a job becomes ready once all of its dependencies have finished, the thread finishing the last one
+//    queues it
+//  - MainThread jobs never run on a worker, they wait for the thread that created the system to pick
+//    them up in wait() or runMainThreadJobs(); that is where GL calls go. they don't nest: a wait()
+//    (or parallelFor) inside a MainThread job only runs Any jobs, so another MainThread job can't
+//    cut into a sequence of GL calls half way
+//  - wait() never idles a thread that could work, it runs ready jobs until the awaited one is done
+// jobs are reference counted: a JobHandle keeps its job alive and the system holds one while the job
+// waits for dependencies, is queued or runs, so a job is freed once it is done and nobody holds it.
+// -----------------------------------
+class JobSystem {
+public:
+  enum class Affinity { Any, MainThread };
+  struct Job;
+  using JobHandle = std::shared_ptr<Job>;
+
+  // 0 = one worker per hardware thread besides the creating (main) thread, which works in wait()
+  explicit JobSystem(unsigned int workerCount = 0);
+  ~JobSystem();
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // from any thread, jobs included; work runs after every dependency finished (null ones are skipped)
+  JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies = {}, Affinity affinity = Affinity::Any);
+  // body(begin, end) over [0, count) in pieces of grain, returns when all are done
+  void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+  bool finished(const JobHandle& job) const;
+  // a worker must not wait on a MainThread job unless the main thread is waiting as well, and a
+  // MainThread job never waits on another one
+  void wait(const JobHandle& job);
+  // main thread: runs the MainThread jobs that are ready, returns how many ran
+  size_t runMainThreadJobs();
+
+  unsigned int workerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+  };
+
+  void enqueue(JobHandle job);
+  JobHandle findWork(size_t queue);
+  bool runMainThreadJob();
+  void run(const JobHandle& job);
+  void workerLoop(size_t queue);
+  // index of the calling thread's own deque, 0 (the main thread's) for threads outside the system
+  size_t ownQueue() const;
+  // threads in wait() re-check what they wait for, idle workers sleep on
+  void wakeWaiters();
+
+  std::thread::id mainThread;
+  std::vector<std::thread> workers;
+  // [0] belongs to the main thread, [i + 1] to worker i
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  WorkQueue mainThreadQueue;
+  // main thread only: set while a MainThread job runs
+  bool inMainThreadJob = false;
+
+  // ready Any jobs in the deques, ready MainThread jobs, threads asleep (idle workers and wait()) and
+  // the ones asleep in wait(); sequentially consistent, so a sleeper re-checking after announcing
+  // itself can't miss a wake up. the queue counts change under their queue's mutex, with the push or
+  // pop, so they never run below zero
+  std::atomic<size_t> queuedJobs{0};
+  std::atomic<size_t> queuedMainThreadJobs{0};
+  std::atomic<size_t> sleepers{0};
+  std::atomic<size_t> waiters{0};
+  std::mutex sleepMutex;
+  std::condition_variable sleepSignal;
+  bool quit = false;
+};
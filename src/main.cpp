@@ -1,9 +1,27 @@
+#include <cmath>
+#include <filesystem>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include "program_cache.h"
+#include "program_builder.h"
+#include "startup_profiler.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "state_cache.h"
+#include "render_queue.h"
+#include "mega_buffer.h"
+#include "resource.h"
+#include "vertex_compression.h"
+#include "mesh_optimizer.h"
+#include "gltf_loader.h"
+#include "cooked_mesh.h"
+#include "job_system.h"
+#include "async_assets.h"
+#include "render_context.h"
 
 // settings
 const unsigned int SCR_WIDTH = 1600;
@@ -11,10 +29,16 @@ const unsigned int SCR_HEIGHT = 900;
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void input_callback(GLFWwindow *window)
+bool input_callback(GLFWwindow *window)
 {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
+  // F12 requests a trace dump, once per key press
+  static bool dumpKeyDown = false;
+  bool dumpKeyPressed = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+  bool dumpRequested = dumpKeyPressed && !dumpKeyDown;
+  dumpKeyDown = dumpKeyPressed;
+  return dumpRequested;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -23,184 +47,375 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
   // make sure the viewport matches the new window dimensions; note that width and 
   // height will be significantly larger than specified on retina displays.
-  glViewport(0, 0, width, height);
+  // the viewport goes through the state cache of the render loop so it stays in sync
+  StateCache* stateCache = static_cast<StateCache*>(glfwGetWindowUserPointer(window));
+  if (stateCache)
+    stateCache->viewport(0, 0, width, height);
+  else
+    glViewport(0, 0, width, height);
 }
 
-// shader: read and compile shaderfile
-// -----------------------------------
-unsigned int createShader(std::string fileName, unsigned int shaderType) {
-  // vertex shader
-  std::ifstream shaderFile;
-  shaderFile.open(SHADER_PATH+fileName);
-  std::string shaderCode{std::istreambuf_iterator<char>(shaderFile), std::istreambuf_iterator<char>()};
-  const char *shaderCode_c_str = shaderCode.c_str();
-  unsigned int shader = glCreateShader(shaderType);
-  glShaderSource(shader, 1, &shaderCode_c_str, NULL);
-  glCompileShader(shader);
-  // check for shader compile errors
-  int success;
-  char infoLog[512];
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-  if (!success)
-  {
-      glGetShaderInfoLog(shader, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-  }
-  return shader;
-}
-
-// shaderProgram: link list of shaders and create shaderProgram
-// -----------------------------------
-unsigned int createShaderProgram(std::vector<unsigned int> shaders) {
-  unsigned int shaderProgram = glCreateProgram();
-  for (auto& shader : shaders) {
-    glAttachShader(shaderProgram, shader);
-  }
-  glLinkProgram(shaderProgram);
-  // check for linking errors
-  int success;
-  char infoLog[512];
-  glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-  if (!success) {
-    glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-  }
-  return shaderProgram;
-}
-
-
 int main(int argc, char* argv[])
 {
-  GLFWwindow *window;
+  // startup phases are timed from here on
+  StartupProfiler startup;
+  CpuProfiler::setThreadName("main");
 
-  //init glfw and set context to latest macos opengl version (OpenGL 4.1)
-  if(!glfwInit())
+  // command line options
+  // --------------------
+  ContextSettings contextSettings;
+  contextSettings.width = SCR_WIDTH;
+  contextSettings.height = SCR_HEIGHT;
+  contextSettings.startup = &startup;
+  bool headless = false;
+  std::string startupJsonPath, startupTracePath, frameDumpPath, gltfPath;
+  std::string tracePath = "trace.json";
+  bool traceOnExit = false;
+  GltfScene::Upload gltfUpload = GltfScene::Upload::Auto;
+  unsigned int gltfLod = 0;
+  unsigned int jobWorkers = 0;
+  for (int i = 1; i < argc; i++)
   {
-    std::cout << "GLFW Not Initialized" << std::endl;
-    return -1; 
+    std::string arg = argv[i];
+    if (arg == "--startup-json" && i + 1 < argc)
+      startupJsonPath = argv[++i];
+    else if (arg == "--startup-trace" && i + 1 < argc)
+      startupTracePath = argv[++i];
+    else if (arg == "--headless")
+      headless = true;
+    else if (arg == "--headless-backend" && i + 1 < argc)
+      contextSettings.headlessBackend = argv[++i];
+    else if (arg == "--width" && i + 1 < argc)
+      contextSettings.width = std::stoi(argv[++i]);
+    else if (arg == "--height" && i + 1 < argc)
+      contextSettings.height = std::stoi(argv[++i]);
+    else if (arg == "--frames" && i + 1 < argc)
+      contextSettings.maxFrames = std::stoull(argv[++i]);
+    else if (arg == "--dump-frames" && i + 1 < argc)
+      frameDumpPath = argv[++i];
+    else if (arg == "--trace" && i + 1 < argc)
+    {
+      tracePath = argv[++i];
+      traceOnExit = true;
+    }
+    else if (arg == "--no-dsa")
+      setDirectStateAccess(false);
+    else if (arg == "--gltf" && i + 1 < argc)
+      gltfPath = argv[++i];
+    else if (arg == "--gltf-upload" && i + 1 < argc)
+    {
+      std::string mode = argv[++i];
+      gltfUpload = mode == "direct" ? GltfScene::Upload::Direct : mode == "staged" ? GltfScene::Upload::Staged
+        : mode == "streamed" ? GltfScene::Upload::Streamed : GltfScene::Upload::Auto;
+    }
+    else if (arg == "--lod" && i + 1 < argc)
+      gltfLod = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (arg == "--jobs" && i + 1 < argc)
+      jobWorkers = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else
+      std::cout << "Unknown option " << arg << std::endl;
   }
-  
-  // apples highest supported version is 4.1
-  #ifdef __APPLE__
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-  #else
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-  #endif
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // create glfw window and set as active context
-  window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Tutorial", 0, 0);
-  if(!window)
-  {
-    std::cout << "Window wasn't created" << std::endl;
-    return -1;
-  }
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-  //init glad function loader to get all opengl core/extension functions
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-  {
-    std::cout << "Failed to initialize GLAD" << std::endl;
+  // create the window (or the offscreen context) and load all opengl core/extension functions
+  // -----------------------------------------------------------------------------------------
+  if (!frameDumpPath.empty())
+    contextSettings.sink = std::make_unique<PpmFrameSink>(frameDumpPath);
+  std::unique_ptr<RenderContext> context = headless ? createHeadlessContext(contextSettings) : createWindowContext(contextSettings);
+  if (!context)
     return -1;
+  GLFWwindow *window = context->window();
+  // redundant binds and state changes of the render loop are filtered here
+  StateCache stateCache;
+  if (window)
+  {
+    glfwSetWindowUserPointer(window, &stateCache);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
   }
 
   // check OpenGL Version
   std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
+  std::cout << "Resource updates: " << (directStateAccess() ? "direct state access" : "bind fallback") << std::endl;
+  startup.setInfo("gl_vendor", reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+  startup.setInfo("gl_renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+  startup.setInfo("gl_version", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
   
   // build and compile our shader program
   // ------------------------------------
-  // vertex shader
-  unsigned int vertexShader = createShader("quad.vert", GL_VERTEX_SHADER);
-  // fragment shader
-  unsigned int fragmentShader = createShader("quad.frag", GL_FRAGMENT_SHADER);
-  // link shaders
-  unsigned int shaderProgram = createShaderProgram({vertexShader, fragmentShader});
-
-  //delete temporary shaders
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragmentShader);
+  // linked programs are cached on disk, so warm starts skip compiling and linking
+  startup.begin("shader submit");
+  auto shaderStart = StartupProfiler::Clock::now();
+  ProgramBinaryCache programCache(SHADER_CACHE_PATH);
+  // programs build in the background, the render loop keeps presenting frames until they are ready
+  AsyncProgramBuilder programBuilder(window, &programCache);
+  // loads read and decode on the job system's workers and run their GL steps in the update step
+  JobSystem jobSystem(jobWorkers);
+  AssetLoader assets(jobSystem, programBuilder);
+  unsigned int quadProgram = programBuilder.submit({
+    {"quad.vert", GL_VERTEX_SHADER},
+    {"quad.frag", GL_FRAGMENT_SHADER}
+  });
+  // cooked scenes store compressed vertices; 0 until the build is done (or when it failed)
+  unsigned int gltfProgram = 0;
+  Task<unsigned int> gltfProgramBuild;
+  if (!gltfPath.empty())
+  {
+    gltfProgramBuild = assets.compileProgram({
+      {"gltf.vert", GL_VERTEX_SHADER},
+      {"gltf.frag", GL_FRAGMENT_SHADER}
+    }, std::filesystem::path(gltfPath).extension() == CookedMesh::EXTENSION ? std::vector<std::string>{"COMPRESSED_VERTEX"} : std::vector<std::string>{});
+    gltfProgramBuild.start();
+  }
+  startup.end();
 
   // set up vertex data (and buffer(s)) and configure vertex attributes
   // ------------------------------------------------------------------
-  float vertices[] = {
-      0.5f,  0.5f, 0.0f,  // top right
-      0.5f, -0.5f, 0.0f,  // bottom right
-    -0.5f, -0.5f, 0.0f,  // bottom left
-    -0.5f,  0.5f, 0.0f   // top left 
+  startup.begin("buffer setup");
+  MeshVertex vertices[] = {
+    // position              normal          tangent               uv
+    {{ 0.5f,  0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},  // top right
+    {{ 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},  // bottom right
+    {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},  // bottom left
+    {{-0.5f,  0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}}   // top left
   };
   unsigned int indices[] = {  // note that we start from 0!
     0, 1, 3,  // first Triangle
     1, 2, 3   // second Triangle
   };
-  unsigned int VBO, VAO, EBO;
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-  // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-  glBindVertexArray(VAO);
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-
-  // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-  glBindBuffer(GL_ARRAY_BUFFER, 0); 
-
-  // remember: do NOT unbind the EBO while a VAO is active as the bound element buffer object IS stored in the VAO; keep the EBO bound.
-  //glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-  // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
-  // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-  glBindVertexArray(0); 
+  // meshes are reordered for the vertex cache, overdraw and vertex fetch, then stored compressed
+  // (quad.vert decodes them) with 16 bit indices where they fit
+  MeshOptimizer::Mesh optimizedQuad = MeshOptimizer::optimize(vertices, 4, sizeof(MeshVertex), offsetof(MeshVertex, position), indices, 6);
+  optimizedQuad.report.print("quad");
+  std::vector<CompressedVertex> compressedVertices(optimizedQuad.vertexCount);
+  PositionDecode quadDecode = compressVertices(reinterpret_cast<const MeshVertex*>(optimizedQuad.vertices.data()), optimizedQuad.vertexCount, compressedVertices.data());
+  std::cout << "Vertex compression: " << sizeof(MeshVertex) << " -> " << sizeof(CompressedVertex) << " bytes per vertex" << std::endl;
+  // meshes live in one shared vertex/index arena and are drawn as (firstIndex, count, baseVertex) ranges,
+  // every mesh of this format shares the arena's VAO
+  MegaBuffer geometry(vertexLayout<CompressedVertex>(), 1 << 16, 1 << 18);
+  MegaBuffer::MeshHandle quadMesh = optimizedQuad.shortIndices()
+    ? geometry.addMesh(compressedVertices.data(), optimizedQuad.vertexCount, optimizedQuad.indices16.data(), 6)
+    : geometry.addMesh(compressedVertices.data(), optimizedQuad.vertexCount, optimizedQuad.indices.data(), 6);
+  startup.end();
 
+  // a glTF or cooked scene given on the command line is drawn instead of the quad once it is loaded;
+  // paths are tried as given, then inside assets/ and the build's cooked assets. the load reads the file
+  // on the job system's workers and uploads on this thread in the update step a piece per frame, the
+  // quad keeps drawing meanwhile (without workers the reading is done before the first frame)
+  GltfScene gltfScene;
+  Task<GltfScene> gltfLoad;
+  auto gltfLoadStart = StartupProfiler::Clock::now();
+  if (!gltfPath.empty())
+  {
+    if (!std::filesystem::exists(gltfPath) && std::filesystem::exists(ASSET_PATH + gltfPath))
+      gltfPath = ASSET_PATH + gltfPath;
+    else if (!std::filesystem::exists(gltfPath) && std::filesystem::exists(COOKED_ASSET_PATH + gltfPath))
+      gltfPath = COOKED_ASSET_PATH + gltfPath;
+    gltfLoad = assets.loadMesh(gltfPath, gltfUpload);
+    gltfLoad.start();
+  }
 
   // uncomment this call to draw in wireframe polygons.
   //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+  // draws are collected as sort-keyed packets and replayed in state order
+  RenderQueue renderQueue;
+  uint32_t quadMaterial = ~0u;
+  int positionDecodeLocation = -1;
+  // the queue material of each scene material, and the texture of the untextured ones
+  std::vector<uint32_t> gltfMaterials;
+  Texture whiteTexture;
+  int gltfDrawLocation = -1;
+  // the first frame waits for every program it draws with
+  bool programsPending = true;
+
+  // GPU zones are read back a few frames late, averages are printed once per second
+  GpuProfiler gpuProfiler;
+  gpuProfiler.setCapture(true, 1 << 16);
+  // CPU and GPU zones go into one trace, dumped on F12 and on exit with --trace
+  auto dumpTrace = [&]() {
+    gpuProfiler.flush();
+    if (CpuProfiler::writeChromeTrace(tracePath, gpuProfiler.traceEvents(), {{GpuProfiler::TRACE_THREAD_ID, "GPU"}}))
+      std::cout << "Trace written to " << tracePath << std::endl;
+  };
+
   // render loop
   // -----------
-  while (!glfwWindowShouldClose(window))
+  // startup ends with the first frame that has every program and shows the scene, or the quad without one
+  bool startupPending = true;
+  startup.begin("first frame");
+  stateCache.bindFramebuffer(GL_FRAMEBUFFER, context->framebuffer());
+  while (!context->shouldClose())
   {
+    CPU_ZONE("frame");
+    stateCache.beginFrame();
+
     // input
     // -----
-    input_callback(window);
+    bool dumpRequested = false;
+    {
+      CPU_ZONE("input");
+      if (window)
+        dumpRequested = input_callback(window);
+    }
+
+    // update
+    // ------
+    // pick up programs that finished building since the last frame and run the asset loads' GL steps
+    {
+      CPU_ZONE("update");
+      programBuilder.poll();
+      assets.update();
+      if (gltfProgramBuild.done())
+      {
+        gltfProgram = gltfProgramBuild.result();
+        gltfProgramBuild = Task<unsigned int>();
+      }
+      if (gltfLoad.done())
+      {
+        gltfScene = std::move(gltfLoad.result());
+        gltfLoad = Task<GltfScene>();
+        startup.addPhase("gltf load", gltfLoadStart, StartupProfiler::Clock::now());
+      }
+      if (programsPending && programBuilder.isReady(quadProgram) && (gltfPath.empty() || gltfProgram != 0))
+      {
+        programsPending = false;
+        startup.addPhase("shader programs ready", shaderStart, StartupProfiler::Clock::now());
+      }
+    }
 
     // render
     // ------
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    gpuProfiler.beginFrame();
+    {
+      CPU_ZONE("render");
+      {
+        GpuZone zone(gpuProfiler, "clear");
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      }
+
+      // draw the scene, fitted into the view
+      if (gltfScene && gltfProgram != 0)
+      {
+        if (gltfMaterials.empty())
+        {
+          unsigned int program = gltfProgram;
+          // a queue material per base color texture, the untextured materials share the white one
+          const uint8_t white[4] = {255, 255, 255, 255};
+          whiteTexture = Texture(1, 1, white);
+          std::unordered_map<unsigned int, uint32_t> textureMaterials;
+          for (uint32_t material = 0; material < gltfScene.materialCount(); material++)
+          {
+            unsigned int texture = gltfScene.baseColorTexture(material);
+            auto [entry, added] = textureMaterials.try_emplace(texture ? texture : whiteTexture.id(), 0u);
+            if (added)
+            {
+              Material queueMaterial{program};
+              queueMaterial.textures[GltfScene::BASE_COLOR_TEXTURE_UNIT] = entry->first;
+              entry->second = renderQueue.addMaterial(queueMaterial);
+            }
+            gltfMaterials.push_back(entry->second);
+          }
+          gltfDrawLocation = glGetUniformLocation(program, "uDraw");
+          glProgramUniform1i(program, glGetUniformLocation(program, "uBaseColorTexture"), GltfScene::BASE_COLOR_TEXTURE_UNIT);
+          glProgramUniform1i(program, glGetUniformLocation(program, "uNodes"), GltfScene::NODE_TEXTURE_UNIT);
+          glProgramUniform1i(program, glGetUniformLocation(program, "uMaterials"), GltfScene::MATERIAL_TEXTURE_UNIT);
+          float center[3], radius = 0.0f;
+          for (int axis = 0; axis < 3; axis++)
+          {
+            center[axis] = (gltfScene.boundsMin()[axis] + gltfScene.boundsMax()[axis]) * 0.5f;
+            float half = (gltfScene.boundsMax()[axis] - gltfScene.boundsMin()[axis]) * 0.5f;
+            radius += half * half;
+          }
+          radius = std::sqrt(radius);
+          glProgramUniform4f(program, glGetUniformLocation(program, "uSceneFit"), center[0], center[1], center[2],
+                             radius > 0.0f ? 1.0f / radius : 1.0f);
+        }
+        stateCache.bindTexture(GltfScene::NODE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, gltfScene.nodeTexture().id());
+        stateCache.bindTexture(GltfScene::MATERIAL_TEXTURE_UNIT, GL_TEXTURE_BUFFER, gltfScene.materialTexture().id());
+        stateCache.setEnabled(GL_DEPTH_TEST, true);
+        gltfScene.submit(renderQueue, gltfMaterials, gltfDrawLocation, gltfLod);
+      }
+      // draw our first triangle
+      else if (!gltfScene && programBuilder.isReady(quadProgram))
+      {
+        if (quadMaterial == ~0u)
+        {
+          quadMaterial = renderQueue.addMaterial({programBuilder.program(quadProgram)});
+          positionDecodeLocation = glGetUniformLocation(programBuilder.program(quadProgram), "uPositionDecode");
+        }
+        DrawPacket quad;
+        quad.material = quadMaterial;
+        quad.uniformLocation = positionDecodeLocation;
+        quad.uniform = quadDecode;
+        const MegaBuffer::MeshRange& quadRange = geometry.range(quadMesh);
+        quad.vao = geometry.vao();
+        quad.indexCount = quadRange.indexCount;
+        quad.indexOffset = quadRange.indexOffset();
+        quad.shortIndices = quadRange.shortIndices;
+        quad.baseVertex = quadRange.baseVertex;
+        renderQueue.submit(RenderQueue::Opaque, quad);
+      }
 
-    // draw our first triangle
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
-    //glDrawArrays(GL_TRIANGLES, 0, 6);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    // glBindVertexArray(0); // no need to unbind it every time 
+      // the queue sorts the packets and binds program and VAO only when they change
+      GpuZone zone(gpuProfiler, "queue");
+      renderQueue.execute(stateCache);
+    }
 
     // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+    // headless contexts hand the frame to their sink instead
     // -------------------------------------------------------------------------------
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    {
+      CPU_ZONE("swap");
+      GpuZone zone(gpuProfiler, "present");
+      context->present();
+    }
+    gpuProfiler.endFrame();
+    {
+      CPU_ZONE("poll events");
+      context->pollEvents();
+    }
+    if (dumpRequested)
+      dumpTrace();
+
+    if (startupPending && !programsPending && !gltfLoad)
+    {
+      startupPending = false;
+      startup.end();
+      startup.printBreakdown();
+      if (!startupJsonPath.empty())
+        startup.writeJson(startupJsonPath);
+      if (!startupTracePath.empty())
+        startup.writeChromeTrace(startupTracePath);
+    }
+  }
+
+  // loads still in flight finish before the GL objects they upload to go away
+  assets.wait(gltfLoad);
+  assets.wait(gltfProgramBuild);
+  if (gltfProgramBuild.done())
+    gltfProgram = gltfProgramBuild.result();
+  if (traceOnExit)
+    dumpTrace();
+  if (stateCache.frames() > 0)
+  {
+    // closes the last frame into the totals
+    stateCache.beginFrame();
+    double frames = static_cast<double>(stateCache.frames() - 1);
+    std::cout << "State cache: " << stateCache.total().issued / frames << " issued, "
+              << stateCache.total().skipped / frames << " skipped calls per frame" << std::endl;
   }
 
   // optional: de-allocate all resources once they've outlived their purpose:
   // ------------------------------------------------------------------------
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
-  glDeleteBuffers(1, &EBO);
-  glDeleteProgram(shaderProgram);
+  if (window)
+    glfwSetWindowUserPointer(window, nullptr);
+  geometry.removeMesh(quadMesh);
+  glDeleteProgram(programBuilder.program(quadProgram));
+  if (gltfProgram != 0)
+    glDeleteProgram(gltfProgram);
 
   // glfw: terminate, clearing all previously allocated GLFW resources.
+  // the context is destroyed last when main returns (headless contexts tear down EGL/OSMesa instead)
   // ------------------------------------------------------------------
-  glfwTerminate();
   return 0;
 }
\ No newline at end of file
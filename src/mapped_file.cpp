@@ -0,0 +1,137 @@
+#include "mapped_file.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    std::cout << "ERROR::MAPPED_FILE::CANNOT_OPEN " << path << std::endl;
+    return;
+  }
+  LARGE_INTEGER length;
+  if (GetFileSizeEx(file, &length) && length.QuadPart > 0) {
+    // the mapping keeps the file open, the handle isn't needed past this point
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+      bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      byteSize = bytes ? static_cast<size_t>(length.QuadPart) : 0;
+    }
+  }
+  CloseHandle(file);
+  if (!bytes)
+    std::cout << "ERROR::MAPPED_FILE::CANNOT_MAP " << path << std::endl;
+}
+
+void MappedFile::unmap() {
+  if (bytes)
+    UnmapViewOfFile(bytes);
+  if (mapping)
+    CloseHandle(mapping);
+  bytes = nullptr;
+  mapping = nullptr;
+  byteSize = 0;
+}
+
+void MappedFile::release(size_t offset, size_t size) {
+  // unlocking pages that aren't locked takes them out of the working set
+  if (bytes && offset < byteSize)
+    VirtualUnlock(const_cast<uint8_t*>(bytes) + offset, std::min(size, byteSize - offset));
+}
+
+size_t peakResidentBytes() {
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    std::cout << "ERROR::MAPPED_FILE::CANNOT_OPEN " << path << std::endl;
+    return;
+  }
+  struct stat status;
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    // the mapping keeps the file open, the descriptor isn't needed past this point
+    void* address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    if (address != MAP_FAILED) {
+      bytes = static_cast<const uint8_t*>(address);
+      byteSize = static_cast<size_t>(status.st_size);
+      // read ahead aggressively, pages behind the reader can go early
+      madvise(address, byteSize, MADV_SEQUENTIAL);
+    }
+  }
+  close(file);
+  if (!bytes)
+    std::cout << "ERROR::MAPPED_FILE::CANNOT_MAP " << path << std::endl;
+}
+
+void MappedFile::unmap() {
+  if (bytes)
+    munmap(const_cast<uint8_t*>(bytes), byteSize);
+  bytes = nullptr;
+  byteSize = 0;
+}
+
+void MappedFile::release(size_t offset, size_t size) {
+  if (!bytes || offset >= byteSize)
+    return;
+  size = std::min(size, byteSize - offset);
+  // only whole pages, a partial page at either end may still be in use by a neighbouring range
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t first = (offset + page - 1) / page * page;
+  size_t last = (offset + size) / page * page;
+  if (last > first)
+    madvise(const_cast<uint8_t*>(bytes) + first, last - first, MADV_DONTNEED);
+}
+
+size_t peakResidentBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  // kilobytes on Linux and the BSDs
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+#endif
+
+MappedFile::~MappedFile() {
+  unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : bytes(std::exchange(other.bytes, nullptr)), byteSize(std::exchange(other.byteSize, 0))
+#ifdef _WIN32
+  , mapping(std::exchange(other.mapping, nullptr))
+#endif
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    unmap();
+    bytes = std::exchange(other.bytes, nullptr);
+    byteSize = std::exchange(other.byteSize, 0);
+#ifdef _WIN32
+    mapping = std::exchange(other.mapping, nullptr);
+#endif
+  }
+  return *this;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// mappedFile: a read-only memory mapping of a whole file (mmap, MapViewOfFile on Windows). pages are
+// read in on first touch and belong to the page cache, not the heap; release() drops a range that is no
+// longer needed from the process' resident set, so reading a large file front to back keeps it small.
+// -----------------------------------
+class MappedFile {
+public:
+  MappedFile() = default;
+  // an empty mapping (and an error printed) when the file can't be opened or mapped
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const { return bytes; }
+  size_t size() const { return byteSize; }
+  explicit operator bool() const { return bytes != nullptr; }
+
+  // the whole pages inside [offset, offset + size) leave the resident set, reading them again faults
+  // them back in from the page cache
+  void release(size_t offset, size_t size);
+
+private:
+  void unmap();
+
+  const uint8_t* bytes = nullptr;
+  size_t byteSize = 0;
+#ifdef _WIN32
+  void* mapping = nullptr;
+#endif
+};
+
+// peak resident set size of the process so far in bytes, 0 where the platform doesn't tell
+size_t peakResidentBytes();
@@ -0,0 +1,130 @@
+#include "mega_buffer.h"
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+
+MegaBuffer::MegaBuffer(const VertexLayout& layout, uint32_t maxVertices, uint32_t maxIndices)
+  : stride(layout.stride), vertexAllocator(maxVertices), indexAllocator(maxIndices),
+    // contents only change through upload/copyTo
+    vertexBufferObject(static_cast<size_t>(maxVertices) * stride, nullptr, GL_DYNAMIC_STORAGE_BIT),
+    indexBufferObject(static_cast<size_t>(maxIndices) * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT) {
+  // format and buffers never change afterwards
+  vertexArray.setVertexBuffer(0, vertexBufferObject, 0, static_cast<int>(stride));
+  vertexArray.setAttributes(0, layout);
+  vertexArray.setIndexBuffer(indexBufferObject);
+}
+
+MegaBuffer::MeshHandle MegaBuffer::addMesh(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+  return addMesh(vertices, vertexCount, indices, indexCount, false);
+}
+
+MegaBuffer::MeshHandle MegaBuffer::addMesh(const void* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount) {
+  return addMesh(vertices, vertexCount, indices, indexCount, true);
+}
+
+MegaBuffer::MeshHandle MegaBuffer::addMesh(const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount, bool shortIndices) {
+  size_t indexBytes = static_cast<size_t>(indexCount) * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t));
+  uint32_t indexSlots = static_cast<uint32_t>((indexBytes + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+  Mesh mesh;
+  mesh.vertices = vertexAllocator.allocate(vertexCount);
+  mesh.indices = indexAllocator.allocate(indexSlots);
+  if (!mesh.vertices.valid() || !mesh.indices.valid()) {
+    vertexAllocator.free(mesh.vertices);
+    indexAllocator.free(mesh.indices);
+    // enough space in total but no single range large enough: pack and retry once
+    if (vertexAllocator.storageReport().totalFree < vertexCount || indexAllocator.storageReport().totalFree < indexSlots) {
+      std::cout << "ERROR::MEGA_BUFFER::OUT_OF_SPACE " << vertexCount << " vertices, " << indexCount << " indices" << std::endl;
+      return INVALID_MESH;
+    }
+    defragment();
+    mesh.vertices = vertexAllocator.allocate(vertexCount);
+    mesh.indices = indexAllocator.allocate(indexSlots);
+    if (!mesh.vertices.valid() || !mesh.indices.valid()) {
+      vertexAllocator.free(mesh.vertices);
+      indexAllocator.free(mesh.indices);
+      std::cout << "ERROR::MEGA_BUFFER::OUT_OF_SPACE " << vertexCount << " vertices, " << indexCount << " indices" << std::endl;
+      return INVALID_MESH;
+    }
+  }
+  uint32_t firstIndex = mesh.indices.offset * (shortIndices ? 2 : 1);
+  mesh.range = {firstIndex, indexCount, static_cast<int32_t>(mesh.vertices.offset), vertexCount, shortIndices};
+  mesh.live = true;
+
+  vertexBufferObject.upload(static_cast<size_t>(mesh.vertices.offset) * stride, static_cast<size_t>(vertexCount) * stride, vertices);
+  indexBufferObject.upload(static_cast<size_t>(mesh.indices.offset) * sizeof(uint32_t), indexBytes, indices);
+
+  if (!freeHandles.empty()) {
+    MeshHandle handle = freeHandles.back();
+    freeHandles.pop_back();
+    meshes[handle] = mesh;
+    return handle;
+  }
+  meshes.push_back(mesh);
+  return static_cast<MeshHandle>(meshes.size() - 1);
+}
+
+void MegaBuffer::removeMesh(MeshHandle handle) {
+  if (handle >= meshes.size() || !meshes[handle].live)
+    return;
+  vertexAllocator.free(meshes[handle].vertices);
+  indexAllocator.free(meshes[handle].indices);
+  meshes[handle].live = false;
+  freeHandles.push_back(handle);
+}
+
+void MegaBuffer::compact(Buffer& buffer, size_t elementSize, bool vertices) {
+  std::vector<MeshHandle> live;
+  for (MeshHandle handle = 0; handle < meshes.size(); handle++)
+    if (meshes[handle].live)
+      live.push_back(handle);
+  auto allocationOf = [&](MeshHandle handle) -> OffsetAllocator::Allocation& {
+    return vertices ? meshes[handle].vertices : meshes[handle].indices;
+  };
+  std::sort(live.begin(), live.end(), [&](MeshHandle a, MeshHandle b) { return allocationOf(a).offset < allocationOf(b).offset; });
+  OffsetAllocator& allocator = vertices ? vertexAllocator : indexAllocator;
+
+  // GPU side copy: live ranges packed into a scratch buffer, then back to the start of the arena
+  size_t usedSize = 0;
+  for (MeshHandle handle : live)
+    usedSize += allocator.allocationSize(allocationOf(handle)) * elementSize;
+  if (usedSize > 0) {
+    Buffer scratch(usedSize, nullptr, 0);
+    size_t packed = 0;
+    for (MeshHandle handle : live) {
+      size_t size = allocator.allocationSize(allocationOf(handle)) * elementSize;
+      buffer.copyTo(scratch, allocationOf(handle).offset * elementSize, packed, size);
+      packed += size;
+    }
+    scratch.copyTo(buffer, 0, 0, usedSize);
+  }
+
+  // a fresh allocator hands out ranges front to back, reallocating in offset order reproduces the packing
+  std::vector<uint32_t> sizes;
+  for (MeshHandle handle : live)
+    sizes.push_back(allocator.allocationSize(allocationOf(handle)));
+  allocator.reset();
+  for (size_t i = 0; i < live.size(); i++) {
+    OffsetAllocator::Allocation& allocation = allocationOf(live[i]);
+    allocation = allocator.allocate(sizes[i]);
+    MeshRange& range = meshes[live[i]].range;
+    if (vertices)
+      range.baseVertex = static_cast<int32_t>(allocation.offset);
+    else
+      range.firstIndex = allocation.offset * (range.shortIndices ? 2 : 1);
+  }
+}
+
+void MegaBuffer::defragment() {
+  compact(vertexBufferObject, stride, true);
+  compact(indexBufferObject, sizeof(uint32_t), false);
+}
+
+float MegaBuffer::fragmentation() const {
+  float worst = 0.0f;
+  for (const OffsetAllocator* allocator : {&vertexAllocator, &indexAllocator}) {
+    OffsetAllocator::StorageReport report = allocator->storageReport();
+    if (report.totalFree > 0)
+      worst = std::max(worst, 1.0f - static_cast<float>(report.largestFree) / report.totalFree);
+  }
+  return worst;
+}
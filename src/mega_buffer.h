@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "offset_allocator.h"
+#include "resource.h"
+#include "vertex_layout.h"
+
+// megaBuffer: vertex/index arena for many meshes of the same vertex format. one large vertex buffer,
+// one large index buffer and a single VAO are created up front; meshes are sub-allocated with a TLSF
+// offset allocator and become (firstIndex, indexCount, baseVertex) ranges, so any number of them draws
+// without rebinding anything (and batches into one multi-draw). indices stay relative to the mesh, the
+// base vertex does the rest, so defragmenting moves data without rewriting indices. 16 and 32 bit
+// index meshes share the index buffer, which is allocated in 4 byte slots.
+// buffers and VAO are resource.h objects: uploads and moves never bind anything the renderer sees, and
+// the VAO is set up once in the constructor.
+// -----------------------------------
+class MegaBuffer {
+public:
+  using MeshHandle = uint32_t;
+  static constexpr MeshHandle INVALID_MESH = 0xFFFFFFFFu;
+
+  struct MeshRange {
+    uint32_t firstIndex = 0;  // in indices of the mesh's own type
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    bool shortIndices = false;  // GL_UNSIGNED_SHORT instead of GL_UNSIGNED_INT
+
+    uintptr_t indexOffset() const { return static_cast<uintptr_t>(firstIndex) * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)); }
+  };
+
+  // maxIndices counts 32 bit indices, a mesh with 16 bit indices takes half as much
+  MegaBuffer(const VertexLayout& layout, uint32_t maxVertices, uint32_t maxIndices);
+  MegaBuffer(const MegaBuffer&) = delete;
+  MegaBuffer& operator=(const MegaBuffer&) = delete;
+
+  // returns INVALID_MESH when the arena is full even after defragmenting
+  MeshHandle addMesh(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+  MeshHandle addMesh(const void* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount);
+  void removeMesh(MeshHandle mesh);
+  // valid until the next defragment()
+  const MeshRange& range(MeshHandle mesh) const { return meshes[mesh].range; }
+
+  // packs all meshes to the start of the buffers; handles stay valid, their ranges change
+  void defragment();
+
+  unsigned int vao() const { return vertexArray.id(); }
+  unsigned int vertexBuffer() const { return vertexBufferObject.id(); }
+  unsigned int indexBuffer() const { return indexBufferObject.id(); }
+  uint32_t usedVertices() const { return vertexAllocator.size() - vertexAllocator.storageReport().totalFree; }
+  // in 32 bit index slots
+  uint32_t usedIndices() const { return indexAllocator.size() - indexAllocator.storageReport().totalFree; }
+  // share of free space that is not part of the largest free range, 0 = no fragmentation
+  float fragmentation() const;
+
+private:
+  struct Mesh {
+    OffsetAllocator::Allocation vertices;
+    OffsetAllocator::Allocation indices;
+    MeshRange range;
+    bool live = false;
+  };
+
+  MeshHandle addMesh(const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount, bool shortIndices);
+  // moves the live ranges of one buffer to its start in allocation order
+  void compact(Buffer& buffer, size_t elementSize, bool vertices);
+
+  uint32_t stride;
+  OffsetAllocator vertexAllocator;
+  OffsetAllocator indexAllocator;
+  Buffer vertexBufferObject;
+  Buffer indexBufferObject;
+  VertexArray vertexArray;
+  std::vector<Mesh> meshes;
+  std::vector<MeshHandle> freeHandles;
+};
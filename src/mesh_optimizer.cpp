@@ -0,0 +1,586 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "job_system.h"
+
+namespace {
+  struct Position {
+    float x, y, z;
+  };
+
+  Position positionOf(const void* vertices, size_t stride, size_t offset, uint32_t vertex) {
+    Position position;
+    std::memcpy(&position, static_cast<const uint8_t*>(vertices) + vertex * stride + offset, sizeof(Position));
+    return position;
+  }
+
+  // FIFO post-transform cache; loadedAt numbers the misses, 0 = never loaded
+  class FifoCache {
+  public:
+    FifoCache(size_t vertexCount, unsigned int size) : loadedAt(vertexCount, 0), size(size) {}
+
+    // true on a miss
+    bool access(uint32_t vertex) {
+      if (loadedAt[vertex] != 0 && misses - loadedAt[vertex] < size)
+        return false;
+      loadedAt[vertex] = ++misses;
+      touched.push_back(vertex);
+      return true;
+    }
+
+    size_t missCount() const { return misses; }
+
+    // empties the cache in time proportional to what was loaded since the last reset
+    void reset() {
+      for (uint32_t vertex : touched)
+        loadedAt[vertex] = 0;
+      touched.clear();
+      misses = 0;
+    }
+
+  private:
+    std::vector<size_t> loadedAt;
+    std::vector<uint32_t> touched;
+    size_t misses = 0;
+    unsigned int size;
+  };
+
+  Position subtract(Position a, Position b) {
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+  }
+
+  Position cross(Position a, Position b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+  }
+
+  float dot(Position a, Position b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+  }
+
+  // a triangle with its smallest index first, winding kept, so rotations of it compare equal
+  struct Triangle {
+    uint32_t a, b, c;
+
+    bool operator==(const Triangle& other) const { return a == other.a && b == other.b && c == other.c; }
+  };
+
+  struct TriangleHash {
+    size_t operator()(const Triangle& triangle) const {
+      uint64_t hash = triangle.a * 0x9E3779B97F4A7C15ull;
+      hash = (hash ^ triangle.b) * 0xBF58476D1CE4E5B9ull;
+      hash = (hash ^ triangle.c) * 0x94D049BB133111EBull;
+      return static_cast<size_t>(hash ^ (hash >> 31));
+    }
+  };
+
+  Triangle canonical(uint32_t a, uint32_t b, uint32_t c) {
+    if (b < a && b < c)
+      return {b, c, a};
+    if (c < a && c < b)
+      return {c, a, b};
+    return {a, b, c};
+  }
+
+  // spreads the low 10 bits of value to every third bit
+  uint32_t spreadBits(uint32_t value) {
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+  }
+
+  // reorders the triangles along a Morton curve through their centroids, so contiguous blocks of the
+  // result are compact regions of the surface whatever order the mesh was authored in
+  void sortTrianglesSpatially(uint32_t* indices, size_t triangleCount, const void* vertices, size_t stride, size_t offset) {
+    std::vector<Position> centroids(triangleCount);
+    Position low = {INFINITY, INFINITY, INFINITY}, high = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t t = 0; t < triangleCount; t++) {
+      Position a = positionOf(vertices, stride, offset, indices[t * 3]);
+      Position b = positionOf(vertices, stride, offset, indices[t * 3 + 1]);
+      Position c = positionOf(vertices, stride, offset, indices[t * 3 + 2]);
+      centroids[t] = {(a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f};
+      low = {std::min(low.x, centroids[t].x), std::min(low.y, centroids[t].y), std::min(low.z, centroids[t].z)};
+      high = {std::max(high.x, centroids[t].x), std::max(high.y, centroids[t].y), std::max(high.z, centroids[t].z)};
+    }
+    float extent = std::max({high.x - low.x, high.y - low.y, high.z - low.z, 1e-20f});
+    std::vector<uint64_t> keys(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+      auto cell = [&](float value, float base) { return static_cast<uint32_t>((value - base) / extent * 1023.0f); };
+      uint32_t code = spreadBits(cell(centroids[t].x, low.x)) | spreadBits(cell(centroids[t].y, low.y)) << 1 | spreadBits(cell(centroids[t].z, low.z)) << 2;
+      keys[t] = uint64_t(code) << 32 | t;
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<uint32_t> sorted(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+      std::copy(indices + (keys[t] & 0xFFFFFFFFu) * 3, indices + (keys[t] & 0xFFFFFFFFu) * 3 + 3, &sorted[t * 3]);
+    std::copy(sorted.begin(), sorted.end(), indices);
+  }
+
+  // a triangle block of a large mesh, renumbered to dense local vertex ids so the per-vertex
+  // tables of the stages only cover the vertices the block uses
+  struct Block {
+    std::vector<uint32_t> localIndices;
+    std::vector<uint32_t> globalVertices;
+  };
+
+  Block makeBlock(const uint32_t* indices, size_t indexCount) {
+    Block block;
+    block.globalVertices.assign(indices, indices + indexCount);
+    std::sort(block.globalVertices.begin(), block.globalVertices.end());
+    block.globalVertices.erase(std::unique(block.globalVertices.begin(), block.globalVertices.end()), block.globalVertices.end());
+    block.localIndices.resize(indexCount);
+    for (size_t i = 0; i < indexCount; i++)
+      block.localIndices[i] = static_cast<uint32_t>(std::lower_bound(block.globalVertices.begin(), block.globalVertices.end(), indices[i])
+                                                    - block.globalVertices.begin());
+    return block;
+  }
+}
+
+namespace MeshOptimizer {
+  CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+    CacheStats stats;
+    if (indexCount < 3)
+      return stats;
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t unique = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+      if (!referenced[indices[i]]) {
+        referenced[indices[i]] = true;
+        unique++;
+      }
+      cache.access(indices[i]);
+    }
+    stats.acmr = static_cast<float>(cache.missCount()) / (indexCount / 3);
+    stats.atvr = static_cast<float>(cache.missCount()) / unique;
+    return stats;
+  }
+
+  void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+      return;
+    // a trailing partial triangle stays where it is, its indices would name a triangle past the end
+    indexCount = triangleCount * 3;
+    // triangles of every vertex (CSR) and the number not emitted yet
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++)
+      liveTriangles[indices[i]]++;
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+      adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < indexCount; i++)
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+    uint32_t time = cacheSize + 1;
+    uint32_t cursor = 0;
+    int64_t fanning = indices[0];
+
+    while (fanning >= 0) {
+      // emit every remaining triangle around the fanning vertex
+      candidates.clear();
+      uint32_t vertex = static_cast<uint32_t>(fanning);
+      for (uint32_t a = adjacencyStart[vertex]; a < adjacencyStart[vertex + 1]; a++) {
+        uint32_t triangle = adjacency[a];
+        if (emitted[triangle])
+          continue;
+        emitted[triangle] = true;
+        for (int corner = 0; corner < 3; corner++) {
+          uint32_t v = indices[triangle * 3 + corner];
+          output.push_back(v);
+          deadEnd.push_back(v);
+          candidates.push_back(v);
+          liveTriangles[v]--;
+          if (time - cacheTime[v] > cacheSize)
+            cacheTime[v] = time++;
+        }
+      }
+
+      // next fanning vertex: the candidate that stays in the cache longest while its triangles go out
+      fanning = -1;
+      int64_t bestPriority = -1;
+      for (uint32_t v : candidates) {
+        if (liveTriangles[v] == 0)
+          continue;
+        int64_t priority = 0;
+        if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+          priority = time - cacheTime[v];
+        if (priority > bestPriority) {
+          bestPriority = priority;
+          fanning = v;
+        }
+      }
+      if (fanning >= 0)
+        continue;
+      // dead end: recently used vertices first, then input order
+      while (!deadEnd.empty()) {
+        uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0) {
+          fanning = v;
+          break;
+        }
+      }
+      while (fanning < 0 && cursor < vertexCount) {
+        if (liveTriangles[cursor] > 0)
+          fanning = cursor;
+        cursor++;
+      }
+    }
+    std::copy(output.begin(), output.end(), indices);
+  }
+
+  void optimizeOverdraw(uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexStride,
+                        size_t positionOffset, float threshold) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+      return;
+
+    // hard boundaries: the cache restarts where a triangle misses all three vertices
+    FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+    std::vector<uint32_t> clusters;
+    std::vector<uint8_t> triangleMisses(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+      triangleMisses[t] = static_cast<uint8_t>(cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]));
+      if (t == 0 || triangleMisses[t] == 3)
+        clusters.push_back(static_cast<uint32_t>(t));
+    }
+
+    // soft boundaries: split a hard cluster wherever the part so far is already as cache friendly as
+    // the whole cluster (within threshold), more clusters give the sort more freedom
+    std::vector<uint32_t> softClusters;
+    for (size_t c = 0; c < clusters.size(); c++) {
+      size_t start = clusters[c];
+      size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+      size_t clusterMisses = 0;
+      for (size_t t = start; t < end; t++)
+        clusterMisses += triangleMisses[t];
+      float clusterAcmr = static_cast<float>(clusterMisses) / (end - start);
+      cache.reset();
+      size_t softStart = start;
+      softClusters.push_back(static_cast<uint32_t>(start));
+      for (size_t t = start; t < end; t++) {
+        cache.access(indices[t * 3]);
+        cache.access(indices[t * 3 + 1]);
+        cache.access(indices[t * 3 + 2]);
+        if (t + 1 < end && static_cast<float>(cache.missCount()) / (t + 1 - softStart) <= threshold * clusterAcmr) {
+          softClusters.push_back(static_cast<uint32_t>(t + 1));
+          softStart = t + 1;
+          cache.reset();
+        }
+      }
+    }
+
+    // outward facing clusters far from the center occlude the rest, draw them first
+    Position meshCenter = {0.0f, 0.0f, 0.0f};
+    for (size_t i = 0; i < indexCount; i++) {
+      Position p = positionOf(vertices, vertexStride, positionOffset, indices[i]);
+      meshCenter.x += p.x;
+      meshCenter.y += p.y;
+      meshCenter.z += p.z;
+    }
+    meshCenter.x /= indexCount;
+    meshCenter.y /= indexCount;
+    meshCenter.z /= indexCount;
+
+    std::vector<float> sortKey(softClusters.size());
+    for (size_t c = 0; c < softClusters.size(); c++) {
+      size_t start = softClusters[c];
+      size_t end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+      Position centroid = {0.0f, 0.0f, 0.0f}, normal = {0.0f, 0.0f, 0.0f};
+      float area = 0.0f;
+      for (size_t t = start; t < end; t++) {
+        Position a = positionOf(vertices, vertexStride, positionOffset, indices[t * 3]);
+        Position b = positionOf(vertices, vertexStride, positionOffset, indices[t * 3 + 1]);
+        Position d = positionOf(vertices, vertexStride, positionOffset, indices[t * 3 + 2]);
+        Position e1 = {b.x - a.x, b.y - a.y, b.z - a.z}, e2 = {d.x - a.x, d.y - a.y, d.z - a.z};
+        // the cross product is the area weighted face normal
+        Position n = {e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x};
+        float weight = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        centroid.x += (a.x + b.x + d.x) / 3.0f * weight;
+        centroid.y += (a.y + b.y + d.y) / 3.0f * weight;
+        centroid.z += (a.z + b.z + d.z) / 3.0f * weight;
+        normal.x += n.x;
+        normal.y += n.y;
+        normal.z += n.z;
+        area += weight;
+      }
+      float normalLength = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+      if (area == 0.0f || normalLength == 0.0f)
+        continue;
+      sortKey[c] = ((centroid.x / area - meshCenter.x) * normal.x + (centroid.y / area - meshCenter.y) * normal.y
+                   + (centroid.z / area - meshCenter.z) * normal.z) / normalLength;
+    }
+
+    std::vector<uint32_t> order(softClusters.size());
+    for (size_t c = 0; c < order.size(); c++)
+      order[c] = static_cast<uint32_t>(c);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+    for (uint32_t c : order) {
+      size_t start = softClusters[c];
+      size_t end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+      output.insert(output.end(), indices + start * 3, indices + end * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+  }
+
+  size_t optimizeVertexFetch(void* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride) {
+    const uint32_t UNUSED = ~0u;
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+      uint32_t& target = remap[indices[i]];
+      if (target == UNUSED)
+        target = next++;
+      indices[i] = target;
+    }
+    std::vector<uint8_t> reordered(static_cast<size_t>(next) * vertexStride);
+    uint8_t* source = static_cast<uint8_t*>(vertices);
+    for (size_t v = 0; v < vertexCount; v++)
+      if (remap[v] != UNUSED)
+        std::memcpy(&reordered[remap[v] * vertexStride], source + v * vertexStride, vertexStride);
+    std::memcpy(vertices, reordered.data(), reordered.size());
+    return next;
+  }
+
+  size_t simplifyClusters(uint32_t* destination, const uint32_t* indices, size_t indexCount, const void* vertices,
+                          size_t vertexCount, size_t vertexStride, size_t positionOffset, unsigned int gridSize) {
+    gridSize = std::clamp(gridSize, 1u, 1u << 20);
+    Position low = {INFINITY, INFINITY, INFINITY}, high = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t i = 0; i < indexCount; i++) {
+      Position position = positionOf(vertices, vertexStride, positionOffset, indices[i]);
+      low = {std::min(low.x, position.x), std::min(low.y, position.y), std::min(low.z, position.z)};
+      high = {std::max(high.x, position.x), std::max(high.y, position.y), std::max(high.z, position.z)};
+    }
+    float scale = gridSize / std::max({high.x - low.x, high.y - low.y, high.z - low.z, 1e-20f});
+    auto cellKey = [&](Position position) {
+      auto axis = [&](float value, float base) { return std::min(static_cast<uint64_t>((value - base) * scale), uint64_t(gridSize - 1)); };
+      return axis(position.x, low.x) | axis(position.y, low.y) << 21 | axis(position.z, low.z) << 42;
+    };
+
+    // cell of every referenced vertex and the average position of each cell
+    std::unordered_map<uint64_t, uint32_t> cellIds;
+    std::vector<uint32_t> vertexCells(vertexCount, ~0u);
+    std::vector<Position> sums;
+    std::vector<uint32_t> counts;
+    for (size_t i = 0; i < indexCount; i++) {
+      uint32_t vertex = indices[i];
+      if (vertexCells[vertex] != ~0u)
+        continue;
+      Position position = positionOf(vertices, vertexStride, positionOffset, vertex);
+      auto [cell, inserted] = cellIds.try_emplace(cellKey(position), static_cast<uint32_t>(sums.size()));
+      if (inserted) {
+        sums.push_back({0.0f, 0.0f, 0.0f});
+        counts.push_back(0);
+      }
+      vertexCells[vertex] = cell->second;
+      sums[cell->second] = {sums[cell->second].x + position.x, sums[cell->second].y + position.y, sums[cell->second].z + position.z};
+      counts[cell->second]++;
+    }
+    std::vector<uint32_t> representatives(sums.size(), ~0u);
+    std::vector<float> distances(sums.size(), INFINITY);
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+      uint32_t cell = vertexCells[vertex];
+      if (cell == ~0u)
+        continue;
+      float inverse = 1.0f / counts[cell];
+      Position average = {sums[cell].x * inverse, sums[cell].y * inverse, sums[cell].z * inverse};
+      Position offset = subtract(positionOf(vertices, vertexStride, positionOffset, vertex), average);
+      float distance = dot(offset, offset);
+      if (distance < distances[cell]) {
+        distances[cell] = distance;
+        representatives[cell] = vertex;
+      }
+    }
+
+    std::unordered_set<Triangle, TriangleHash> seen;
+    size_t written = 0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+      uint32_t a = representatives[vertexCells[indices[i]]];
+      uint32_t b = representatives[vertexCells[indices[i + 1]]];
+      uint32_t c = representatives[vertexCells[indices[i + 2]]];
+      if (a == b || b == c || a == c || !seen.insert(canonical(a, b, c)).second)
+        continue;
+      destination[written++] = a;
+      destination[written++] = b;
+      destination[written++] = c;
+    }
+    return written;
+  }
+
+  Meshlets buildMeshlets(const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount,
+                         size_t vertexStride, size_t positionOffset) {
+    constexpr uint8_t ABSENT = 0xFF;
+    Meshlets result;
+    std::vector<uint8_t> local(vertexCount, ABSENT);
+    Meshlet current;
+
+    auto finish = [&]() {
+      if (current.triangleCount == 0)
+        return;
+      const uint32_t* meshletVertices = result.vertices.data() + current.vertexOffset;
+      const uint8_t* meshletTriangles = result.triangles.data() + current.triangleOffset;
+      Position low = {INFINITY, INFINITY, INFINITY}, high = {-INFINITY, -INFINITY, -INFINITY};
+      for (uint32_t i = 0; i < current.vertexCount; i++) {
+        Position position = positionOf(vertices, vertexStride, positionOffset, meshletVertices[i]);
+        low = {std::min(low.x, position.x), std::min(low.y, position.y), std::min(low.z, position.z)};
+        high = {std::max(high.x, position.x), std::max(high.y, position.y), std::max(high.z, position.z)};
+        local[meshletVertices[i]] = ABSENT;
+      }
+      Position center = {(low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f};
+      float radius = 0.0f;
+      for (uint32_t i = 0; i < current.vertexCount; i++) {
+        Position offset = subtract(positionOf(vertices, vertexStride, positionOffset, meshletVertices[i]), center);
+        radius = std::max(radius, dot(offset, offset));
+      }
+      current.center[0] = center.x;
+      current.center[1] = center.y;
+      current.center[2] = center.z;
+      current.radius = std::sqrt(radius);
+
+      // cone around the average unit normal, as wide as the normal furthest from it
+      std::vector<Position> normals;
+      Position axis = {0.0f, 0.0f, 0.0f};
+      for (uint32_t t = 0; t < current.triangleCount; t++) {
+        Position a = positionOf(vertices, vertexStride, positionOffset, meshletVertices[meshletTriangles[t * 3]]);
+        Position b = positionOf(vertices, vertexStride, positionOffset, meshletVertices[meshletTriangles[t * 3 + 1]]);
+        Position c = positionOf(vertices, vertexStride, positionOffset, meshletVertices[meshletTriangles[t * 3 + 2]]);
+        Position normal = cross(subtract(b, a), subtract(c, a));
+        float length = std::sqrt(dot(normal, normal));
+        if (length == 0.0f)
+          continue;
+        normal = {normal.x / length, normal.y / length, normal.z / length};
+        normals.push_back(normal);
+        axis = {axis.x + normal.x, axis.y + normal.y, axis.z + normal.z};
+      }
+      float axisLength = std::sqrt(dot(axis, axis));
+      if (axisLength > 1e-6f) {
+        axis = {axis.x / axisLength, axis.y / axisLength, axis.z / axisLength};
+        float spread = 1.0f;
+        for (const Position& normal : normals)
+          spread = std::min(spread, dot(axis, normal));
+        current.coneAxis[0] = axis.x;
+        current.coneAxis[1] = axis.y;
+        current.coneAxis[2] = axis.z;
+        // normals within acos(spread) of the axis all face away once d is within 90 degrees minus that
+        current.coneCutoff = spread > 0.0f ? std::sqrt(1.0f - spread * spread) : 2.0f;
+      }
+
+      result.meshlets.push_back(current);
+      result.triangles.resize((result.triangles.size() + 3) / 4 * 4, 0);
+      current = Meshlet();
+      current.vertexOffset = static_cast<uint32_t>(result.vertices.size());
+      current.triangleOffset = static_cast<uint32_t>(result.triangles.size());
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+      uint32_t triangle[3] = {indices[i], indices[i + 1], indices[i + 2]};
+      if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+        continue;
+      unsigned int added = (local[triangle[0]] == ABSENT) + (local[triangle[1]] == ABSENT) + (local[triangle[2]] == ABSENT);
+      if (current.vertexCount + added > MESHLET_VERTICES || current.triangleCount == MESHLET_TRIANGLES)
+        finish();
+      for (uint32_t vertex : triangle) {
+        if (local[vertex] == ABSENT) {
+          local[vertex] = static_cast<uint8_t>(current.vertexCount++);
+          result.vertices.push_back(vertex);
+        }
+        result.triangles.push_back(local[vertex]);
+      }
+      current.triangleCount++;
+    }
+    finish();
+    return result;
+  }
+
+  void Report::print(const char* name) const {
+    std::cout << "Mesh optimization " << name << ": " << vertexCount << " vertices, " << triangleCount << " triangles, "
+              << "ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << ", "
+              << "index bytes " << indexBytesBefore << " -> " << indexBytesAfter << ", "
+              << milliseconds << " ms on " << threads << (threads == 1 ? " thread" : " threads") << std::endl;
+  }
+
+  Mesh optimize(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, uint32_t positionOffset,
+                const uint32_t* indices, size_t indexCount, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    Mesh mesh;
+    mesh.report.before = analyzeVertexCache(indices, indexCount, vertexCount);
+    mesh.report.indexBytesBefore = indexCount * sizeof(uint32_t);
+    mesh.indices.assign(indices, indices + indexCount);
+    mesh.vertices.assign(static_cast<const uint8_t*>(vertices), static_cast<const uint8_t*>(vertices) + static_cast<size_t>(vertexCount) * vertexStride);
+
+    size_t triangleCount = indexCount / 3;
+    unsigned int threads = 1;
+    unsigned int cores = jobs ? jobs->workerCount() + 1 : std::thread::hardware_concurrency();
+    if (triangleCount > PARALLEL_TRIANGLES)
+      threads = std::max(1u, std::min(cores, static_cast<unsigned int>(triangleCount / (PARALLEL_TRIANGLES / 2))));
+    if (threads == 1) {
+      optimizeVertexCache(mesh.indices.data(), indexCount, vertexCount);
+      optimizeOverdraw(mesh.indices.data(), indexCount, vertices, vertexCount, vertexStride, positionOffset);
+    } else {
+      // each block is a compact region of the surface and is optimized on its own
+      sortTrianglesSpatially(mesh.indices.data(), triangleCount, vertices, vertexStride, positionOffset);
+      auto optimizeBlock = [&](unsigned int t) {
+        size_t first = triangleCount * t / threads, last = triangleCount * (t + 1) / threads;
+        uint32_t* blockIndices = mesh.indices.data() + first * 3;
+        size_t blockIndexCount = (last - first) * 3;
+        Block block = makeBlock(blockIndices, blockIndexCount);
+        std::vector<uint8_t> blockVertices(block.globalVertices.size() * sizeof(Position));
+        for (size_t v = 0; v < block.globalVertices.size(); v++) {
+          Position p = positionOf(vertices, vertexStride, positionOffset, block.globalVertices[v]);
+          std::memcpy(&blockVertices[v * sizeof(Position)], &p, sizeof(Position));
+        }
+        optimizeVertexCache(block.localIndices.data(), blockIndexCount, block.globalVertices.size());
+        optimizeOverdraw(block.localIndices.data(), blockIndexCount, blockVertices.data(), block.globalVertices.size(), sizeof(Position), 0);
+        for (size_t i = 0; i < blockIndexCount; i++)
+          blockIndices[i] = block.globalVertices[block.localIndices[i]];
+      };
+      if (jobs) {
+        jobs->parallelFor(threads, 1, [&](size_t begin, size_t end) {
+          for (size_t t = begin; t < end; t++)
+            optimizeBlock(static_cast<unsigned int>(t));
+        });
+      } else {
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+          workers.emplace_back(optimizeBlock, t);
+        for (auto& worker : workers)
+          worker.join();
+      }
+    }
+    mesh.vertexCount = static_cast<uint32_t>(optimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), indexCount, vertexCount, vertexStride));
+    mesh.vertices.resize(static_cast<size_t>(mesh.vertexCount) * vertexStride);
+
+    mesh.report.after = analyzeVertexCache(mesh.indices.data(), indexCount, mesh.vertexCount);
+    if (mesh.vertexCount <= 65536) {
+      mesh.indices16.assign(mesh.indices.begin(), mesh.indices.end());
+      mesh.indices.clear();
+      mesh.indices.shrink_to_fit();
+    }
+    mesh.report.indexBytesAfter = indexCount * (mesh.shortIndices() ? sizeof(uint16_t) : sizeof(uint32_t));
+    mesh.report.vertexCount = mesh.vertexCount;
+    mesh.report.triangleCount = triangleCount;
+    mesh.report.threads = threads;
+    mesh.report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return mesh;
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// meshOptimizer: reorders indexed triangle meshes for the post-transform vertex cache, overdraw and
+// vertex fetch before they are uploaded. the stages run in this order, each keeps the work of the one
+// before mostly intact:
+//  1. vertex cache: Tipsify (Sander et al. 2007), linear time, cache size VERTEX_CACHE_SIZE
+//  2. overdraw: the cache-ordered triangles are cut into clusters wherever the cache restarts or the
+//     cluster's ACMR stays within threshold of the unsplit one, clusters are drawn outward facing first
+//  3. vertex fetch: vertices are renumbered and moved in first-use order, unreferenced ones dropped
+//  4. indices become 16 bit when the mesh has at most 65536 vertices
+// meshes with more than PARALLEL_TRIANGLES triangles are sorted along a Morton curve and cut into one
+// block per core, blocks go through stages 1 and 2 in parallel (on a JobSystem's threads when given one)
+// and lose a few cache hits at their seams.
+// the offline stages of the asset cooker live here too: LODs by vertex clustering and meshlets.
+// -----------------------------------
+namespace MeshOptimizer {
+  constexpr unsigned int VERTEX_CACHE_SIZE = 16;
+  constexpr size_t PARALLEL_TRIANGLES = 1 << 16;
+
+  // FIFO cache simulation: ACMR = transformed vertices per triangle (0.5 is ideal for large grids, 3
+  // the worst), ATVR = transformed vertices per referenced vertex (1 is ideal)
+  struct CacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+  };
+  CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+  void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+  // positions are 3 floats at positionOffset inside each vertex; expects cache-optimized indices
+  void optimizeOverdraw(uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexStride,
+                        size_t positionOffset, float threshold = 1.05f);
+  // rewrites vertices (vertexCount * vertexStride bytes) in first-use order, returns the vertices kept
+  size_t optimizeVertexFetch(void* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride);
+
+  // vertex clustering (Rossignac & Borrel 1993): the bounds are cut into gridSize^3 cubic cells, the
+  // vertices of a cell collapse onto the one nearest their average and triangles that lose an edge (or
+  // duplicate another) are dropped. the result indexes the same vertices, so all LODs of a mesh share
+  // one vertex buffer. destination needs room for indexCount indices, returns the indices written
+  size_t simplifyClusters(uint32_t* destination, const uint32_t* indices, size_t indexCount, const void* vertices,
+                          size_t vertexCount, size_t vertexStride, size_t positionOffset, unsigned int gridSize);
+
+  // meshlets: small clusters for culling and mesh shading, filled greedily in index order, so
+  // cache-optimized indices make them compact. triangles index their meshlet's vertex list with bytes.
+  constexpr unsigned int MESHLET_VERTICES = 64;
+  constexpr unsigned int MESHLET_TRIANGLES = 124;
+
+  struct Meshlet {
+    uint32_t vertexOffset = 0;    // into Meshlets::vertices
+    uint32_t triangleOffset = 0;  // into Meshlets::triangles, 3 bytes per triangle, 4 byte aligned
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+    float center[3] = {};         // bounding sphere
+    float radius = 0.0f;
+    // normal cone: every triangle faces away from a view direction d (unit, towards the meshlet) with
+    // dot(d, coneAxis) >= coneCutoff; a cutoff above 1 never culls
+    float coneAxis[3] = {};
+    float coneCutoff = 2.0f;
+  };
+
+  struct Meshlets {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;  // mesh vertex indices
+    std::vector<uint8_t> triangles;
+  };
+  Meshlets buildMeshlets(const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount,
+                         size_t vertexStride, size_t positionOffset);
+
+  struct Report {
+    CacheStats before;
+    CacheStats after;
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+    size_t indexBytesBefore = 0;
+    size_t indexBytesAfter = 0;
+    unsigned int threads = 1;
+    double milliseconds = 0.0;
+
+    void print(const char* name) const;
+  };
+
+  struct Mesh {
+    std::vector<uint8_t> vertices;   // vertexCount * stride bytes
+    uint32_t vertexCount = 0;
+    std::vector<uint32_t> indices;   // empty when indices16 holds the indices
+    std::vector<uint16_t> indices16;
+    Report report;
+
+    bool shortIndices() const { return !indices16.empty(); }
+  };
+
+  // all stages; positionOffset points at the 3 float position inside each vertex
+  Mesh optimize(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, uint32_t positionOffset,
+                const uint32_t* indices, size_t indexCount, JobSystem* jobs = nullptr);
+}
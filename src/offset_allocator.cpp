@@ -0,0 +1,205 @@
+#include "offset_allocator.h"
+#include <bit>
+
+namespace {
+  const uint32_t MANTISSA_BITS = 3;
+  const uint32_t MANTISSA_VALUE = 1 << MANTISSA_BITS;
+  const uint32_t MANTISSA_MASK = MANTISSA_VALUE - 1;
+
+  // size class of a size, rounded up: every range in this class or above is large enough
+  uint32_t sizeClassRoundUp(uint32_t size) {
+    if (size < MANTISSA_VALUE)
+      return size;
+    uint32_t highestBit = 31 - std::countl_zero(size);
+    uint32_t mantissaStart = highestBit - MANTISSA_BITS;
+    uint32_t exponent = mantissaStart + 1;
+    uint32_t mantissa = (size >> mantissaStart) & MANTISSA_MASK;
+    if (size & ((1u << mantissaStart) - 1))
+      mantissa++;
+    // a mantissa overflow carries into the exponent, which is exactly the next class
+    return (exponent << MANTISSA_BITS) + mantissa;
+  }
+
+  // size class of a size, rounded down: the class a free range of this size is filed under
+  uint32_t sizeClassRoundDown(uint32_t size) {
+    if (size < MANTISSA_VALUE)
+      return size;
+    uint32_t highestBit = 31 - std::countl_zero(size);
+    uint32_t mantissaStart = highestBit - MANTISSA_BITS;
+    uint32_t exponent = mantissaStart + 1;
+    uint32_t mantissa = (size >> mantissaStart) & MANTISSA_MASK;
+    return (exponent << MANTISSA_BITS) | mantissa;
+  }
+
+  // lowest set bit at or above startBit, NO_SPACE if none
+  uint32_t lowestBitFrom(uint32_t mask, uint32_t startBit) {
+    if (startBit >= 32)
+      return OffsetAllocator::NO_SPACE;
+    uint32_t masked = mask & (~0u << startBit);
+    return masked ? static_cast<uint32_t>(std::countr_zero(masked)) : OffsetAllocator::NO_SPACE;
+  }
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size) : capacity(size) {
+  reset();
+}
+
+void OffsetAllocator::reset() {
+  freeStorage = 0;
+  usedTopBins = 0;
+  for (auto& leaf : usedLeafBins)
+    leaf = 0;
+  for (auto& head : binHeads)
+    head = NO_SPACE;
+  nodes.clear();
+  unusedNodes.clear();
+  if (capacity > 0)
+    insertFree(0, capacity);
+}
+
+uint32_t OffsetAllocator::newNode() {
+  if (!unusedNodes.empty()) {
+    uint32_t index = unusedNodes.back();
+    unusedNodes.pop_back();
+    nodes[index] = Node();
+    return index;
+  }
+  nodes.emplace_back();
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+uint32_t OffsetAllocator::insertFree(uint32_t offset, uint32_t size) {
+  uint32_t sizeClass = sizeClassRoundDown(size);
+  uint32_t top = sizeClass >> MANTISSA_BITS;
+  uint32_t leaf = sizeClass & MANTISSA_MASK;
+  usedTopBins |= 1u << top;
+  usedLeafBins[top] |= 1u << leaf;
+
+  uint32_t index = newNode();
+  Node& node = nodes[index];
+  node.offset = offset;
+  node.size = size;
+  node.binNext = binHeads[sizeClass];
+  if (node.binNext != NO_SPACE)
+    nodes[node.binNext].binPrev = index;
+  binHeads[sizeClass] = index;
+  freeStorage += size;
+  return index;
+}
+
+void OffsetAllocator::removeFree(uint32_t index) {
+  Node& node = nodes[index];
+  if (node.binPrev != NO_SPACE) {
+    nodes[node.binPrev].binNext = node.binNext;
+    if (node.binNext != NO_SPACE)
+      nodes[node.binNext].binPrev = node.binPrev;
+  } else {
+    uint32_t sizeClass = sizeClassRoundDown(node.size);
+    binHeads[sizeClass] = node.binNext;
+    if (node.binNext != NO_SPACE)
+      nodes[node.binNext].binPrev = NO_SPACE;
+    // last range of its class, clear the bits so searches skip it
+    if (binHeads[sizeClass] == NO_SPACE) {
+      uint32_t top = sizeClass >> MANTISSA_BITS;
+      usedLeafBins[top] &= ~(1u << (sizeClass & MANTISSA_MASK));
+      if (usedLeafBins[top] == 0)
+        usedTopBins &= ~(1u << top);
+    }
+  }
+  freeStorage -= node.size;
+  node.binPrev = node.binNext = NO_SPACE;
+}
+
+OffsetAllocator::Allocation OffsetAllocator::allocate(uint32_t size) {
+  Allocation allocation;
+  if (size == 0 || size > freeStorage)
+    return allocation;
+
+  // first non-empty class at or above the rounded-up class: its head fits without scanning the list
+  uint32_t minClass = sizeClassRoundUp(size);
+  uint32_t top = minClass >> MANTISSA_BITS;
+  uint32_t leaf = NO_SPACE;
+  if (top < TOP_BINS && (usedTopBins & (1u << top)))
+    leaf = lowestBitFrom(usedLeafBins[top], minClass & MANTISSA_MASK);
+  if (leaf == NO_SPACE) {
+    top = lowestBitFrom(usedTopBins, top + 1);
+    if (top == NO_SPACE)
+      return allocation;
+    leaf = static_cast<uint32_t>(std::countr_zero(static_cast<uint32_t>(usedLeafBins[top])));
+  }
+  uint32_t index = binHeads[(top << MANTISSA_BITS) | leaf];
+  removeFree(index);
+
+  // split off the tail as a new free range, linked in after this one
+  uint32_t remainder = nodes[index].size - size;
+  nodes[index].size = size;
+  nodes[index].used = true;
+  if (remainder > 0) {
+    uint32_t tail = insertFree(nodes[index].offset + size, remainder);
+    Node& node = nodes[index];
+    nodes[tail].neighborPrev = index;
+    nodes[tail].neighborNext = node.neighborNext;
+    if (node.neighborNext != NO_SPACE)
+      nodes[node.neighborNext].neighborPrev = tail;
+    node.neighborNext = tail;
+  }
+  allocation.offset = nodes[index].offset;
+  allocation.node = index;
+  return allocation;
+}
+
+void OffsetAllocator::free(Allocation allocation) {
+  if (!allocation.valid() || allocation.node >= nodes.size() || !nodes[allocation.node].used)
+    return;
+  uint32_t index = allocation.node;
+  uint32_t offset = nodes[index].offset;
+  uint32_t size = nodes[index].size;
+  uint32_t prev = nodes[index].neighborPrev;
+  uint32_t next = nodes[index].neighborNext;
+
+  // merge with free neighbours, their nodes go back to the pool
+  if (prev != NO_SPACE && !nodes[prev].used) {
+    offset = nodes[prev].offset;
+    size += nodes[prev].size;
+    removeFree(prev);
+    uint32_t before = nodes[prev].neighborPrev;
+    unusedNodes.push_back(prev);
+    prev = before;
+  }
+  if (next != NO_SPACE && !nodes[next].used) {
+    size += nodes[next].size;
+    removeFree(next);
+    uint32_t after = nodes[next].neighborNext;
+    unusedNodes.push_back(next);
+    next = after;
+  }
+  nodes[index].used = false;
+  unusedNodes.push_back(index);
+
+  uint32_t merged = insertFree(offset, size);
+  nodes[merged].neighborPrev = prev;
+  nodes[merged].neighborNext = next;
+  if (prev != NO_SPACE)
+    nodes[prev].neighborNext = merged;
+  if (next != NO_SPACE)
+    nodes[next].neighborPrev = merged;
+}
+
+uint32_t OffsetAllocator::allocationSize(Allocation allocation) const {
+  if (!allocation.valid() || allocation.node >= nodes.size())
+    return 0;
+  return nodes[allocation.node].size;
+}
+
+OffsetAllocator::StorageReport OffsetAllocator::storageReport() const {
+  StorageReport report = {freeStorage, 0};
+  if (usedTopBins) {
+    uint32_t top = 31 - std::countl_zero(usedTopBins);
+    uint32_t leaf = 31 - std::countl_zero(static_cast<uint32_t>(usedLeafBins[top]));
+    // the class gives a lower bound, the largest range of that class decides
+    for (uint32_t index = binHeads[(top << MANTISSA_BITS) | leaf]; index != NO_SPACE; index = nodes[index].binNext)
+      if (nodes[index].size > report.largestFree)
+        report.largestFree = nodes[index].size;
+  }
+  return report;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// offsetAllocator: two-level segregated fit (TLSF) allocator for ranges of an external resource,
+// e.g. vertices or indices inside one large GL buffer. it only hands out offsets, the memory itself
+// lives elsewhere. free ranges sit in 256 size classes (5 exponent bits + 3 mantissa bits, like a
+// tiny float); two bitmasks find the first class that fits in O(1), and freed ranges merge with free
+// neighbours immediately so fragmentation stays low.
+// -----------------------------------
+class OffsetAllocator {
+public:
+  static constexpr uint32_t NO_SPACE = 0xFFFFFFFFu;
+
+  struct Allocation {
+    uint32_t offset = NO_SPACE;
+    uint32_t node = NO_SPACE;   // internal, needed to free
+    bool valid() const { return offset != NO_SPACE; }
+  };
+
+  struct StorageReport {
+    uint32_t totalFree;
+    uint32_t largestFree;
+  };
+
+  explicit OffsetAllocator(uint32_t size);
+
+  Allocation allocate(uint32_t size);
+  void free(Allocation allocation);
+  // forget all allocations
+  void reset();
+
+  uint32_t size() const { return capacity; }
+  uint32_t allocationSize(Allocation allocation) const;
+  StorageReport storageReport() const;
+
+private:
+  static constexpr uint32_t TOP_BINS = 32;
+  static constexpr uint32_t LEAF_BINS = 8;
+  static constexpr uint32_t BIN_COUNT = TOP_BINS * LEAF_BINS;
+
+  struct Node {
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    uint32_t binPrev = NO_SPACE;
+    uint32_t binNext = NO_SPACE;
+    uint32_t neighborPrev = NO_SPACE;
+    uint32_t neighborNext = NO_SPACE;
+    bool used = false;
+  };
+
+  uint32_t insertFree(uint32_t offset, uint32_t size);
+  void removeFree(uint32_t node);
+  uint32_t newNode();
+
+  uint32_t capacity;
+  uint32_t freeStorage = 0;
+  uint32_t usedTopBins = 0;
+  uint8_t usedLeafBins[TOP_BINS] = {};
+  uint32_t binHeads[BIN_COUNT];
+  std::vector<Node> nodes;
+  std::vector<uint32_t> unusedNodes;
+};
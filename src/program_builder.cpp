@@ -0,0 +1,225 @@
+#include "program_builder.h"
+#include "shader.h"
+#include "cpu_profiler.h"
+#include <iostream>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+AsyncProgramBuilder::AsyncProgramBuilder(GLFWwindow* shareWindow, ProgramBinaryCache* cache) : cache(cache) {
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    buildMode = Mode::ParallelCompile;
+  } else if (GLAD_GL_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    buildMode = Mode::ParallelCompile;
+  } else if (shareWindow) {
+    // glfw windows have to be created on the main thread; the context hints of the main window are still set
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    workerWindow = glfwCreateWindow(1, 1, "shader worker", 0, shareWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (workerWindow) {
+      buildMode = Mode::WorkerContext;
+      worker = std::thread(&AsyncProgramBuilder::workerLoop, this);
+    }
+  }
+}
+
+AsyncProgramBuilder::~AsyncProgramBuilder() {
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(workerMutex);
+      workerQuit = true;
+    }
+    workerSignal.notify_one();
+    worker.join();
+  }
+  if (workerWindow)
+    glfwDestroyWindow(workerWindow);
+}
+
+unsigned int AsyncProgramBuilder::submit(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines) {
+  auto build = std::make_unique<Build>();
+  build->stages = stages;
+  for (auto& stage : stages)
+    build->sources.push_back(applyShaderDefines(readShaderFile(stage.fileName), defines));
+  unsigned int handle = static_cast<unsigned int>(builds.size());
+  Build& b = *build;
+  builds.push_back(std::move(build));
+
+  if (inFlight.empty())
+    batchStart = std::chrono::steady_clock::now();
+
+  // a cached binary is ready immediately, no need to involve the compiler at all
+  if (cache) {
+    b.program = cache->loadProgram(b.sources, b.stages);
+    if (b.program != 0) {
+      b.stored = true;
+      b.state = Ready;
+      return handle;
+    }
+  }
+
+  pending++;
+  inFlight.push_back(handle);
+  if (buildMode == Mode::ParallelCompile) {
+    startParallel(b);
+  } else if (buildMode == Mode::WorkerContext) {
+    {
+      std::lock_guard<std::mutex> lock(workerMutex);
+      workerQueue.push(&b);
+    }
+    workerSignal.notify_one();
+  }
+  return handle;
+}
+
+void AsyncProgramBuilder::startParallel(Build& build) {
+  // issue everything without querying any status: compiles and the link run on the driver's threads
+  build.program = glCreateProgram();
+  for (size_t i = 0; i < build.stages.size(); i++) {
+    const char* source = build.sources[i].c_str();
+    unsigned int shader = glCreateShader(build.stages[i].shaderType);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glAttachShader(build.program, shader);
+    build.shaders.push_back(shader);
+  }
+  if (cache)
+    glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(build.program);
+  build.state = Compiling;
+}
+
+bool AsyncProgramBuilder::finishParallel(Build& build) {
+  int done = 0;
+  glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+  if (!done)
+    return false;
+  int success = 0;
+  glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+  if (!success) {
+    char infoLog[512];
+    for (auto& shader : build.shaders) {
+      int compiled = 0;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+      if (!compiled) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+      }
+    }
+    glGetProgramInfoLog(build.program, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+  }
+  for (auto& shader : build.shaders)
+    glDeleteShader(shader);
+  build.shaders.clear();
+  build.state = success ? Ready : Failed;
+  return true;
+}
+
+void AsyncProgramBuilder::buildNow(Build& build) {
+  std::vector<unsigned int> shaders;
+  for (size_t i = 0; i < build.stages.size(); i++)
+    shaders.push_back(compileShaderSource(build.sources[i], build.stages[i].shaderType));
+  build.program = createShaderProgram(shaders, cache != nullptr);
+  for (auto& shader : shaders)
+    glDeleteShader(shader);
+  int success = 0;
+  glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+  build.state = success ? Ready : Failed;
+}
+
+void AsyncProgramBuilder::workerLoop() {
+  CpuProfiler::setThreadName("shader worker");
+  glfwMakeContextCurrent(workerWindow);
+  while (true) {
+    Build* build;
+    {
+      std::unique_lock<std::mutex> lock(workerMutex);
+      workerSignal.wait(lock, [this] { return workerQuit || !workerQueue.empty(); });
+      if (workerQuit)
+        break;
+      build = workerQueue.front();
+      workerQueue.pop();
+    }
+    CPU_ZONE("build program");
+    std::vector<unsigned int> shaders;
+    for (size_t i = 0; i < build->stages.size(); i++)
+      shaders.push_back(compileShaderSource(build->sources[i], build->stages[i].shaderType));
+    unsigned int program = createShaderProgram(shaders, cache != nullptr);
+    for (auto& shader : shaders)
+      glDeleteShader(shader);
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    // the program is shared with the render context; make sure it is complete before publishing it
+    glFinish();
+    build->program = program;
+    build->state.store(success ? Ready : Failed, std::memory_order_release);
+  }
+  glfwMakeContextCurrent(nullptr);
+}
+
+void AsyncProgramBuilder::complete(Build& build, bool success) {
+  pending--;
+  if (!success) {
+    // program() hands out 0 for it, nobody else could delete it
+    glDeleteProgram(build.program);
+    build.program = 0;
+    failedCount++;
+    return;
+  }
+  if (cache && !build.stored) {
+    cache->storeProgram(build.sources, build.stages, build.program);
+    build.stored = true;
+  }
+}
+
+void AsyncProgramBuilder::poll() {
+  if (inFlight.empty() && reportedBuilds == builds.size())
+    return;
+  unsigned int syncBudget = syncBuildsPerPoll;
+  for (size_t i = 0; i < inFlight.size();) {
+    Build& build = *builds[inFlight[i]];
+    bool done = false;
+    if (buildMode == Mode::ParallelCompile) {
+      done = finishParallel(build);
+    } else if (buildMode == Mode::WorkerContext) {
+      done = build.state.load(std::memory_order_acquire) >= Ready;
+    } else if (syncBudget > 0) {
+      syncBudget--;
+      buildNow(build);
+      done = true;
+    }
+    if (done) {
+      complete(build, build.state == Ready);
+      inFlight[i] = inFlight.back();
+      inFlight.pop_back();
+    } else {
+      i++;
+    }
+  }
+
+  if (inFlight.empty()) {
+    reportedBuilds = builds.size();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+    const char* modeName = buildMode == Mode::ParallelCompile ? "parallel compile" : buildMode == Mode::WorkerContext ? "worker context" : "synchronous";
+    std::cout << "AsyncProgramBuilder: " << builds.size() << " programs ready after " << ms << " ms (" << modeName;
+    if (failedCount > 0)
+      std::cout << ", " << failedCount << " failed";
+    std::cout << ")" << std::endl;
+    if (cache)
+      cache->printStats();
+  }
+}
+
+bool AsyncProgramBuilder::isReady(unsigned int handle) const {
+  return handle < builds.size() && builds[handle]->state.load(std::memory_order_acquire) == Ready;
+}
+
+bool AsyncProgramBuilder::hasFailed(unsigned int handle) const {
+  return handle < builds.size() && builds[handle]->state.load(std::memory_order_acquire) == Failed;
+}
+
+unsigned int AsyncProgramBuilder::program(unsigned int handle) const {
+  return isReady(handle) ? builds[handle]->program : 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "program_cache.h"
+
+struct GLFWwindow;
+
+// programBuilder: asynchronous shader program builds
+// submit() queues all compiles and the link up front and returns a handle; poll() once per frame
+// picks up finished programs without ever waiting on the driver.
+// three strategies, chosen at construction:
+//  - KHR/ARB_parallel_shader_compile: the driver compiles on its own threads, poll() checks GL_COMPLETION_STATUS_KHR
+//  - worker context: a hidden shared GLFW context on a std::thread compiles and links
+//  - synchronous: without a window to share with, poll() builds a few programs per frame
+// -----------------------------------
+class AsyncProgramBuilder {
+public:
+  enum class Mode { ParallelCompile, WorkerContext, Synchronous };
+
+  // shareWindow has to be the window of the current context; nullptr disables the worker context fallback
+  explicit AsyncProgramBuilder(GLFWwindow* shareWindow = nullptr, ProgramBinaryCache* cache = nullptr);
+  ~AsyncProgramBuilder();
+  AsyncProgramBuilder(const AsyncProgramBuilder&) = delete;
+  AsyncProgramBuilder& operator=(const AsyncProgramBuilder&) = delete;
+
+  unsigned int submit(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines = {});
+  void poll();
+
+  bool isReady(unsigned int handle) const;
+  bool hasFailed(unsigned int handle) const;
+  // linked program, 0 while the build is still running
+  unsigned int program(unsigned int handle) const;
+  size_t pendingCount() const { return pending; }
+  Mode mode() const { return buildMode; }
+
+  // number of programs the synchronous fallback builds per poll()
+  unsigned int syncBuildsPerPoll = 4;
+
+private:
+  enum State { Queued, Compiling, Ready, Failed };
+  struct Build {
+    std::vector<ShaderStage> stages;
+    std::vector<std::string> sources;
+    std::vector<unsigned int> shaders;
+    unsigned int program = 0;
+    std::atomic<int> state{Queued};
+    bool stored = false;
+  };
+
+  void startParallel(Build& build);
+  bool finishParallel(Build& build);
+  void buildNow(Build& build);
+  void complete(Build& build, bool success);
+  void workerLoop();
+
+  Mode buildMode = Mode::Synchronous;
+  ProgramBinaryCache* cache;
+  std::vector<std::unique_ptr<Build>> builds;
+  std::vector<unsigned int> inFlight;
+  size_t pending = 0;
+  size_t failedCount = 0;
+  size_t reportedBuilds = 0;
+  std::chrono::steady_clock::time_point batchStart;
+
+  GLFWwindow* workerWindow = nullptr;
+  std::thread worker;
+  std::mutex workerMutex;
+  std::condition_variable workerSignal;
+  std::queue<Build*> workerQueue;
+  bool workerQuit = false;
+};
@@ -0,0 +1,176 @@
+#include "program_cache.h"
+#include "shader.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <glad/glad.h>
+
+namespace {
+  // header in front of every cached binary; key is repeated to catch file name collisions
+  struct ProgramBinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+  };
+  const char PROGRAM_BINARY_MAGIC[4] = {'G', 'L', 'P', 'B'};
+  const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+  std::string driverString(GLenum name) {
+    const GLubyte* str = glGetString(name);
+    return str ? reinterpret_cast<const char*>(str) : "";
+  }
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(std::string cacheDir) : cacheDir(std::move(cacheDir)) {
+  driverId = driverString(GL_VENDOR) + "|" + driverString(GL_RENDERER) + "|" + driverString(GL_VERSION) + "|" + driverString(GL_SHADING_LANGUAGE_VERSION);
+  // drivers are allowed to expose zero binary formats, then there is nothing to cache
+  int numFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  supported = numFormats > 0;
+  if (supported) {
+    std::error_code ec;
+    std::filesystem::create_directories(this->cacheDir, ec);
+    if (ec) {
+      std::cout << "ProgramBinaryCache: can't create " << this->cacheDir << ": " << ec.message() << std::endl;
+      supported = false;
+    }
+  }
+}
+
+uint64_t ProgramBinaryCache::computeKey(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages) const {
+  uint64_t key = hashBytes(driverId.data(), driverId.size());
+  for (size_t i = 0; i < sources.size(); i++) {
+    key = hashBytes(&stages[i].shaderType, sizeof(stages[i].shaderType), key);
+    key = hashBytes(sources[i].data(), sources[i].size(), key);
+  }
+  return key;
+}
+
+std::string ProgramBinaryCache::cacheFile(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+  return cacheDir + name;
+}
+
+bool ProgramBinaryCache::loadBinary(uint64_t key, unsigned int& program) {
+  std::ifstream file(cacheFile(key), std::ios::binary);
+  if (!file.is_open())
+    return false;
+  ProgramBinaryHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+      || std::memcmp(header.magic, PROGRAM_BINARY_MAGIC, 4) != 0
+      || header.version != PROGRAM_BINARY_VERSION || header.key != key)
+    return false;
+  std::vector<char> binary(header.binaryLength);
+  if (!file.read(binary.data(), binary.size()))
+    return false;
+
+  program = glCreateProgram();
+  glProgramBinary(program, header.binaryFormat, binary.data(), header.binaryLength);
+  int success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // the driver refuses binaries it no longer understands, drop the stale file
+    glDeleteProgram(program);
+    program = 0;
+    file.close();
+    std::remove(cacheFile(key).c_str());
+    cacheRejected++;
+    return false;
+  }
+  return true;
+}
+
+void ProgramBinaryCache::storeBinary(uint64_t key, unsigned int program) {
+  int length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+  std::vector<char> binary(length);
+  GLenum binaryFormat = 0;
+  glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+  ProgramBinaryHeader header;
+  std::memcpy(header.magic, PROGRAM_BINARY_MAGIC, 4);
+  header.version = PROGRAM_BINARY_VERSION;
+  header.key = key;
+  header.binaryFormat = binaryFormat;
+  header.binaryLength = static_cast<uint32_t>(length);
+
+  // write to a temporary file and rename, so a crash never leaves a truncated binary behind
+  std::string path = cacheFile(key);
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+      return;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    if (!file.good())
+      return;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+}
+
+unsigned int ProgramBinaryCache::createProgram(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines) {
+  std::vector<std::string> sources;
+  for (auto& stage : stages)
+    sources.push_back(applyShaderDefines(readShaderFile(stage.fileName), defines));
+  return createProgramFromSources(sources, stages);
+}
+
+unsigned int ProgramBinaryCache::loadProgram(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages) {
+  unsigned int program = 0;
+  if (supported && loadBinary(computeKey(sources, stages), program)) {
+    cacheHits++;
+    return program;
+  }
+  cacheMisses++;
+  return 0;
+}
+
+void ProgramBinaryCache::storeProgram(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages, unsigned int program) {
+  int success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (supported && success)
+    storeBinary(computeKey(sources, stages), program);
+}
+
+unsigned int ProgramBinaryCache::createProgramFromSources(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages) {
+  unsigned int program = loadProgram(sources, stages);
+  if (program != 0)
+    return program;
+
+  std::vector<unsigned int> shaders;
+  for (size_t i = 0; i < stages.size(); i++)
+    shaders.push_back(compileShaderSource(sources[i], stages[i].shaderType));
+  program = createShaderProgram(shaders, supported);
+  for (auto& shader : shaders)
+    glDeleteShader(shader);
+  storeProgram(sources, stages, program);
+  return program;
+}
+
+void ProgramBinaryCache::printStats() const {
+  std::cout << "ProgramBinaryCache: " << cacheHits << " hits, " << cacheMisses << " misses";
+  if (cacheRejected > 0)
+    std::cout << " (" << cacheRejected << " binaries rejected by the driver)";
+  if (!supported)
+    std::cout << " (driver exposes no program binary formats)";
+  std::cout << std::endl;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one stage of a shader program: shaderfile (relative to SHADER_PATH) and GL shader type
+struct ShaderStage {
+  std::string fileName;
+  unsigned int shaderType;
+};
+
+// programCache: on-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary)
+// the cache key hashes the shader sources, the defines and the driver vendor/renderer/version strings,
+// so a driver update or an edited shader simply misses instead of loading a stale binary.
+// binaries the driver rejects are deleted and the program is rebuilt from source.
+// -----------------------------------
+class ProgramBinaryCache {
+public:
+  explicit ProgramBinaryCache(std::string cacheDir);
+
+  // returns a linked program, loaded from the cache if possible
+  unsigned int createProgram(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines = {});
+
+  // same as above for callers that already have the (preprocessed) sources, one per stage
+  unsigned int createProgramFromSources(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages);
+
+  // split lookup for asynchronous builders: loadProgram returns 0 on a miss (counted as miss),
+  // storeProgram saves a program that was linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+  unsigned int loadProgram(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages);
+  void storeProgram(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages, unsigned int program);
+
+  unsigned int hits() const { return cacheHits; }
+  unsigned int misses() const { return cacheMisses; }
+  unsigned int rejected() const { return cacheRejected; }
+  bool isSupported() const { return supported; }
+  void printStats() const;
+
+private:
+  uint64_t computeKey(const std::vector<std::string>& sources, const std::vector<ShaderStage>& stages) const;
+  std::string cacheFile(uint64_t key) const;
+  bool loadBinary(uint64_t key, unsigned int& program);
+  void storeBinary(uint64_t key, unsigned int program);
+
+  std::string cacheDir;
+  std::string driverId;
+  bool supported = false;
+  unsigned int cacheHits = 0;
+  unsigned int cacheMisses = 0;
+  unsigned int cacheRejected = 0;
+};
+
+// hash: 64 bit FNV-1a, used for cache keys
+// -----------------------------------
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
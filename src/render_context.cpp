@@ -0,0 +1,379 @@
+#include "render_context.h"
+#include "startup_profiler.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#ifdef OPENGL_HEADLESS_EGL
+  #define EGL_NO_X11
+  #include <EGL/egl.h>
+  #include <EGL/eglext.h>
+#endif
+#ifdef OPENGL_HEADLESS_OSMESA
+  #include <GL/osmesa.h>
+#endif
+
+namespace {
+  // startup phases are optional
+  void beginPhase(StartupProfiler* startup, const char* name) {
+    if (startup)
+      startup->begin(name);
+  }
+  void endPhase(StartupProfiler* startup) {
+    if (startup)
+      startup->end();
+  }
+
+  // core versions tried for headless contexts, highest first
+  const int HEADLESS_GL_VERSIONS[][2] = {{4, 6}, {4, 5}, {4, 3}, {4, 1}};
+
+  // window: glfw window with the context as active context
+  class WindowContext : public RenderContext {
+  public:
+    explicit WindowContext(GLFWwindow* window) : glfwWindow(window) {}
+    ~WindowContext() override {
+      glfwDestroyWindow(glfwWindow);
+      glfwTerminate();
+    }
+    bool shouldClose() override { return glfwWindowShouldClose(glfwWindow); }
+    void present() override { glfwSwapBuffers(glfwWindow); }
+    void pollEvents() override { glfwPollEvents(); }
+    void setSwapInterval(int interval) override { glfwSwapInterval(interval); }
+    void framebufferSize(int& width, int& height) const override { glfwGetFramebufferSize(glfwWindow, &width, &height); }
+    GLFWwindow* window() const override { return glfwWindow; }
+    const char* backendName() const override { return "glfw"; }
+
+  private:
+    GLFWwindow* glfwWindow;
+  };
+
+  // headless: offscreen FBO, frames are read back through two pixel pack buffers so the readback of
+  // frame n is only mapped while frame n+1 renders and never stalls the pipeline
+  class HeadlessContext : public RenderContext {
+  public:
+    HeadlessContext(ContextSettings& settings)
+      : startup(settings.startup), width(settings.width), height(settings.height), maxFrames(settings.maxFrames),
+        sink(std::move(settings.sink)) {}
+
+    std::unique_ptr<FrameSink> releaseSink() { return std::move(sink); }
+
+    bool createFramebuffer() {
+      glGenFramebuffers(1, &fbo);
+      glGenRenderbuffers(2, renderbuffers);
+      glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+      glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        return false;
+      }
+      glViewport(0, 0, width, height);
+      if (sink && sink->wantsPixels()) {
+        glGenBuffers(2, pbos);
+        for (auto pbo : pbos) {
+          glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+          glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      }
+      return true;
+    }
+
+    void destroyFramebuffer() {
+      if (fbo == 0)
+        return;
+      // hand the last frame that is still in flight to the sink
+      if (pbos[0] && frameIndex > 0)
+        consumeFrame(frameIndex - 1);
+      glDeleteBuffers(2, pbos);
+      glDeleteRenderbuffers(2, renderbuffers);
+      glDeleteFramebuffers(1, &fbo);
+      fbo = 0;
+    }
+
+    bool shouldClose() override { return maxFrames != 0 && frameIndex >= maxFrames; }
+
+    void present() override {
+      if (pbos[0]) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[frameIndex % 2]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (frameIndex > 0)
+          consumeFrame(frameIndex - 1);
+      }
+      glFlush();
+      frameIndex++;
+    }
+
+    unsigned int framebuffer() const override { return fbo; }
+    void framebufferSize(int& w, int& h) const override { w = width; h = height; }
+
+  protected:
+    StartupProfiler* startup;
+
+  private:
+    void consumeFrame(unsigned long long index) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[index % 2]);
+      const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(width) * height * 4, GL_MAP_READ_BIT);
+      if (pixels) {
+        sink->consume(static_cast<const unsigned char*>(pixels), width, height, index);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    int width;
+    int height;
+    unsigned long long maxFrames;
+    unsigned long long frameIndex = 0;
+    std::unique_ptr<FrameSink> sink;
+    unsigned int fbo = 0;
+    unsigned int renderbuffers[2] = {0, 0};
+    unsigned int pbos[2] = {0, 0};
+  };
+
+#ifdef OPENGL_HEADLESS_EGL
+  void* eglLoad(const char* name) {
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+  }
+
+  bool hasExtension(const char* extensions, const char* name) {
+    if (!extensions)
+      return false;
+    size_t length = std::strlen(name);
+    for (const char* pos = std::strstr(extensions, name); pos; pos = std::strstr(pos + length, name)) {
+      if ((pos == extensions || pos[-1] == ' ') && (pos[length] == ' ' || pos[length] == '\0'))
+        return true;
+    }
+    return false;
+  }
+
+  // headless EGL: surfaceless platform (no display server or GPU needed with Mesa llvmpipe),
+  // otherwise the default display with a 1x1 pbuffer
+  class EglContext : public HeadlessContext {
+  public:
+    using HeadlessContext::HeadlessContext;
+    ~EglContext() override {
+      if (display == EGL_NO_DISPLAY)
+        return;
+      destroyFramebuffer();
+      eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+      if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+      if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+      eglTerminate(display);
+    }
+
+    bool create() {
+      beginPhase(startup, "eglCreateContext");
+      bool created = createContext();
+      endPhase(startup);
+      if (!created)
+        return false;
+
+      beginPhase(startup, "gladLoadGLLoader");
+      bool loaded = gladLoadGLLoader((GLADloadproc)eglLoad);
+      endPhase(startup);
+      if (!loaded) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+      }
+      return createFramebuffer();
+    }
+
+    const char* backendName() const override { return "egl"; }
+
+  private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    bool createContext() {
+      const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+      if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay)
+          display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+      }
+      if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+      EGLint major, minor;
+      if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        display = EGL_NO_DISPLAY;
+        return false;
+      }
+      if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+      bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+      const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+      };
+      EGLConfig config;
+      EGLint numConfigs = 0;
+      if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+        return false;
+
+      for (auto& version : HEADLESS_GL_VERSIONS) {
+        const EGLint contextAttribs[] = {
+          EGL_CONTEXT_MAJOR_VERSION, version[0],
+          EGL_CONTEXT_MINOR_VERSION, version[1],
+          EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+          EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context != EGL_NO_CONTEXT)
+          break;
+      }
+      if (context == EGL_NO_CONTEXT)
+        return false;
+
+      if (!surfaceless) {
+        const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        if (surface == EGL_NO_SURFACE)
+          return false;
+      }
+      return eglMakeCurrent(display, surface, surface, context);
+    }
+  };
+#endif
+
+#ifdef OPENGL_HEADLESS_OSMESA
+  void* osmesaLoad(const char* name) {
+    return reinterpret_cast<void*>(OSMesaGetProcAddress(name));
+  }
+
+  // headless OSMesa: software rasterizer without any window system; the 1x1 default
+  // framebuffer is never drawn to, the render loop uses the FBO
+  class OsmesaContext : public HeadlessContext {
+  public:
+    using HeadlessContext::HeadlessContext;
+    ~OsmesaContext() override {
+      if (!context)
+        return;
+      destroyFramebuffer();
+      OSMesaDestroyContext(context);
+    }
+
+    bool create() {
+      beginPhase(startup, "OSMesaCreateContext");
+      for (auto& version : HEADLESS_GL_VERSIONS) {
+        const int attribs[] = {
+          OSMESA_FORMAT, OSMESA_RGBA,
+          OSMESA_DEPTH_BITS, 0,
+          OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+          OSMESA_CONTEXT_MAJOR_VERSION, version[0],
+          OSMESA_CONTEXT_MINOR_VERSION, version[1],
+          0
+        };
+        context = OSMesaCreateContextAttribs(attribs, NULL);
+        if (context)
+          break;
+      }
+      bool created = context && OSMesaMakeCurrent(context, defaultBuffer, GL_UNSIGNED_BYTE, 1, 1);
+      endPhase(startup);
+      if (!created)
+        return false;
+
+      beginPhase(startup, "gladLoadGLLoader");
+      bool loaded = gladLoadGLLoader((GLADloadproc)osmesaLoad);
+      endPhase(startup);
+      if (!loaded) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+      }
+      return createFramebuffer();
+    }
+
+    const char* backendName() const override { return "osmesa"; }
+
+  private:
+    OSMesaContext context = NULL;
+    unsigned char defaultBuffer[4];
+  };
+#endif
+}
+
+std::unique_ptr<RenderContext> createWindowContext(ContextSettings& settings) {
+  //init glfw and set context to latest macos opengl version (OpenGL 4.1)
+  beginPhase(settings.startup, "glfwInit");
+  bool initialized = glfwInit();
+  endPhase(settings.startup);
+  if(!initialized)
+  {
+    std::cout << "GLFW Not Initialized" << std::endl;
+    return nullptr;
+  }
+
+  // apples highest supported version is 4.1
+  #ifdef __APPLE__
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  #else
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+  #endif
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+  // create glfw window and set as active context
+  beginPhase(settings.startup, "glfwCreateWindow");
+  GLFWwindow* window = glfwCreateWindow(settings.width, settings.height, settings.title.c_str(), 0, 0);
+  if(!window)
+  {
+    endPhase(settings.startup);
+    std::cout << "Window wasn't created" << std::endl;
+    glfwTerminate();
+    return nullptr;
+  }
+  glfwMakeContextCurrent(window);
+  auto context = std::make_unique<WindowContext>(window);
+  endPhase(settings.startup);
+
+  //init glad function loader to get all opengl core/extension functions
+  beginPhase(settings.startup, "gladLoadGLLoader");
+  bool loaded = gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+  endPhase(settings.startup);
+  if (!loaded)
+  {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return nullptr;
+  }
+  return context;
+}
+
+std::unique_ptr<RenderContext> createHeadlessContext(ContextSettings& settings) {
+  const std::string& backend = settings.headlessBackend;
+#ifdef OPENGL_HEADLESS_EGL
+  if (backend.empty() || backend == "egl") {
+    auto context = std::make_unique<EglContext>(settings);
+    if (context->create())
+      return context;
+    std::cout << "Headless EGL context wasn't created" << std::endl;
+    // the sink moved into the failed context, give it back for the next backend
+    settings.sink = context->releaseSink();
+  }
+#endif
+#ifdef OPENGL_HEADLESS_OSMESA
+  if (backend.empty() || backend == "osmesa") {
+    auto context = std::make_unique<OsmesaContext>(settings);
+    if (context->create())
+      return context;
+    std::cout << "Headless OSMesa context wasn't created" << std::endl;
+  }
+#endif
+  std::cout << "No headless backend available" << (backend.empty() ? "" : " for " + backend) << std::endl;
+  return nullptr;
+}
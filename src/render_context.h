@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "frame_sink.h"
+
+struct GLFWwindow;
+class StartupProfiler;
+
+// renderContext: the GL context the render loop runs on and where its frames go.
+// a glfw window presents with glfwSwapBuffers, a headless context (EGL surfaceless/pbuffer or OSMesa)
+// renders into an offscreen FBO of any size and hands finished frames to a FrameSink.
+// -----------------------------------
+class RenderContext {
+public:
+  virtual ~RenderContext() = default;
+
+  virtual bool shouldClose() = 0;
+  // swap buffers or pass the frame to the sink
+  virtual void present() = 0;
+  virtual void pollEvents() {}
+  virtual void setSwapInterval(int) {}
+  // framebuffer the render loop draws into, 0 for the default framebuffer of a window
+  virtual unsigned int framebuffer() const { return 0; }
+  virtual void framebufferSize(int& width, int& height) const = 0;
+  // nullptr for headless contexts
+  virtual GLFWwindow* window() const { return nullptr; }
+  virtual const char* backendName() const = 0;
+};
+
+struct ContextSettings {
+  int width = 1600;
+  int height = 900;
+  std::string title = "OpenGL Tutorial";
+  // headless only: "egl", "osmesa" or "" for the first that works
+  std::string headlessBackend;
+  // headless only: shouldClose() turns true after this many frames, 0 runs forever
+  unsigned long long maxFrames = 300;
+  // headless only: receives the finished frames, nullptr skips the readback
+  std::unique_ptr<FrameSink> sink;
+  // optional: records the context creation and loader phases
+  StartupProfiler* startup = nullptr;
+};
+
+// renderContext: create a glfw window context (initializes glfw); nullptr on failure
+// -----------------------------------
+std::unique_ptr<RenderContext> createWindowContext(ContextSettings& settings);
+
+// renderContext: create a headless context with an offscreen FBO; nullptr on failure
+// -----------------------------------
+std::unique_ptr<RenderContext> createHeadlessContext(ContextSettings& settings);
@@ -0,0 +1,235 @@
+#include "render_queue.h"
+#include "state_cache.h"
+#include "stream_buffer.h"
+#include <algorithm>
+#include <glad/glad.h>
+
+namespace {
+  const int PROGRAM_BITS = 10;
+  const int MATERIAL_BITS = 12;
+  const int VAO_BITS = 12;
+  const int DEPTH_BITS = 24;
+  const int STATE_BITS = PROGRAM_BITS + MATERIAL_BITS + VAO_BITS;
+
+  uint64_t mask(int bits) { return (uint64_t(1) << bits) - 1; }
+
+  uint64_t quantizeDepth(float depth) {
+    float clamped = std::min(1.0f, std::max(0.0f, depth));
+    return static_cast<uint64_t>(clamped * static_cast<float>(mask(DEPTH_BITS))) & mask(DEPTH_BITS);
+  }
+}
+
+RenderQueue::~RenderQueue() {
+  if (indirectBuffer)
+    glDeleteBuffers(1, &indirectBuffer);
+  if (drawDataBuffer)
+    glDeleteBuffers(1, &drawDataBuffer);
+}
+
+bool RenderQueue::batchingSupported() {
+  // both are core in 4.6, where drivers don't have to list the extensions
+  return GLAD_GL_VERSION_4_6 || ((GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect) && GLAD_GL_ARB_shader_draw_parameters);
+}
+
+bool RenderQueue::setBatching(bool enable) {
+  batched = enable && batchingSupported();
+  return batched;
+}
+
+uint64_t RenderQueue::makeKey(Pass pass, uint32_t program, uint32_t material, uint32_t vao, float depth) {
+  // ids past the field width wrap around; draws stay correct, only the grouping gets worse
+  uint64_t state = (uint64_t(program) & mask(PROGRAM_BITS)) << (MATERIAL_BITS + VAO_BITS)
+                 | (uint64_t(material) & mask(MATERIAL_BITS)) << VAO_BITS
+                 | (uint64_t(vao) & mask(VAO_BITS));
+  uint64_t key = uint64_t(pass) << (64 - 2);
+  if (pass == Opaque)
+    key |= state << DEPTH_BITS | quantizeDepth(depth);
+  else
+    key |= (mask(DEPTH_BITS) - quantizeDepth(depth)) << STATE_BITS | state;
+  return key;
+}
+
+uint32_t RenderQueue::denseId(std::unordered_map<unsigned int, uint32_t>& ids, unsigned int name) {
+  auto it = ids.find(name);
+  if (it != ids.end())
+    return it->second;
+  uint32_t id = static_cast<uint32_t>(ids.size());
+  ids.emplace(name, id);
+  return id;
+}
+
+uint32_t RenderQueue::addMaterial(const Material& newMaterial) {
+  materials.push_back(newMaterial);
+  materialProgramIds.push_back(denseId(programIds, newMaterial.program));
+  return static_cast<uint32_t>(materials.size() - 1);
+}
+
+void RenderQueue::submit(Pass pass, const DrawPacket& packet) {
+  uint32_t vaoId = denseId(vaoIds, packet.vao << 1 | (packet.shortIndices ? 1u : 0u));
+  keys.push_back(makeKey(pass, materialProgramIds[packet.material], packet.material, vaoId, packet.depth));
+  packets.push_back(packet);
+  sorted = false;
+}
+
+void RenderQueue::sort() {
+  size_t count = keys.size();
+  order.resize(count);
+  for (size_t i = 0; i < count; i++)
+    order[i] = static_cast<uint32_t>(i);
+  if (count > 1) {
+    // LSD radix sort over the 8 key bytes, all histograms in one sweep; a byte that is the same in
+    // every key (e.g. the pass bits when there is only one pass) costs no scatter pass
+    std::array<std::array<uint32_t, 256>, 8> histograms = {};
+    for (uint64_t key : keys)
+      for (int byte = 0; byte < 8; byte++)
+        histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+    keyScratch.resize(count);
+    orderScratch.resize(count);
+    for (int byte = 0; byte < 8; byte++) {
+      auto& histogram = histograms[byte];
+      if (histogram[(keys[0] >> (byte * 8)) & 0xFF] == count)
+        continue;
+      uint32_t offset = 0;
+      for (auto& bucket : histogram) {
+        uint32_t size = bucket;
+        bucket = offset;
+        offset += size;
+      }
+      for (size_t i = 0; i < count; i++) {
+        uint32_t slot = histogram[(keys[i] >> (byte * 8)) & 0xFF]++;
+        keyScratch[slot] = keys[i];
+        orderScratch[slot] = order[i];
+      }
+      keys.swap(keyScratch);
+      order.swap(orderScratch);
+    }
+  }
+  sorted = true;
+}
+
+void RenderQueue::applyState(StateCache& state, Bound& bound, uint32_t pass, const DrawPacket& packet) {
+  if (pass != bound.pass) {
+    bound.pass = pass;
+    // opaque writes depth, transparent tests against it and blends, overlays draw on top
+    state.setEnabled(GL_DEPTH_TEST, pass != Overlay);
+    state.depthFunc(GL_LEQUAL);
+    state.depthMask(pass == Opaque);
+    state.setEnabled(GL_BLEND, pass != Opaque);
+    if (pass != Opaque)
+      state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  if (packet.material != bound.material) {
+    const Material& m = materials[packet.material];
+    if (m.program != bound.program)
+      stats.programChanges++;
+    bound.material = packet.material;
+    bound.program = m.program;
+    stats.materialChanges++;
+    state.useProgram(m.program);
+    for (unsigned int unit = 0; unit < m.textures.size(); unit++)
+      if (m.textures[unit] != 0)
+        state.bindTexture(unit, GL_TEXTURE_2D, m.textures[unit]);
+  }
+  if (packet.vao != bound.vao) {
+    bound.vao = packet.vao;
+    stats.vaoChanges++;
+    state.bindVertexArray(packet.vao);
+  }
+}
+
+void RenderQueue::execute(StateCache& state) {
+  if (!sorted)
+    sort();
+  stats = Stats();
+  stats.packets = static_cast<unsigned int>(packets.size());
+  if (batched) {
+    executeBatched(state);
+  } else {
+    Bound bound;
+    for (size_t i = 0; i < order.size(); i++) {
+      const DrawPacket& packet = packets[order[i]];
+      applyState(state, bound, static_cast<uint32_t>(keys[i] >> 62), packet);
+      if (packet.uniformLocation >= 0)
+        glUniform4fv(packet.uniformLocation, 1, packet.uniform.data());
+      glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, packet.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                               reinterpret_cast<void*>(packet.indexOffset), packet.baseVertex);
+      stats.drawCalls++;
+    }
+  }
+  clear();
+}
+
+void RenderQueue::executeBatched(StateCache& state) {
+  if (order.empty())
+    return;
+  // DrawElementsIndirectCommand: count, instanceCount, firstIndex, baseVertex, baseInstance
+  size_t commandBytes = order.size() * 5 * sizeof(uint32_t);
+  size_t dataBytes = order.size() * sizeof(std::array<float, 4>);
+  StreamBuffer::Allocation commandSpace, dataSpace;
+  if (stream) {
+    commandSpace = stream->allocate(commandBytes, sizeof(uint32_t));
+    dataSpace = stream->allocate(dataBytes);
+  }
+  bool streamed = commandSpace.data && dataSpace.data;
+  if (!streamed) {
+    commands.resize(order.size() * 5);
+    drawData.resize(order.size());
+  }
+  uint32_t* commandOut = streamed ? static_cast<uint32_t*>(commandSpace.data) : commands.data();
+  std::array<float, 4>* dataOut = streamed ? static_cast<std::array<float, 4>*>(dataSpace.data) : drawData.data();
+  for (size_t i = 0; i < order.size(); i++) {
+    const DrawPacket& packet = packets[order[i]];
+    uint32_t* command = &commandOut[i * 5];
+    command[0] = packet.indexCount;
+    command[1] = 1;
+    command[2] = static_cast<uint32_t>(packet.indexOffset / (packet.shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)));
+    command[3] = static_cast<uint32_t>(packet.baseVertex);
+    command[4] = static_cast<uint32_t>(i);
+    dataOut[i] = packet.uniform;
+  }
+  uintptr_t commandOffset = 0;
+  if (streamed) {
+    stream->flush();
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, stream->buffer());
+    state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, stream->buffer(), dataSpace.offset, dataBytes);
+    commandOffset = static_cast<uintptr_t>(commandSpace.offset);
+  } else {
+    if (!indirectBuffer) {
+      glGenBuffers(1, &indirectBuffer);
+      glGenBuffers(1, &drawDataBuffer);
+    }
+    // orphaned every frame, the driver hands out fresh storage while the last frame is still in flight
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, commands.data(), GL_STREAM_DRAW);
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, dataBytes, drawData.data(), GL_STREAM_DRAW);
+  }
+
+  // compatible packets are adjacent after sorting: same pass, material (program), VAO and index type
+  Bound bound;
+  size_t runStart = 0;
+  for (size_t i = 0; i <= order.size(); i++) {
+    bool end = i == order.size();
+    uint32_t pass = end ? ~0u : static_cast<uint32_t>(keys[i] >> 62);
+    if (!end && pass == bound.pass && packets[order[i]].material == bound.material && packets[order[i]].vao == bound.vao
+        && packets[order[i]].shortIndices == packets[order[runStart]].shortIndices)
+      continue;
+    if (i > runStart) {
+      GLenum indexType = packets[order[runStart]].shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+      glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, reinterpret_cast<void*>(commandOffset + runStart * 5 * sizeof(uint32_t)),
+                                  static_cast<GLsizei>(i - runStart), 0);
+      stats.drawCalls++;
+    }
+    if (end)
+      break;
+    runStart = i;
+    applyState(state, bound, pass, packets[order[i]]);
+  }
+}
+
+void RenderQueue::clear() {
+  packets.clear();
+  keys.clear();
+  order.clear();
+  sorted = true;
+}
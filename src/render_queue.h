@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class StateCache;
+class StreamBuffer;
+
+// material: program plus the textures it samples (GL_TEXTURE_2D on units 0..n)
+// -----------------------------------
+struct Material {
+  unsigned int program = 0;
+  std::array<unsigned int, 4> textures = {};
+};
+
+// drawPacket: one indexed draw as submitted by a system; the queue owns ordering and state changes
+// -----------------------------------
+struct DrawPacket {
+  uint32_t material = 0;        // index returned by RenderQueue::addMaterial
+  unsigned int vao = 0;
+  unsigned int indexCount = 0;
+  uintptr_t indexOffset = 0;    // bytes into the element buffer
+  bool shortIndices = false;    // GL_UNSIGNED_SHORT instead of GL_UNSIGNED_INT indices
+  int baseVertex = 0;
+  float depth = 0.0f;           // normalized view depth, 0 = near, 1 = far
+  int uniformLocation = -1;     // optional per-draw vec4 uniform
+  std::array<float, 4> uniform = {}; // in batched mode: drawData[gl_BaseInstanceARB] instead of the uniform
+};
+
+// renderQueue: draws are collected as packets with a 64-bit sort key, radix-sorted once per frame and
+// replayed through the state cache, so consecutive draws share program/material/VAO and the state
+// changes between them are minimal. key layout, most significant bits first:
+//   opaque:       pass(2) | program(10) | material(12) | vao(12) | depth(24) front to back (early-Z)
+//   transparent:  pass(2) | depth(24) back to front | program(10) | material(12) | vao(12)
+//
+// the vao field tells VAO and index type apart, so packets that can share a multi-draw are adjacent.
+//
+// batched mode (GL 4.6, or 4.3 / ARB_multi_draw_indirect plus ARB_shader_draw_parameters): runs of sorted
+// packets with the same pass, material, VAO and index type become one glMultiDrawElementsIndirect. the commands
+// go into a GL_DRAW_INDIRECT_BUFFER, the per-draw vec4s into a shader storage buffer at binding
+// DRAW_DATA_BINDING; each command's baseInstance is its draw index, so shaders read
+//   layout(std430, binding = 0) readonly buffer DrawData { vec4 drawData[]; };
+//   vec4 data = drawData[gl_BaseInstanceARB];  // gl_BaseInstance in GLSL 4.60
+// materials drawn in batched mode need shaders written that way (see shader/bench_mdi.vert, and
+// bench_mdi_460.vert for 4.6 drivers without the extension).
+// with a stream buffer the commands and draw data are written straight into its mapped partition,
+// otherwise they go through orphaned buffers.
+// -----------------------------------
+class RenderQueue {
+public:
+  enum Pass : uint32_t { Opaque = 0, Transparent = 1, Overlay = 2 };
+
+  struct Stats {
+    unsigned int packets = 0;
+    unsigned int programChanges = 0;
+    unsigned int materialChanges = 0;
+    unsigned int vaoChanges = 0;
+    // GL draw calls actually issued (one per multi-draw in batched mode)
+    unsigned int drawCalls = 0;
+  };
+
+  static constexpr unsigned int DRAW_DATA_BINDING = 0;
+
+  RenderQueue() = default;
+  ~RenderQueue();
+  RenderQueue(const RenderQueue&) = delete;
+  RenderQueue& operator=(const RenderQueue&) = delete;
+
+  // batched mode is only enabled when the driver supports it, returns whether it is on
+  bool setBatching(bool enable);
+  bool batching() const { return batched; }
+  static bool batchingSupported();
+  // per-frame storage for batched mode; beginFrame/endFrame of the stream buffer are up to the caller
+  void setStreamBuffer(StreamBuffer* buffer) { stream = buffer; }
+
+  uint32_t addMaterial(const Material& material);
+  const Material& material(uint32_t index) const { return materials[index]; }
+
+  void submit(Pass pass, const DrawPacket& packet);
+  // sorts the packets of this frame by key
+  void sort();
+  // replays the sorted packets and clears the queue for the next frame
+  void execute(StateCache& state);
+  void clear();
+
+  size_t size() const { return packets.size(); }
+  const Stats& lastStats() const { return stats; }
+
+  static uint64_t makeKey(Pass pass, uint32_t program, uint32_t material, uint32_t vao, float depth);
+
+private:
+  // what the replay last bound; ~0 never matches, so the first packet sets everything
+  struct Bound {
+    uint32_t pass = ~0u;
+    uint32_t material = ~0u;
+    unsigned int program = ~0u;
+    unsigned int vao = ~0u;
+  };
+
+  void applyState(StateCache& state, Bound& bound, uint32_t pass, const DrawPacket& packet);
+  void executeBatched(StateCache& state);
+
+  // dense ids keep the key fields small however large the GL names get
+  uint32_t denseId(std::unordered_map<unsigned int, uint32_t>& ids, unsigned int name);
+
+  std::vector<Material> materials;
+  std::vector<uint32_t> materialProgramIds;
+  std::unordered_map<unsigned int, uint32_t> programIds;
+  std::unordered_map<unsigned int, uint32_t> vaoIds;
+
+  std::vector<DrawPacket> packets;
+  std::vector<uint64_t> keys;
+  // sort permutation and the scratch buffers of the radix passes
+  std::vector<uint32_t> order;
+  std::vector<uint64_t> keyScratch;
+  std::vector<uint32_t> orderScratch;
+  bool sorted = true;
+
+  bool batched = false;
+  StreamBuffer* stream = nullptr;
+  unsigned int indirectBuffer = 0;
+  unsigned int drawDataBuffer = 0;
+  std::vector<uint32_t> commands;
+  std::vector<std::array<float, 4>> drawData;
+
+  Stats stats;
+};
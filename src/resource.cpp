@@ -0,0 +1,311 @@
+#include "resource.h"
+#include "vertex_layout.h"
+#include <algorithm>
+#include <utility>
+#include <glad/glad.h>
+
+namespace {
+  bool dsaEnabled = true;
+
+  // binds a VAO for editing and restores the previous VAO and array buffer afterwards
+  class ScopedVertexArrayEdit {
+  public:
+    explicit ScopedVertexArrayEdit(unsigned int vao) {
+      glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVao);
+      glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousArrayBuffer);
+      glBindVertexArray(vao);
+    }
+    ~ScopedVertexArrayEdit() {
+      glBindVertexArray(previousVao);
+      glBindBuffer(GL_ARRAY_BUFFER, previousArrayBuffer);
+    }
+
+  private:
+    GLint previousVao = 0;
+    GLint previousArrayBuffer = 0;
+  };
+
+  // binds a buffer to GL_COPY_READ_BUFFER or GL_COPY_WRITE_BUFFER for editing and restores the previous
+  // binding afterwards, the StateCache shadows both
+  class ScopedBufferEdit {
+  public:
+    ScopedBufferEdit(GLenum target, unsigned int buffer) : target(target) {
+      glGetIntegerv(target == GL_COPY_READ_BUFFER ? GL_COPY_READ_BUFFER_BINDING : GL_COPY_WRITE_BUFFER_BINDING, &previous);
+      glBindBuffer(target, buffer);
+    }
+    ~ScopedBufferEdit() {
+      glBindBuffer(target, previous);
+    }
+
+  private:
+    GLenum target;
+    GLint previous = 0;
+  };
+}
+
+bool directStateAccess() {
+  return dsaEnabled && (GLAD_GL_VERSION_4_5 || GLAD_GL_ARB_direct_state_access);
+}
+
+void setDirectStateAccess(bool enabled) {
+  dsaEnabled = enabled;
+}
+
+bool immutableBufferStorage() {
+  return GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+}
+
+// buffer
+// -----------------------------------
+Buffer::Buffer(size_t size, const void* data, unsigned int storageFlags) : byteSize(size), dsa(directStateAccess()) {
+  if (dsa) {
+    glCreateBuffers(1, &name);
+    glNamedBufferStorage(name, size, data, storageFlags);
+    return;
+  }
+  glGenBuffers(1, &name);
+  ScopedBufferEdit edit(GL_COPY_WRITE_BUFFER, name);
+  if (immutableBufferStorage()) {
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, data, storageFlags);
+  } else {
+    bool dynamic = storageFlags & (GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+  }
+}
+
+Buffer::~Buffer() {
+  release();
+}
+
+Buffer::Buffer(Buffer&& other) noexcept : name(std::exchange(other.name, 0)), byteSize(std::exchange(other.byteSize, 0)), dsa(other.dsa) {}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+  if (this != &other) {
+    release();
+    name = std::exchange(other.name, 0);
+    byteSize = std::exchange(other.byteSize, 0);
+    dsa = other.dsa;
+  }
+  return *this;
+}
+
+void Buffer::release() {
+  if (name)
+    glDeleteBuffers(1, &name);
+  name = 0;
+  byteSize = 0;
+}
+
+void Buffer::upload(size_t offset, size_t size, const void* data) {
+  if (dsa) {
+    glNamedBufferSubData(name, offset, size, data);
+    return;
+  }
+  ScopedBufferEdit edit(GL_COPY_WRITE_BUFFER, name);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+void Buffer::copyTo(Buffer& destination, size_t sourceOffset, size_t destinationOffset, size_t size) const {
+  if (dsa && destination.dsa) {
+    glCopyNamedBufferSubData(name, destination.name, sourceOffset, destinationOffset, size);
+    return;
+  }
+  ScopedBufferEdit read(GL_COPY_READ_BUFFER, name);
+  ScopedBufferEdit write(GL_COPY_WRITE_BUFFER, destination.name);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, destinationOffset, size);
+}
+
+void* Buffer::map(size_t offset, size_t length, unsigned int access) {
+  if ((access & GL_MAP_PERSISTENT_BIT) && !immutableBufferStorage())
+    return nullptr;
+  if (dsa)
+    return glMapNamedBufferRange(name, offset, length, access);
+  ScopedBufferEdit edit(GL_COPY_WRITE_BUFFER, name);
+  return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length, access);
+}
+
+void Buffer::unmap() {
+  if (dsa) {
+    glUnmapNamedBuffer(name);
+    return;
+  }
+  ScopedBufferEdit edit(GL_COPY_WRITE_BUFFER, name);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+// vertexArray
+// -----------------------------------
+VertexArray::VertexArray() : dsa(directStateAccess()) {
+  if (dsa)
+    glCreateVertexArrays(1, &name);
+  else
+    glGenVertexArrays(1, &name);
+}
+
+VertexArray::~VertexArray() {
+  release();
+}
+
+VertexArray::VertexArray(VertexArray&& other) noexcept : name(std::exchange(other.name, 0)), dsa(other.dsa) {
+  for (unsigned int i = 0; i < MAX_ATTRIBUTES; i++) {
+    bindings[i] = other.bindings[i];
+    attributes[i] = other.attributes[i];
+  }
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) noexcept {
+  if (this != &other) {
+    release();
+    name = std::exchange(other.name, 0);
+    dsa = other.dsa;
+    for (unsigned int i = 0; i < MAX_ATTRIBUTES; i++) {
+      bindings[i] = other.bindings[i];
+      attributes[i] = other.attributes[i];
+    }
+  }
+  return *this;
+}
+
+void VertexArray::release() {
+  if (name)
+    glDeleteVertexArrays(1, &name);
+  name = 0;
+}
+
+void VertexArray::setVertexBuffer(unsigned int binding, const Buffer& buffer, intptr_t offset, int stride, unsigned int divisor) {
+  if (binding >= MAX_ATTRIBUTES)
+    return;
+  if (dsa) {
+    glVertexArrayVertexBuffer(name, binding, buffer.id(), offset, stride);
+    glVertexArrayBindingDivisor(name, binding, divisor);
+    return;
+  }
+  bindings[binding] = {buffer.id(), offset, stride, divisor};
+  applyBinding(binding);
+}
+
+void VertexArray::setAttribute(unsigned int attribute, unsigned int binding, int components, unsigned int type, bool normalized, unsigned int relativeOffset) {
+  if (attribute >= MAX_ATTRIBUTES || binding >= MAX_ATTRIBUTES)
+    return;
+  if (dsa) {
+    glEnableVertexArrayAttrib(name, attribute);
+    glVertexArrayAttribFormat(name, attribute, components, type, normalized ? GL_TRUE : GL_FALSE, relativeOffset);
+    glVertexArrayAttribBinding(name, attribute, binding);
+    return;
+  }
+  attributes[attribute] = {true, binding, components, type, normalized, relativeOffset};
+  applyBinding(binding);
+}
+
+void VertexArray::setAttributes(unsigned int binding, const VertexLayout& layout) {
+  for (auto& attribute : layout.attributes)
+    setAttribute(attribute.index, binding, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+}
+
+void VertexArray::setIndexBuffer(const Buffer& buffer) {
+  if (dsa) {
+    glVertexArrayElementBuffer(name, buffer.id());
+    return;
+  }
+  ScopedVertexArrayEdit edit(name);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id());
+}
+
+void VertexArray::applyBinding(unsigned int binding) {
+  // the separate format/binding model doesn't exist before 4.3: an attribute is a pointer into the
+  // buffer bound to GL_ARRAY_BUFFER, so it can only be set once both halves are known
+  const Binding& source = bindings[binding];
+  if (source.buffer == 0)
+    return;
+  ScopedVertexArrayEdit edit(name);
+  glBindBuffer(GL_ARRAY_BUFFER, source.buffer);
+  for (unsigned int i = 0; i < MAX_ATTRIBUTES; i++) {
+    const Attribute& attribute = attributes[i];
+    if (!attribute.enabled || attribute.binding != binding)
+      continue;
+    glVertexAttribPointer(i, attribute.components, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE, source.stride,
+                          reinterpret_cast<void*>(source.offset + attribute.relativeOffset));
+    glVertexAttribDivisor(i, source.divisor);
+    glEnableVertexAttribArray(i);
+  }
+}
+
+// bufferTexture
+// -----------------------------------
+BufferTexture::BufferTexture(const Buffer& buffer, unsigned int internalFormat) {
+  if (directStateAccess()) {
+    glCreateTextures(GL_TEXTURE_BUFFER, 1, &name);
+    glTextureBuffer(name, internalFormat, buffer.id());
+    return;
+  }
+  GLint previous = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_BUFFER, &previous);
+  glGenTextures(1, &name);
+  glBindTexture(GL_TEXTURE_BUFFER, name);
+  glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer.id());
+  glBindTexture(GL_TEXTURE_BUFFER, previous);
+}
+
+BufferTexture::~BufferTexture() {
+  release();
+}
+
+BufferTexture::BufferTexture(BufferTexture&& other) noexcept : name(std::exchange(other.name, 0)) {}
+
+BufferTexture& BufferTexture::operator=(BufferTexture&& other) noexcept {
+  if (this != &other) {
+    release();
+    name = std::exchange(other.name, 0);
+  }
+  return *this;
+}
+
+void BufferTexture::release() {
+  if (name)
+    glDeleteTextures(1, &name);
+  name = 0;
+}
+
+Texture::Texture(int width, int height, const void* texels) : size{width, height} {
+  int levels = 1;
+  while ((std::max(width, height) >> levels) > 0)
+    levels++;
+  if (directStateAccess()) {
+    glCreateTextures(GL_TEXTURE_2D, 1, &name);
+    glTextureStorage2D(name, levels, GL_RGBA8, width, height);
+    glTextureSubImage2D(name, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    glGenerateTextureMipmap(name);
+    glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    return;
+  }
+  GLint previous = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+  glGenTextures(1, &name);
+  glBindTexture(GL_TEXTURE_2D, name);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, previous);
+}
+
+Texture::~Texture() {
+  release();
+}
+
+Texture::Texture(Texture&& other) noexcept : name(std::exchange(other.name, 0)), size{other.size[0], other.size[1]} {}
+
+Texture& Texture::operator=(Texture&& other) noexcept {
+  if (this != &other) {
+    release();
+    name = std::exchange(other.name, 0);
+    size[0] = other.size[0];
+    size[1] = other.size[1];
+  }
+  return *this;
+}
+
+void Texture::release() {
+  if (name)
+    glDeleteTextures(1, &name);
+  name = 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// resource: RAII wrappers for GL buffers, vertex arrays, buffer textures and 2D textures that edit objects without binding them.
+//  - GL 4.5 / ARB_direct_state_access: glCreate*, glNamedBuffer*, glVertexArray* calls on the object name
+//  - otherwise (the 4.1 core path on macOS): buffers are edited through GL_COPY_READ_BUFFER and
+//    GL_COPY_WRITE_BUFFER and vertex arrays are bound briefly, the previous bindings are restored.
+//    attribute formats and vertex buffer bindings are recorded and applied with glVertexAttribPointer.
+//    buffer textures and 2D textures are bound to their target of the active unit briefly and restored.
+// either way creating and updating resources leaves the render state (and the StateCache) alone.
+// -----------------------------------
+
+struct VertexLayout;
+
+// true when the DSA path is in use
+bool directStateAccess();
+// disable DSA even where it is available, e.g. to exercise the fallback; objects keep the path they
+// were created with
+void setDirectStateAccess(bool enabled);
+// immutable buffer storage (GL 4.4 / ARB_buffer_storage), required for persistent mappings
+bool immutableBufferStorage();
+
+class Buffer {
+public:
+  Buffer() = default;
+  // storageFlags are glBufferStorage flags (GL_DYNAMIC_STORAGE_BIT, GL_MAP_*_BIT); without immutable
+  // storage they pick a glBufferData usage instead
+  Buffer(size_t size, const void* data, unsigned int storageFlags);
+  ~Buffer();
+  Buffer(Buffer&& other) noexcept;
+  Buffer& operator=(Buffer&& other) noexcept;
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+
+  void upload(size_t offset, size_t size, const void* data);
+  void copyTo(Buffer& destination, size_t sourceOffset, size_t destinationOffset, size_t size) const;
+  // nullptr if the mapping failed (or a persistent mapping was asked for without immutable storage)
+  void* map(size_t offset, size_t length, unsigned int access);
+  void unmap();
+
+  unsigned int id() const { return name; }
+  size_t size() const { return byteSize; }
+  explicit operator bool() const { return name != 0; }
+
+private:
+  void release();
+
+  unsigned int name = 0;
+  size_t byteSize = 0;
+  bool dsa = false;
+};
+
+class VertexArray {
+public:
+  static constexpr unsigned int MAX_ATTRIBUTES = 16;
+
+  VertexArray();
+  ~VertexArray();
+  VertexArray(VertexArray&& other) noexcept;
+  VertexArray& operator=(VertexArray&& other) noexcept;
+  VertexArray(const VertexArray&) = delete;
+  VertexArray& operator=(const VertexArray&) = delete;
+
+  // vertex buffer binding point: buffer, byte offset of the first vertex and stride
+  void setVertexBuffer(unsigned int binding, const Buffer& buffer, intptr_t offset, int stride, unsigned int divisor = 0);
+  // float attributes (normalized or converted), relativeOffset is the offset inside the vertex
+  void setAttribute(unsigned int attribute, unsigned int binding, int components, unsigned int type, bool normalized, unsigned int relativeOffset);
+  // every attribute of a layout, reading from one binding
+  void setAttributes(unsigned int binding, const VertexLayout& layout);
+  void setIndexBuffer(const Buffer& buffer);
+
+  unsigned int id() const { return name; }
+
+private:
+  struct Binding {
+    unsigned int buffer = 0;
+    intptr_t offset = 0;
+    int stride = 0;
+    unsigned int divisor = 0;
+  };
+  struct Attribute {
+    bool enabled = false;
+    unsigned int binding = 0;
+    int components = 4;
+    unsigned int type = 0;
+    bool normalized = false;
+    unsigned int relativeOffset = 0;
+  };
+
+  void release();
+  // fallback: (re)applies every enabled attribute that reads from this binding
+  void applyBinding(unsigned int binding);
+
+  unsigned int name = 0;
+  bool dsa = false;
+  Binding bindings[MAX_ATTRIBUTES];
+  Attribute attributes[MAX_ATTRIBUTES];
+};
+
+// buffer texture: a Buffer read as an array of texels through texelFetch on a samplerBuffer (GL 3.1),
+// the buffer has to outlive the texture
+class BufferTexture {
+public:
+  BufferTexture() = default;
+  BufferTexture(const Buffer& buffer, unsigned int internalFormat);
+  ~BufferTexture();
+  BufferTexture(BufferTexture&& other) noexcept;
+  BufferTexture& operator=(BufferTexture&& other) noexcept;
+  BufferTexture(const BufferTexture&) = delete;
+  BufferTexture& operator=(const BufferTexture&) = delete;
+
+  unsigned int id() const { return name; }
+  explicit operator bool() const { return name != 0; }
+
+private:
+  void release();
+
+  unsigned int name = 0;
+};
+
+// 2D texture: RGBA8 with a full mip chain, immutable storage on the DSA path (glTextureStorage2D),
+// glTexImage2D and glGenerateMipmap without it
+class Texture {
+public:
+  Texture() = default;
+  // texels: width * height RGBA8, rows tightly packed bottom row first
+  Texture(int width, int height, const void* texels);
+  ~Texture();
+  Texture(Texture&& other) noexcept;
+  Texture& operator=(Texture&& other) noexcept;
+  Texture(const Texture&) = delete;
+  Texture& operator=(const Texture&) = delete;
+
+  unsigned int id() const { return name; }
+  int width() const { return size[0]; }
+  int height() const { return size[1]; }
+  explicit operator bool() const { return name != 0; }
+
+private:
+  void release();
+
+  unsigned int name = 0;
+  int size[2] = {0, 0};
+};
@@ -0,0 +1,79 @@
+#include "shader.h"
+#include <iostream>
+#include <fstream>
+#include <glad/glad.h>
+
+std::string readShaderFile(const std::string& fileName) {
+  // binary and sized up front: one read instead of a character at a time through the stream buffer
+  std::ifstream shaderFile(SHADER_PATH+fileName, std::ios::binary | std::ios::ate);
+  if (!shaderFile.is_open()) {
+    std::cout << "ERROR::SHADER::FILE_NOT_FOUND " << fileName << std::endl;
+    return {};
+  }
+  std::string source(static_cast<size_t>(shaderFile.tellg()), '\0');
+  shaderFile.seekg(0);
+  if (!shaderFile.read(source.data(), static_cast<std::streamsize>(source.size()))) {
+    std::cout << "ERROR::SHADER::FILE_NOT_READ " << fileName << std::endl;
+    return {};
+  }
+  return source;
+}
+
+std::string applyShaderDefines(const std::string& shaderCode, const std::vector<std::string>& defines) {
+  if (defines.empty())
+    return shaderCode;
+  // "#version" has to stay the first statement, so the defines go right behind it
+  size_t insertPos = 0;
+  if (shaderCode.compare(0, 8, "#version") == 0) {
+    insertPos = shaderCode.find('\n');
+    insertPos = insertPos == std::string::npos ? shaderCode.size() : insertPos + 1;
+  }
+  std::string defineBlock;
+  for (auto& define : defines)
+    defineBlock += "#define " + define + "\n";
+  // keep the line numbers of compile errors in sync with the file
+  defineBlock += "#line " + std::to_string(insertPos == 0 ? 1 : 2) + "\n";
+  std::string result = shaderCode;
+  result.insert(insertPos, defineBlock);
+  return result;
+}
+
+unsigned int compileShaderSource(const std::string& shaderCode, unsigned int shaderType) {
+  const char *shaderCode_c_str = shaderCode.c_str();
+  unsigned int shader = glCreateShader(shaderType);
+  glShaderSource(shader, 1, &shaderCode_c_str, NULL);
+  glCompileShader(shader);
+  // check for shader compile errors
+  int success;
+  char infoLog[512];
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success)
+  {
+      glGetShaderInfoLog(shader, 512, NULL, infoLog);
+      std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+  }
+  return shader;
+}
+
+unsigned int createShader(std::string fileName, unsigned int shaderType, const std::vector<std::string>& defines) {
+  return compileShaderSource(applyShaderDefines(readShaderFile(fileName), defines), shaderType);
+}
+
+unsigned int createShaderProgram(std::vector<unsigned int> shaders, bool binaryRetrievable) {
+  unsigned int shaderProgram = glCreateProgram();
+  for (auto& shader : shaders) {
+    glAttachShader(shaderProgram, shader);
+  }
+  if (binaryRetrievable)
+    glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(shaderProgram);
+  // check for linking errors
+  int success;
+  char infoLog[512];
+  glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+  if (!success) {
+    glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+  }
+  return shaderProgram;
+}
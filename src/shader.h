@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// shader: read shaderfile from SHADER_PATH
+// -----------------------------------
+std::string readShaderFile(const std::string& fileName);
+
+// shader: insert "#define" lines right after the "#version" directive
+// -----------------------------------
+std::string applyShaderDefines(const std::string& shaderCode, const std::vector<std::string>& defines);
+
+// shader: compile shader source and print the info log on failure
+// -----------------------------------
+unsigned int compileShaderSource(const std::string& shaderCode, unsigned int shaderType);
+
+// shader: read and compile shaderfile
+// -----------------------------------
+unsigned int createShader(std::string fileName, unsigned int shaderType, const std::vector<std::string>& defines = {});
+
+// shaderProgram: link list of shaders and create shaderProgram
+// binaryRetrievable sets GL_PROGRAM_BINARY_RETRIEVABLE_HINT before linking (needed by the program binary cache)
+// -----------------------------------
+unsigned int createShaderProgram(std::vector<unsigned int> shaders, bool binaryRetrievable = false);
@@ -0,0 +1,94 @@
+#include "startup_profiler.h"
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+StartupProfiler::StartupProfiler() : origin(Clock::now()) {
+  setInfo("build", __DATE__ " " __TIME__);
+#ifdef NDEBUG
+  setInfo("build_type", "release");
+#else
+  setInfo("build_type", "debug");
+#endif
+}
+
+void StartupProfiler::begin(const std::string& name) {
+  openPhases.push_back(phases.size());
+  phases.push_back({name, Clock::now(), Clock::time_point{}, static_cast<int>(openPhases.size()) - 1});
+}
+
+void StartupProfiler::end() {
+  if (openPhases.empty())
+    return;
+  phases[openPhases.back()].stop = Clock::now();
+  openPhases.pop_back();
+}
+
+void StartupProfiler::addPhase(const std::string& name, Clock::time_point start, Clock::time_point stop) {
+  phases.push_back({name, start, stop, static_cast<int>(openPhases.size())});
+}
+
+void StartupProfiler::setInfo(const std::string& key, const std::string& value) {
+  for (auto& entry : info) {
+    if (entry.first == key) {
+      entry.second = value;
+      return;
+    }
+  }
+  info.emplace_back(key, value);
+}
+
+double StartupProfiler::toMs(Clock::time_point time) const {
+  return std::chrono::duration<double, std::milli>(time - origin).count();
+}
+
+double StartupProfiler::elapsedMs() const {
+  return toMs(Clock::now());
+}
+
+void StartupProfiler::printBreakdown() const {
+  char line[160];
+  std::cout << "Startup breakdown:" << std::endl;
+  for (auto& phase : phases) {
+    double duration = toMs(phase.stop) - toMs(phase.start);
+    std::snprintf(line, sizeof(line), "  %*s%-*s %9.3f ms  (at %9.3f ms)", phase.depth * 2, "", 36 - phase.depth * 2,
+                  phase.name.c_str(), duration, toMs(phase.start));
+    std::cout << line << std::endl;
+  }
+  std::snprintf(line, sizeof(line), "  %-36s %9.3f ms", "total", elapsedMs());
+  std::cout << line << std::endl;
+}
+
+std::string StartupProfiler::toJson() const {
+  char buffer[96];
+  std::string json = "{\n  \"info\": {";
+  for (size_t i = 0; i < info.size(); i++)
+    json += (i ? ", " : "") + std::string("\"") + jsonEscape(info[i].first) + "\": \"" + jsonEscape(info[i].second) + "\"";
+  json += "},\n  \"phases\": [\n";
+  for (size_t i = 0; i < phases.size(); i++) {
+    std::snprintf(buffer, sizeof(buffer), "\"start_ms\": %.3f, \"duration_ms\": %.3f, \"depth\": %d",
+                  toMs(phases[i].start), toMs(phases[i].stop) - toMs(phases[i].start), phases[i].depth);
+    json += "    {\"name\": \"" + jsonEscape(phases[i].name) + "\", " + buffer + "}" + (i + 1 < phases.size() ? ",\n" : "\n");
+  }
+  std::snprintf(buffer, sizeof(buffer), "%.3f", elapsedMs());
+  json += "  ],\n  \"total_ms\": " + std::string(buffer) + "\n}\n";
+  return json;
+}
+
+bool StartupProfiler::writeJson(const std::string& path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    std::cout << "ERROR::STARTUP_PROFILER::CANNOT_WRITE " << path << std::endl;
+    return false;
+  }
+  file << toJson();
+  return file.good();
+}
+
+bool StartupProfiler::writeChromeTrace(const std::string& path) const {
+  std::vector<TraceEvent> events;
+  for (auto& phase : phases)
+    events.push_back({phase.name, "startup", toMs(phase.start) * 1000.0, (toMs(phase.stop) - toMs(phase.start)) * 1000.0, 0});
+  return ::writeChromeTrace(path, events, {{0, "main"}});
+}
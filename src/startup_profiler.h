@@ -0,0 +1,47 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+// startupProfiler: timestamps the startup phases (glfwInit, window, loader, shaders, buffers, first frame)
+// with a monotonic clock. the breakdown is printed to the console and can be written as JSON
+// (for tracking cold start per build and driver) and as a Chrome trace.
+// -----------------------------------
+class StartupProfiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  StartupProfiler();
+
+  // phases may nest; end() closes the innermost open phase
+  void begin(const std::string& name);
+  void end();
+  // phase whose start was taken earlier, e.g. work that completes asynchronously
+  void addPhase(const std::string& name, Clock::time_point start, Clock::time_point stop);
+  // key/value pairs reported with the phases (driver strings, build configuration)
+  void setInfo(const std::string& key, const std::string& value);
+
+  // milliseconds since the profiler was created
+  double elapsedMs() const;
+
+  void printBreakdown() const;
+  std::string toJson() const;
+  bool writeJson(const std::string& path) const;
+  bool writeChromeTrace(const std::string& path) const;
+
+private:
+  struct Phase {
+    std::string name;
+    Clock::time_point start;
+    Clock::time_point stop;
+    int depth;
+  };
+
+  double toMs(Clock::time_point time) const;
+
+  Clock::time_point origin;
+  std::vector<Phase> phases;
+  std::vector<size_t> openPhases;
+  std::vector<std::pair<std::string, std::string>> info;
+};
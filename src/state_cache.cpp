@@ -0,0 +1,265 @@
+#include "state_cache.h"
+#include <glad/glad.h>
+
+StateCache::StateCache() {
+  invalidate();
+}
+
+void StateCache::beginFrame() {
+  if (frameCount > 0)
+    previousFrame = frame;
+  totals.issued += frame.issued;
+  totals.skipped += frame.skipped;
+  frame = Counters();
+  frameCount++;
+}
+
+void StateCache::invalidate() {
+  program = UNKNOWN;
+  vertexArray = UNKNOWN;
+  buffers.fill(UNKNOWN);
+  for (auto& bindings : indexedBuffers)
+    bindings.fill({UNKNOWN, 0, 0});
+  activeTextureUnit = UNKNOWN;
+  for (auto& unit : textures)
+    unit.fill(UNKNOWN);
+  samplers.fill(UNKNOWN);
+  drawFramebuffer = UNKNOWN;
+  readFramebuffer = UNKNOWN;
+  capabilities.fill(-1);
+  blendFuncs.fill(UNKNOWN);
+  blendEquations.fill(UNKNOWN);
+  depthFunction = UNKNOWN;
+  depthWrite = -1;
+  viewportRect = {-1, -1, -1, -1};
+}
+
+int StateCache::bufferTargetIndex(unsigned int target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER: return ArrayBuffer;
+    case GL_ELEMENT_ARRAY_BUFFER: return ElementArrayBuffer;
+    case GL_UNIFORM_BUFFER: return UniformBuffer;
+    case GL_SHADER_STORAGE_BUFFER: return ShaderStorageBuffer;
+    case GL_DRAW_INDIRECT_BUFFER: return DrawIndirectBuffer;
+    case GL_COPY_READ_BUFFER: return CopyReadBuffer;
+    case GL_COPY_WRITE_BUFFER: return CopyWriteBuffer;
+    case GL_PIXEL_PACK_BUFFER: return PixelPackBuffer;
+    case GL_PIXEL_UNPACK_BUFFER: return PixelUnpackBuffer;
+    case GL_TEXTURE_BUFFER: return TextureBuffer;
+    default: return -1;
+  }
+}
+
+int StateCache::textureTargetIndex(unsigned int target) {
+  switch (target) {
+    case GL_TEXTURE_2D: return Texture2D;
+    case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+    case GL_TEXTURE_3D: return Texture3D;
+    case GL_TEXTURE_CUBE_MAP: return TextureCubeMap;
+    case GL_TEXTURE_BUFFER: return TextureBufferTarget;
+    case GL_TEXTURE_2D_MULTISAMPLE: return Texture2DMultisample;
+    default: return -1;
+  }
+}
+
+int StateCache::capabilityIndex(unsigned int capability) {
+  switch (capability) {
+    case GL_BLEND: return Blend;
+    case GL_DEPTH_TEST: return DepthTest;
+    case GL_CULL_FACE: return CullFace;
+    case GL_SCISSOR_TEST: return ScissorTest;
+    case GL_STENCIL_TEST: return StencilTest;
+    case GL_POLYGON_OFFSET_FILL: return PolygonOffsetFill;
+    default: return -1;
+  }
+}
+
+void StateCache::useProgram(unsigned int newProgram) {
+  if (changed(program != newProgram)) {
+    glUseProgram(newProgram);
+    program = newProgram;
+  }
+}
+
+void StateCache::bindVertexArray(unsigned int vao) {
+  if (changed(vertexArray != vao)) {
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    // the element buffer binding is part of the VAO
+    buffers[ElementArrayBuffer] = UNKNOWN;
+  }
+}
+
+void StateCache::bindBuffer(unsigned int target, unsigned int buffer) {
+  int index = bufferTargetIndex(target);
+  if (index < 0) {
+    changed(true);
+    glBindBuffer(target, buffer);
+    return;
+  }
+  if (changed(buffers[index] != buffer)) {
+    glBindBuffer(target, buffer);
+    buffers[index] = buffer;
+  }
+}
+
+void StateCache::bindBufferBase(unsigned int target, unsigned int index, unsigned int buffer) {
+  int slot = target == GL_UNIFORM_BUFFER ? 0 : target == GL_SHADER_STORAGE_BUFFER ? 1 : -1;
+  if (slot < 0 || index >= INDEXED_BINDINGS) {
+    changed(true);
+    glBindBufferBase(target, index, buffer);
+    return;
+  }
+  // offset and size 0 stand for the whole buffer
+  IndexedBinding& binding = indexedBuffers[slot][index];
+  if (changed(binding.buffer != buffer || binding.offset != 0 || binding.size != 0)) {
+    glBindBufferBase(target, index, buffer);
+    binding = {buffer, 0, 0};
+    // binding an indexed target binds the generic target as well
+    buffers[bufferTargetIndex(target)] = buffer;
+  }
+}
+
+void StateCache::bindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, intptr_t offset, intptr_t size) {
+  int slot = target == GL_UNIFORM_BUFFER ? 0 : target == GL_SHADER_STORAGE_BUFFER ? 1 : -1;
+  if (slot < 0 || index >= INDEXED_BINDINGS) {
+    changed(true);
+    glBindBufferRange(target, index, buffer, offset, size);
+    return;
+  }
+  IndexedBinding& binding = indexedBuffers[slot][index];
+  if (changed(binding.buffer != buffer || binding.offset != offset || binding.size != size)) {
+    glBindBufferRange(target, index, buffer, offset, size);
+    binding = {buffer, offset, size};
+    buffers[bufferTargetIndex(target)] = buffer;
+  }
+}
+
+void StateCache::bindTexture(unsigned int unit, unsigned int target, unsigned int texture) {
+  int index = textureTargetIndex(target);
+  if (index < 0 || unit >= TEXTURE_UNITS) {
+    changed(true);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+    activeTextureUnit = unit;
+    return;
+  }
+  if (!changed(textures[unit][index] != texture))
+    return;
+  // switching the active unit only counts as part of the bind
+  if (activeTextureUnit != unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeTextureUnit = unit;
+  }
+  glBindTexture(target, texture);
+  textures[unit][index] = texture;
+}
+
+void StateCache::bindSampler(unsigned int unit, unsigned int sampler) {
+  if (unit >= TEXTURE_UNITS) {
+    changed(true);
+    glBindSampler(unit, sampler);
+    return;
+  }
+  if (changed(samplers[unit] != sampler)) {
+    glBindSampler(unit, sampler);
+    samplers[unit] = sampler;
+  }
+}
+
+void StateCache::bindFramebuffer(unsigned int target, unsigned int framebuffer) {
+  bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+  bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+  if (changed((draw && drawFramebuffer != framebuffer) || (read && readFramebuffer != framebuffer))) {
+    glBindFramebuffer(target, framebuffer);
+    if (draw)
+      drawFramebuffer = framebuffer;
+    if (read)
+      readFramebuffer = framebuffer;
+  }
+}
+
+void StateCache::setEnabled(unsigned int capability, bool enabled) {
+  int index = capabilityIndex(capability);
+  if (!changed(index < 0 || capabilities[index] != static_cast<int>(enabled)))
+    return;
+  if (enabled)
+    glEnable(capability);
+  else
+    glDisable(capability);
+  if (index >= 0)
+    capabilities[index] = enabled;
+}
+
+void StateCache::blendFunc(unsigned int srcRGB, unsigned int dstRGB, unsigned int srcAlpha, unsigned int dstAlpha) {
+  std::array<unsigned int, 4> funcs = {srcRGB, dstRGB, srcAlpha, dstAlpha};
+  if (changed(blendFuncs != funcs)) {
+    glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+    blendFuncs = funcs;
+  }
+}
+
+void StateCache::blendEquation(unsigned int modeRGB, unsigned int modeAlpha) {
+  std::array<unsigned int, 2> modes = {modeRGB, modeAlpha};
+  if (changed(blendEquations != modes)) {
+    glBlendEquationSeparate(modeRGB, modeAlpha);
+    blendEquations = modes;
+  }
+}
+
+void StateCache::depthFunc(unsigned int func) {
+  if (changed(depthFunction != func)) {
+    glDepthFunc(func);
+    depthFunction = func;
+  }
+}
+
+void StateCache::depthMask(bool write) {
+  if (changed(depthWrite != static_cast<int>(write))) {
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    depthWrite = write;
+  }
+}
+
+void StateCache::viewport(int x, int y, int width, int height) {
+  std::array<int, 4> rect = {x, y, width, height};
+  if (changed(viewportRect != rect)) {
+    glViewport(x, y, width, height);
+    viewportRect = rect;
+  }
+}
+
+void StateCache::forgetProgram(unsigned int deleted) {
+  if (program == deleted)
+    program = UNKNOWN;
+}
+
+void StateCache::forgetVertexArray(unsigned int deleted) {
+  if (vertexArray == deleted) {
+    vertexArray = UNKNOWN;
+    buffers[ElementArrayBuffer] = UNKNOWN;
+  }
+}
+
+void StateCache::forgetBuffer(unsigned int deleted) {
+  for (auto& buffer : buffers)
+    if (buffer == deleted)
+      buffer = UNKNOWN;
+  for (auto& bindings : indexedBuffers)
+    for (auto& binding : bindings)
+      if (binding.buffer == deleted)
+        binding.buffer = UNKNOWN;
+}
+
+void StateCache::forgetTexture(unsigned int deleted) {
+  for (auto& unit : textures)
+    for (auto& texture : unit)
+      if (texture == deleted)
+        texture = UNKNOWN;
+}
+
+void StateCache::forgetSampler(unsigned int deleted) {
+  for (auto& sampler : samplers)
+    if (sampler == deleted)
+      sampler = UNKNOWN;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// stateCache: shadows the GL binding and fixed-function state the renderer touches (program, VAO,
+// buffer targets and indexed buffer bindings, textures per unit, samplers, blend, depth, capabilities,
+// viewport) and drops calls that would not change anything. issued and skipped calls are counted per
+// frame. all state starts out unknown, so the first call always reaches GL.
+// code that changes GL state behind the cache's back has to restore it or call invalidate().
+// -----------------------------------
+class StateCache {
+public:
+  struct Counters {
+    unsigned long long issued = 0;
+    unsigned long long skipped = 0;
+  };
+
+  StateCache();
+
+  // frame boundaries for the per-frame counters
+  void beginFrame();
+  const Counters& currentFrame() const { return frame; }
+  const Counters& lastFrame() const { return previousFrame; }
+  const Counters& total() const { return totals; }
+  unsigned long long frames() const { return frameCount; }
+
+  void useProgram(unsigned int program);
+  void bindVertexArray(unsigned int vao);
+  void bindBuffer(unsigned int target, unsigned int buffer);
+  void bindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+  void bindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, intptr_t offset, intptr_t size);
+  void bindTexture(unsigned int unit, unsigned int target, unsigned int texture);
+  void bindSampler(unsigned int unit, unsigned int sampler);
+  void bindFramebuffer(unsigned int target, unsigned int framebuffer);
+
+  void setEnabled(unsigned int capability, bool enabled);
+  void blendFunc(unsigned int srcRGB, unsigned int dstRGB, unsigned int srcAlpha, unsigned int dstAlpha);
+  void blendFunc(unsigned int src, unsigned int dst) { blendFunc(src, dst, src, dst); }
+  void blendEquation(unsigned int modeRGB, unsigned int modeAlpha);
+  void blendEquation(unsigned int mode) { blendEquation(mode, mode); }
+  void depthFunc(unsigned int func);
+  void depthMask(bool write);
+  void viewport(int x, int y, int width, int height);
+
+  // forget everything, e.g. after third party code touched the context
+  void invalidate();
+  // a deleted object is unbound by GL, a new object may reuse its name
+  void forgetProgram(unsigned int program);
+  void forgetVertexArray(unsigned int vao);
+  void forgetBuffer(unsigned int buffer);
+  void forgetTexture(unsigned int texture);
+  void forgetSampler(unsigned int sampler);
+
+  static constexpr unsigned int TEXTURE_UNITS = 32;
+  static constexpr unsigned int INDEXED_BINDINGS = 16;
+
+private:
+  // the cache is a shadow of what GL holds; UNKNOWN never matches a real value
+  static constexpr unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+  enum BufferTarget { ArrayBuffer, ElementArrayBuffer, UniformBuffer, ShaderStorageBuffer, DrawIndirectBuffer,
+                      CopyReadBuffer, CopyWriteBuffer, PixelPackBuffer, PixelUnpackBuffer, TextureBuffer, BufferTargetCount };
+  enum TextureTarget { Texture2D, Texture2DArray, Texture3D, TextureCubeMap, TextureBufferTarget, Texture2DMultisample,
+                       TextureTargetCount };
+  enum Capability { Blend, DepthTest, CullFace, ScissorTest, StencilTest, PolygonOffsetFill, CapabilityCount };
+
+  struct IndexedBinding {
+    unsigned int buffer;
+    intptr_t offset;
+    intptr_t size;
+  };
+
+  static int bufferTargetIndex(unsigned int target);
+  static int textureTargetIndex(unsigned int target);
+  static int capabilityIndex(unsigned int capability);
+  // counts the call and reports whether it has to reach GL
+  bool changed(bool differs) {
+    if (differs)
+      frame.issued++;
+    else
+      frame.skipped++;
+    return differs;
+  }
+
+  unsigned int program;
+  unsigned int vertexArray;
+  std::array<unsigned int, BufferTargetCount> buffers;
+  std::array<std::array<IndexedBinding, INDEXED_BINDINGS>, 2> indexedBuffers;
+  unsigned int activeTextureUnit;
+  std::array<std::array<unsigned int, TextureTargetCount>, TEXTURE_UNITS> textures;
+  std::array<unsigned int, TEXTURE_UNITS> samplers;
+  unsigned int drawFramebuffer;
+  unsigned int readFramebuffer;
+  std::array<int, CapabilityCount> capabilities;
+  std::array<unsigned int, 4> blendFuncs;
+  std::array<unsigned int, 2> blendEquations;
+  unsigned int depthFunction;
+  int depthWrite;
+  std::array<int, 4> viewportRect;
+
+  Counters frame;
+  Counters previousFrame;
+  Counters totals;
+  unsigned long long frameCount = 0;
+};
@@ -0,0 +1,82 @@
+#include "stream_buffer.h"
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+
+StreamBuffer::StreamBuffer(size_t bytesPerFrame) {
+  GLint uniformAlignment = 256, storageAlignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+  if (GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_shader_storage_buffer_object)
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+  defaultAlignment = static_cast<size_t>(std::max({uniformAlignment, storageAlignment, 16}));
+  partitionSize = (bytesPerFrame + defaultAlignment - 1) / defaultAlignment * defaultAlignment;
+  size_t totalSize = partitionSize * FRAMES_IN_FLIGHT;
+
+  if (immutableBufferStorage()) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    bufferObject = Buffer(totalSize, nullptr, flags);
+    mapped = static_cast<uint8_t*>(bufferObject.map(0, totalSize, flags));
+    if (!mapped)
+      std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED falling back to uploads" << std::endl;
+  }
+  if (!mapped) {
+    // a buffer with immutable storage can't be respecified, start over with a dynamic one
+    bufferObject = Buffer(totalSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    staging.resize(partitionSize);
+  }
+}
+
+StreamBuffer::~StreamBuffer() {
+  for (auto& fence : fences)
+    if (fence)
+      glDeleteSync(static_cast<GLsync>(fence));
+  if (mapped)
+    bufferObject.unmap();
+}
+
+void StreamBuffer::beginFrame() {
+  GLsync fence = static_cast<GLsync>(fences[partition]);
+  if (fence) {
+    // zero timeout first: with FRAMES_IN_FLIGHT partitions the fence has normally signaled long ago
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+      stallCount++;
+      do {
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+      } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fences[partition] = nullptr;
+  }
+  head = 0;
+  flushed = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t size, size_t alignment) {
+  if (alignment == 0)
+    alignment = defaultAlignment;
+  size_t start = (head + alignment - 1) / alignment * alignment;
+  Allocation allocation;
+  if (start + size > partitionSize)
+    return allocation;
+  head = start + size;
+  allocation.offset = static_cast<intptr_t>(partition * partitionSize + start);
+  allocation.size = size;
+  allocation.data = mapped ? mapped + allocation.offset : staging.data() + start;
+  return allocation;
+}
+
+void StreamBuffer::flush() {
+  // coherent persistent mappings need nothing, writes are visible to commands issued afterwards
+  if (mapped || head == flushed)
+    return;
+  // the fence guarantees the GPU is done with this range, so the upload doesn't wait on it
+  bufferObject.upload(partition * partitionSize + flushed, head - flushed, staging.data() + flushed);
+  flushed = head;
+}
+
+void StreamBuffer::endFrame() {
+  flush();
+  fences[partition] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  partition = (partition + 1) % FRAMES_IN_FLIGHT;
+}
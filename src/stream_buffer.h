@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "resource.h"
+
+// streamBuffer: ring buffer for per-frame dynamic data (uniforms, instance data, indirect commands,
+// dynamic vertices). the buffer is split into one partition per frame in flight; a fence guards each
+// partition, so the CPU only writes memory the GPU is done with and the driver never has to sync.
+//  - GL 4.4 / ARB_buffer_storage: immutable storage mapped once with GL_MAP_PERSISTENT_BIT |
+//    GL_MAP_COHERENT_BIT, allocations are written in place, no map/unmap while streaming
+//  - otherwise (the 4.1 core path on macOS): allocations go to CPU staging memory and flush()
+//    uploads the written range with Buffer::upload
+// -----------------------------------
+class StreamBuffer {
+public:
+  static constexpr unsigned int FRAMES_IN_FLIGHT = 3;
+
+  struct Allocation {
+    void* data = nullptr;   // nullptr when the partition is full
+    intptr_t offset = 0;    // offset into buffer() for binding / drawing
+    size_t size = 0;
+  };
+
+  explicit StreamBuffer(size_t bytesPerFrame);
+  ~StreamBuffer();
+  StreamBuffer(const StreamBuffer&) = delete;
+  StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+  // waits for the GPU to release this frame's partition (normally it already has)
+  void beginFrame();
+  // alignment 0 uses the larger of the uniform/storage buffer offset alignments
+  Allocation allocate(size_t size, size_t alignment = 0);
+  // makes everything allocated so far visible to GL; free in the persistent path
+  void flush();
+  // fences the partition of this frame
+  void endFrame();
+
+  unsigned int buffer() const { return bufferObject.id(); }
+  const Buffer& storage() const { return bufferObject; }
+  bool persistent() const { return mapped != nullptr; }
+  size_t capacityPerFrame() const { return partitionSize; }
+  size_t usedThisFrame() const { return head; }
+  // frames whose partition was still in use by the GPU when beginFrame came around
+  unsigned long long stalls() const { return stallCount; }
+
+private:
+  size_t partitionSize;
+  size_t defaultAlignment;
+  Buffer bufferObject;
+  uint8_t* mapped = nullptr;
+  std::vector<uint8_t> staging;
+  void* fences[FRAMES_IN_FLIGHT] = {};
+  unsigned int partition = 0;
+  size_t head = 0;
+  size_t flushed = 0;
+  unsigned long long stallCount = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// task: a C++20 coroutine that produces one T. it is lazy, nothing runs until it is awaited or started:
+//  - co_await task from another coroutine runs it and resumes the awaiting one when it returns, on
+//    whatever thread it finished on (symmetric transfer, no stack grows across chains of awaits)
+//  - start() runs a top level task on the calling thread up to its first suspension; done() turns
+//    true once it returned, from any thread, and result() hands the value out
+// where a task runs is up to what it awaits, see AssetLoader. an exception escaping a task terminates.
+// a started task has to be done before it is destroyed, its frame may be queued on another thread.
+// -----------------------------------
+template <typename T>
+class Task {
+public:
+  struct promise_type {
+    std::optional<T> value;
+    std::coroutine_handle<> continuation;
+    std::atomic<bool> finished{false};
+
+    Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+        promise_type& promise = handle.promise();
+        // read before finished is set, the owner may destroy the frame right after
+        std::coroutine_handle<> next = promise.continuation ? promise.continuation : std::noop_coroutine();
+        promise.finished.store(true, std::memory_order_release);
+        return next;
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  Task() = default;
+  ~Task() {
+    if (handle)
+      handle.destroy();
+  }
+  Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle)
+        handle.destroy();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  // awaited from another coroutine
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle.promise().continuation = awaiting;
+    return handle;
+  }
+  T await_resume() { return std::move(*handle.promise().value); }
+
+  // top level
+  void start() { handle.resume(); }
+  bool done() const { return handle && handle.promise().finished.load(std::memory_order_acquire); }
+  T& result() { return *handle.promise().value; }
+  explicit operator bool() const { return static_cast<bool>(handle); }
+
+private:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
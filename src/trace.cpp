@@ -0,0 +1,66 @@
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+  std::chrono::steady_clock::time_point traceOrigin() {
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return origin;
+  }
+}
+
+double traceTimeUs(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration<double, std::micro>(time - traceOrigin()).count();
+}
+
+double traceNowUs() {
+  return traceTimeUs(std::chrono::steady_clock::now());
+}
+
+std::string jsonEscape(const std::string& str) {
+  std::string result;
+  result.reserve(str.size());
+  for (char c : str) {
+    switch (c) {
+      case '"': result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\t': result += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          result += buffer;
+        } else {
+          result += c;
+        }
+    }
+  }
+  return result;
+}
+
+bool writeChromeTrace(const std::string& path, const std::vector<TraceEvent>& events,
+                      const std::vector<std::pair<uint32_t, std::string>>& threadNames) {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    std::cout << "ERROR::TRACE::CANNOT_WRITE " << path << std::endl;
+    return false;
+  }
+  char buffer[64];
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for (auto& thread : threadNames) {
+    file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first
+         << ",\"args\":{\"name\":\"" << jsonEscape(thread.second) << "\"}}";
+    first = false;
+  }
+  for (auto& event : events) {
+    std::snprintf(buffer, sizeof(buffer), "\"ts\":%.3f,\"dur\":%.3f", event.startUs, event.durationUs);
+    file << (first ? "" : ",\n") << "{\"name\":\"" << jsonEscape(event.name) << "\",\"cat\":\"" << jsonEscape(event.category)
+         << "\",\"ph\":\"X\"," << buffer << ",\"pid\":1,\"tid\":" << event.threadId << "}";
+    first = false;
+  }
+  file << "\n]}\n";
+  return file.good();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// trace: one complete ("ph":"X") event of a Chrome trace / Perfetto JSON file, times in microseconds
+struct TraceEvent {
+  std::string name;
+  std::string category;
+  double startUs;
+  double durationUs;
+  uint32_t threadId;
+};
+
+// trace: common time base of all profilers, microseconds since the first call
+// -----------------------------------
+double traceTimeUs(std::chrono::steady_clock::time_point time);
+double traceNowUs();
+
+// trace: escape a string for embedding in JSON
+// -----------------------------------
+std::string jsonEscape(const std::string& str);
+
+// trace: write events as Chrome trace JSON (open with chrome://tracing or ui.perfetto.dev)
+// threadNames optionally labels thread ids (e.g. {0, "main"})
+// -----------------------------------
+bool writeChromeTrace(const std::string& path, const std::vector<TraceEvent>& events,
+                      const std::vector<std::pair<uint32_t, std::string>>& threadNames = {});
@@ -0,0 +1,140 @@
+#include "vertex_compression.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+  int16_t toSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+  }
+
+  float fromSnorm16(int16_t value) {
+    return std::max(value / 32767.0f, -1.0f);
+  }
+
+  float sign(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+  }
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t bits = std::bit_cast<uint32_t>(value);
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  uint32_t magnitude = bits & 0x7FFFFFFFu;
+  if (magnitude >= 0x7F800000u)  // inf stays inf, NaN stays a (quiet) NaN
+    return sign | (magnitude > 0x7F800000u ? 0x7E00u : 0x7C00u);
+  if (magnitude >= 0x477FF000u)  // rounds to more than 65504
+    return sign | 0x7C00u;
+  if (magnitude < 0x38800000u) {
+    // subnormal half: shift the mantissa with its implicit bit into place, round to nearest even
+    if (magnitude < 0x33000000u)
+      return sign;
+    uint32_t exponent = magnitude >> 23;
+    uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+    uint32_t shift = 126 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1)))
+      half++;
+    return sign | static_cast<uint16_t>(half);
+  }
+  // normal half: rebias the exponent, round the 13 dropped mantissa bits to nearest even
+  uint32_t rebased = magnitude - 0x38000000u;
+  uint32_t half = rebased >> 13;
+  uint32_t rest = rebased & 0x1FFFu;
+  if (rest > 0x1000u || (rest == 0x1000u && (half & 1)))
+    half++;
+  return sign | static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value) {
+  uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+  uint32_t exponent = (value >> 10) & 0x1Fu;
+  uint32_t mantissa = value & 0x3FFu;
+  if (exponent == 0) {
+    float subnormal = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -subnormal : subnormal;
+  }
+  if (exponent == 31)
+    return std::bit_cast<float>(sign | 0x7F800000u | (mantissa << 13));
+  return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+void octahedralEncode(const float vector[3], int16_t encoded[2]) {
+  // project onto the octahedron |x| + |y| + |z| = 1, fold the lower half over the diagonals
+  float length = std::fabs(vector[0]) + std::fabs(vector[1]) + std::fabs(vector[2]);
+  if (length == 0.0f) {
+    encoded[0] = encoded[1] = 0;
+    return;
+  }
+  float x = vector[0] / length, y = vector[1] / length;
+  if (vector[2] < 0.0f) {
+    float foldedX = (1.0f - std::fabs(y)) * sign(x);
+    float foldedY = (1.0f - std::fabs(x)) * sign(y);
+    x = foldedX;
+    y = foldedY;
+  }
+  // of the four roundings around (x, y) keep the one that decodes closest to the input
+  float inputLength = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+  float bestError = -1.0f;
+  for (int corner = 0; corner < 4; corner++) {
+    int16_t candidate[2] = {
+      static_cast<int16_t>(std::clamp((corner & 1 ? std::ceil(x * 32767.0f) : std::floor(x * 32767.0f)), -32767.0f, 32767.0f)),
+      static_cast<int16_t>(std::clamp((corner & 2 ? std::ceil(y * 32767.0f) : std::floor(y * 32767.0f)), -32767.0f, 32767.0f))
+    };
+    float decoded[3];
+    octahedralDecode(candidate, decoded);
+    float error = 0.0f;
+    for (int i = 0; i < 3; i++)
+      error += std::fabs(decoded[i] - vector[i] / inputLength);
+    if (bestError < 0.0f || error < bestError) {
+      bestError = error;
+      encoded[0] = candidate[0];
+      encoded[1] = candidate[1];
+    }
+  }
+}
+
+void octahedralDecode(const int16_t encoded[2], float vector[3]) {
+  // same math as octahedralDecode in quad.vert
+  float x = fromSnorm16(encoded[0]), y = fromSnorm16(encoded[1]);
+  float z = 1.0f - std::fabs(x) - std::fabs(y);
+  float t = std::max(-z, 0.0f);
+  x += x >= 0.0f ? -t : t;
+  y += y >= 0.0f ? -t : t;
+  float length = std::sqrt(x * x + y * y + z * z);
+  vector[0] = x / length;
+  vector[1] = y / length;
+  vector[2] = z / length;
+}
+
+PositionDecode compressVertices(const MeshVertex* vertices, size_t count, CompressedVertex* out) {
+  float low[3] = {0.0f, 0.0f, 0.0f}, high[3] = {0.0f, 0.0f, 0.0f};
+  for (size_t i = 0; i < count; i++)
+    for (int axis = 0; axis < 3; axis++) {
+      low[axis] = i == 0 ? vertices[i].position[axis] : std::min(low[axis], vertices[i].position[axis]);
+      high[axis] = i == 0 ? vertices[i].position[axis] : std::max(high[axis], vertices[i].position[axis]);
+    }
+  PositionDecode decode;
+  float scale = 0.0f;
+  for (int axis = 0; axis < 3; axis++) {
+    decode[axis] = (low[axis] + high[axis]) * 0.5f;
+    scale = std::max(scale, (high[axis] - low[axis]) * 0.5f);
+  }
+  // a single point (or nothing) still needs a usable scale
+  decode[3] = scale > 0.0f ? scale : 1.0f;
+
+  for (size_t i = 0; i < count; i++) {
+    const MeshVertex& vertex = vertices[i];
+    CompressedVertex& compressed = out[i];
+    for (int axis = 0; axis < 3; axis++)
+      compressed.position.value[axis] = toSnorm16((vertex.position[axis] - decode[axis]) / decode[3]);
+    compressed.position.value[3] = vertex.tangent[3] < 0.0f ? -32767 : 32767;
+    octahedralEncode(vertex.normal, compressed.normal.value);
+    octahedralEncode(vertex.tangent, compressed.tangent.value);
+    compressed.uv.value[0] = floatToHalf(vertex.uv[0]);
+    compressed.uv.value[1] = floatToHalf(vertex.uv[1]);
+  }
+  return decode;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "vertex_layout.h"
+
+// full precision vertex as meshes are authored / loaded, 48 bytes
+struct MeshVertex {
+  float position[3];
+  float normal[3];
+  float tangent[4];  // w = bitangent sign
+  float uv[2];
+
+  static constexpr auto attributes() {
+    return std::array{VERTEX_ATTRIBUTE(MeshVertex, 0, position), VERTEX_ATTRIBUTE(MeshVertex, 1, normal),
+                      VERTEX_ATTRIBUTE(MeshVertex, 2, tangent), VERTEX_ATTRIBUTE(MeshVertex, 3, uv)};
+  }
+};
+
+// vertexCompression: the same vertex in 20 bytes, decoded in the vertex shader (quad.vert)
+//  - position: snorm16 relative to the mesh bounds, p = q.xyz * scale + center with one scale for all
+//    axes (the largest half extent), so the decode fits a single vec4 per draw; w holds the tangent sign
+//  - normal, tangent: octahedral encoding, snorm16 per component (under 0.04 degrees of error)
+//  - uv: half floats, exact up to 1/2048 across [0, 1]
+// -----------------------------------
+struct CompressedVertex {
+  Snorm16x4 position;
+  Snorm16x2 normal;
+  Snorm16x2 tangent;
+  Half2 uv;
+
+  static constexpr auto attributes() {
+    return std::array{VERTEX_ATTRIBUTE(CompressedVertex, 0, position), VERTEX_ATTRIBUTE(CompressedVertex, 1, normal),
+                      VERTEX_ATTRIBUTE(CompressedVertex, 2, tangent), VERTEX_ATTRIBUTE(CompressedVertex, 3, uv)};
+  }
+};
+
+// xyz = center, w = scale; the uPositionDecode uniform of quad.vert
+using PositionDecode = std::array<float, 4>;
+
+// compresses count vertices into out and returns the decode of their bounds
+PositionDecode compressVertices(const MeshVertex* vertices, size_t count, CompressedVertex* out);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+// unit vector -> 2 snorm16 components
+void octahedralEncode(const float vector[3], int16_t encoded[2]);
+void octahedralDecode(const int16_t encoded[2], float vector[3]);
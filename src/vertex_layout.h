@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <glad/glad.h>
+
+// vertexLayout: attribute formats, offsets and stride of a vertex struct, derived at compile time.
+// a vertex struct lists its attributes once, everything else follows from the member types:
+//   struct Vertex {
+//     float position[3];
+//     Snorm16x4 normal;
+//     static constexpr auto attributes() {
+//       return std::array{VERTEX_ATTRIBUTE(Vertex, 0, position), VERTEX_ATTRIBUTE(Vertex, 1, normal)};
+//     }
+//   };
+//   MegaBuffer geometry(vertexLayout<Vertex>(), ...);
+// a member type without a VERTEX_FORMAT, overlapping or misaligned attributes and duplicate locations
+// don't compile. a new packed format is one VERTEX_FORMAT line.
+// -----------------------------------
+
+// one vertex attribute of an interleaved vertex format
+struct VertexAttribute {
+  unsigned int index;
+  int components;
+  unsigned int type;
+  bool normalized;
+  unsigned int offset;
+};
+
+struct VertexLayout {
+  uint32_t stride;
+  std::span<const VertexAttribute> attributes;
+};
+
+struct VertexFormat {
+  int components;
+  unsigned int type;
+  bool normalized;
+};
+
+// packed attribute types, stored as raw bits
+struct Half2 { uint16_t value[2]; };
+struct Half4 { uint16_t value[4]; };
+struct Snorm16x2 { int16_t value[2]; };
+struct Snorm16x4 { int16_t value[4]; };
+struct Unorm8x4 { uint8_t value[4]; };
+struct Snorm10x3 { uint32_t value; };  // x, y, z in 10 bits each, w in the top 2 bits
+
+constexpr unsigned int vertexFormatSize(VertexFormat format) {
+  switch (format.type) {
+    case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: return 4u * format.components;
+    case GL_HALF_FLOAT: case GL_SHORT: case GL_UNSIGNED_SHORT: return 2u * format.components;
+    case GL_BYTE: case GL_UNSIGNED_BYTE: return 1u * format.components;
+    case GL_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: return 4u;
+    default: return 0u;
+  }
+}
+
+// member type -> attribute format; no specialization, no attribute
+template <typename T>
+struct VertexFormatOf;
+
+#define VERTEX_FORMAT(Type, components, type, normalized) \
+  template <> struct VertexFormatOf<Type> { \
+    static constexpr VertexFormat value = {components, type, normalized}; \
+    static_assert(sizeof(Type) == vertexFormatSize(value), "size of " #Type " doesn't match its vertex format"); \
+  };
+
+VERTEX_FORMAT(float, 1, GL_FLOAT, false)
+VERTEX_FORMAT(float[2], 2, GL_FLOAT, false)
+VERTEX_FORMAT(float[3], 3, GL_FLOAT, false)
+VERTEX_FORMAT(float[4], 4, GL_FLOAT, false)
+VERTEX_FORMAT(Half2, 2, GL_HALF_FLOAT, false)
+VERTEX_FORMAT(Half4, 4, GL_HALF_FLOAT, false)
+VERTEX_FORMAT(Snorm16x2, 2, GL_SHORT, true)
+VERTEX_FORMAT(Snorm16x4, 4, GL_SHORT, true)
+VERTEX_FORMAT(Unorm8x4, 4, GL_UNSIGNED_BYTE, true)
+VERTEX_FORMAT(Snorm10x3, 4, GL_INT_2_10_10_10_REV, true)
+
+#define VERTEX_ATTRIBUTE(Vertex, location, member) \
+  VertexAttribute{location, VertexFormatOf<decltype(Vertex::member)>::value.components, \
+                  VertexFormatOf<decltype(Vertex::member)>::value.type, VertexFormatOf<decltype(Vertex::member)>::value.normalized, \
+                  static_cast<unsigned int>(offsetof(Vertex, member))}
+
+namespace VertexLayoutCheck {
+  constexpr unsigned int MAX_LOCATIONS = 16;
+
+  template <size_t N>
+  constexpr bool uniqueLocations(const std::array<VertexAttribute, N>& attributes) {
+    for (size_t i = 0; i < N; i++) {
+      if (attributes[i].index >= MAX_LOCATIONS)
+        return false;
+      for (size_t j = i + 1; j < N; j++)
+        if (attributes[i].index == attributes[j].index)
+          return false;
+    }
+    return true;
+  }
+
+  // GL wants attribute offsets aligned to the component size, the 4.1 driver on macOS to 4 bytes
+  template <size_t N>
+  constexpr bool aligned(const std::array<VertexAttribute, N>& attributes) {
+    for (auto& attribute : attributes)
+      if (attribute.offset % 4 != 0)
+        return false;
+    return true;
+  }
+
+  template <size_t N>
+  constexpr bool inside(const std::array<VertexAttribute, N>& attributes, size_t stride) {
+    for (auto& attribute : attributes) {
+      unsigned int size = vertexFormatSize({attribute.components, attribute.type, attribute.normalized});
+      if (size == 0 || attribute.offset + size > stride)
+        return false;
+    }
+    return true;
+  }
+
+  template <size_t N>
+  constexpr bool disjoint(const std::array<VertexAttribute, N>& attributes) {
+    for (size_t i = 0; i < N; i++)
+      for (size_t j = i + 1; j < N; j++) {
+        unsigned int sizeI = vertexFormatSize({attributes[i].components, attributes[i].type, attributes[i].normalized});
+        unsigned int sizeJ = vertexFormatSize({attributes[j].components, attributes[j].type, attributes[j].normalized});
+        if (attributes[i].offset < attributes[j].offset + sizeJ && attributes[j].offset < attributes[i].offset + sizeI)
+          return false;
+      }
+    return true;
+  }
+}
+
+// the checked attribute list of a vertex struct, instantiated once per type
+template <typename Vertex>
+struct VertexLayoutOf {
+  static_assert(std::is_standard_layout_v<Vertex> && std::is_trivially_copyable_v<Vertex>,
+                "vertex structs are uploaded as bytes and need standard layout for offsetof");
+  static constexpr auto attributes = Vertex::attributes();
+  static_assert(sizeof(Vertex) % 4 == 0, "vertex stride must be a multiple of 4 bytes");
+  static_assert(VertexLayoutCheck::uniqueLocations(attributes), "attribute locations must be unique and below 16");
+  static_assert(VertexLayoutCheck::aligned(attributes), "attribute offsets must be 4 byte aligned");
+  static_assert(VertexLayoutCheck::inside(attributes, sizeof(Vertex)), "attribute reaches past the end of the vertex");
+  static_assert(VertexLayoutCheck::disjoint(attributes), "attributes overlap");
+};
+
+template <typename Vertex>
+constexpr VertexLayout vertexLayout() {
+  return {static_cast<uint32_t>(sizeof(Vertex)), VertexLayoutOf<Vertex>::attributes};
+}
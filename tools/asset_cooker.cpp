@@ -0,0 +1,547 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cooked_mesh.h"
+#include "gltf_loader.h"
+#include "job_system.h"
+#include "mesh_optimizer.h"
+#include "vertex_compression.h"
+// tinygltf's implementation is compiled into opengl_core (gltf_loader.cpp)
+#include "tiny_gltf.h"
+
+// asset_cooker: turns a glTF scene (.gltf or .glb) into the cooked binary format of cooked_mesh.h, so
+// the app loads it without parsing anything. per mesh:
+//  - primitives are decoded to MeshVertex (missing normals computed, area weighted) and go through the
+//    mesh optimizer
+//  - LODs by vertex clustering, each with at most half the triangles of the one before, until
+//    MAX_LODS, LOD_MIN_TRIANGLES or a grid that doesn't reduce any further
+//  - meshlets of LOD 0
+//  - all primitives of the mesh are compressed together, they share one position decode
+// every step is a job: a primitive's LODs and meshlets wait for its optimized mesh, a mesh's
+// compression for all of its primitives; the file is put together in scene order afterwards, so the
+// output only depends on the worker count through the optimizer's block split.
+// the build cooks every glTF file in assets/ into ${CMAKE_BINARY_DIR}/cooked (the cook target).
+//
+// usage: asset_cooker [--jobs N] <input.gltf|input.glb> <output.cmesh>
+namespace {
+  constexpr unsigned int MAX_LODS = 4;
+  constexpr size_t LOD_MIN_TRIANGLES = 64;
+  constexpr unsigned int MAX_GRID = 1024;
+
+  using Matrix = std::array<float, 16>;
+
+  // column major, a * b
+  Matrix multiply(const Matrix& a, const Matrix& b) {
+    Matrix result;
+    for (int column = 0; column < 4; column++)
+      for (int row = 0; row < 4; row++) {
+        float sum = 0.0f;
+        for (int k = 0; k < 4; k++)
+          sum += a[k * 4 + row] * b[column * 4 + k];
+        result[column * 4 + row] = sum;
+      }
+    return result;
+  }
+
+  float readComponent(const uint8_t* data, int componentType, bool normalized) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+      float value;
+      std::memcpy(&value, data, sizeof(value));
+      return value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return normalized ? data[0] / 255.0f : data[0];
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      return normalized ? std::max(static_cast<int8_t>(data[0]) / 127.0f, -1.0f) : static_cast<int8_t>(data[0]);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return normalized ? value / 65535.0f : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+      int16_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+      uint32_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return static_cast<float>(value);
+    }
+    }
+    return 0.0f;
+  }
+
+  // the first element of an accessor and its byte stride, nullptr when the accessor doesn't fit its
+  // buffer view or the view its buffer
+  const uint8_t* accessorData(const tinygltf::Model& model, int accessorIndex, int& stride) {
+    if (accessorIndex < 0 || accessorIndex >= static_cast<int>(model.accessors.size()))
+      return nullptr;
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    if (accessor.sparse.isSparse || accessor.bufferView < 0 || accessor.bufferView >= static_cast<int>(model.bufferViews.size()))
+      return nullptr;
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size()))
+      return nullptr;
+    const std::vector<unsigned char>& buffer = model.buffers[view.buffer].data;
+    stride = accessor.ByteStride(view);
+    int element = tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+    // count is bounded by division, a huge one would overflow byteOffset + (count - 1) * stride
+    if (stride <= 0 || element <= 0 || accessor.count == 0 || view.byteOffset > buffer.size() ||
+        view.byteLength > buffer.size() - view.byteOffset || accessor.byteOffset > view.byteLength ||
+        view.byteLength - accessor.byteOffset < static_cast<size_t>(element) ||
+        accessor.count > (view.byteLength - accessor.byteOffset - element) / stride + 1)
+      return nullptr;
+    return buffer.data() + view.byteOffset + accessor.byteOffset;
+  }
+
+  // up to components floats of each element into the float array at member of each vertex; false when
+  // the accessor is missing, unreadable or has another count than the vertices
+  bool readAttribute(const tinygltf::Model& model, int accessorIndex, int components, std::vector<MeshVertex>& vertices, size_t member) {
+    int stride = 0;
+    const uint8_t* data = accessorData(model, accessorIndex, stride);
+    if (!data)
+      return false;
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    if (accessor.count != vertices.size())
+      return false;
+    int available = std::min(components, tinygltf::GetNumComponentsInType(accessor.type));
+    int size = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    for (size_t i = 0; i < accessor.count; i++) {
+      float* target = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(&vertices[i]) + member);
+      for (int c = 0; c < available; c++)
+        target[c] = readComponent(data + i * stride + c * size, accessor.componentType, accessor.normalized);
+    }
+    return true;
+  }
+
+  // read as integers, a float only holds them exactly up to 2^24
+  bool readIndices(const tinygltf::Model& model, int accessorIndex, size_t vertexCount, std::vector<uint32_t>& indices) {
+    int stride = 0;
+    const uint8_t* data = accessorData(model, accessorIndex, stride);
+    if (!data)
+      return false;
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    int componentType = accessor.componentType;
+    if (componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+        componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+      return false;
+    indices.resize(accessor.count / 3 * 3);
+    for (size_t i = 0; i < indices.size(); i++) {
+      const uint8_t* element = data + i * stride;
+      if (componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        indices[i] = element[0];
+      } else if (componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        uint16_t value;
+        std::memcpy(&value, element, sizeof(value));
+        indices[i] = value;
+      } else {
+        std::memcpy(&indices[i], element, sizeof(uint32_t));
+      }
+      if (indices[i] >= vertexCount)
+        return false;
+    }
+    return true;
+  }
+
+  void computeNormals(std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices) {
+    for (MeshVertex& vertex : vertices)
+      std::fill(std::begin(vertex.normal), std::end(vertex.normal), 0.0f);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const float* a = vertices[indices[i]].position;
+      const float* b = vertices[indices[i + 1]].position;
+      const float* c = vertices[indices[i + 2]].position;
+      float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+      // twice the triangle's area long, so larger triangles weigh more
+      float normal[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+      for (size_t k = 0; k < 3; k++)
+        for (int axis = 0; axis < 3; axis++)
+          vertices[indices[i + k]].normal[axis] += normal[axis];
+    }
+  }
+
+  void normalize(float* vector) {
+    float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+    if (length > 0.0f) {
+      for (int axis = 0; axis < 3; axis++)
+        vector[axis] /= length;
+    } else {
+      vector[0] = 0.0f;
+      vector[1] = 0.0f;
+      vector[2] = 1.0f;
+    }
+  }
+
+  struct CookedPrimitive {
+    bool valid = false;     // false when skipped, warning says why
+    std::string warning;
+    std::vector<MeshVertex> vertices;
+    uint32_t vertexCount = 0;
+    bool shortIndices = false;
+    std::vector<uint32_t> indices;  // LOD 0
+    // LOD 1 and coarser
+    std::vector<std::vector<uint32_t>> lods;
+    std::vector<float> errors;
+    MeshOptimizer::Meshlets meshlets;
+    uint32_t material = 0;
+    bool blend = false;
+  };
+
+  struct CookedMeshVertices {
+    std::vector<CookedPrimitive> primitives;
+    std::vector<CompressedVertex> vertices;
+    CookedMesh::Mesh entry = {0, 0, {0, 0, 0, 1}, {}, {}};
+  };
+
+  // decoded, normals fixed up and optimized; LOD 0 only
+  void cookPrimitive(const tinygltf::Model& model, const tinygltf::Mesh& mesh, const tinygltf::Primitive& source,
+                     JobSystem& jobs, CookedPrimitive& primitive) {
+    if (source.mode != TINYGLTF_MODE_TRIANGLES && source.mode != -1) {
+      primitive.warning = "WARNING::GLTF::UNSUPPORTED_MODE " + std::to_string(source.mode) + " in mesh " + mesh.name;
+      return;
+    }
+    auto attribute = [&](const char* name) {
+      auto found = source.attributes.find(name);
+      return found != source.attributes.end() ? found->second : -1;
+    };
+    int position = attribute("POSITION");
+    if (position < 0 || position >= static_cast<int>(model.accessors.size()))
+      return;
+    // the count is only trusted once the accessor fits its buffer
+    int positionStride = 0;
+    if (!accessorData(model, position, positionStride)) {
+      primitive.warning = "WARNING::GLTF::INVALID_ACCESSOR in mesh " + mesh.name;
+      return;
+    }
+    std::vector<MeshVertex> decoded(model.accessors[position].count, MeshVertex{{0, 0, 0}, {0, 0, 0}, {1, 0, 0, 1}, {0, 0}});
+    std::vector<uint32_t> sourceIndices;
+    if (!readAttribute(model, position, 3, decoded, offsetof(MeshVertex, position)) ||
+        (source.indices >= 0 && !readIndices(model, source.indices, decoded.size(), sourceIndices))) {
+      primitive.warning = "WARNING::GLTF::INVALID_ACCESSOR in mesh " + mesh.name;
+      return;
+    }
+    if (source.indices < 0) {
+      sourceIndices.resize(decoded.size() / 3 * 3);
+      for (size_t i = 0; i < sourceIndices.size(); i++)
+        sourceIndices[i] = static_cast<uint32_t>(i);
+    }
+    if (sourceIndices.empty())
+      return;
+    if (!readAttribute(model, attribute("NORMAL"), 3, decoded, offsetof(MeshVertex, normal)))
+      computeNormals(decoded, sourceIndices);
+    readAttribute(model, attribute("TANGENT"), 4, decoded, offsetof(MeshVertex, tangent));
+    readAttribute(model, attribute("TEXCOORD_0"), 2, decoded, offsetof(MeshVertex, uv));
+    for (MeshVertex& vertex : decoded) {
+      normalize(vertex.normal);
+      normalize(vertex.tangent);
+    }
+
+    MeshOptimizer::Mesh optimized = MeshOptimizer::optimize(decoded.data(), static_cast<uint32_t>(decoded.size()), sizeof(MeshVertex),
+                                                            offsetof(MeshVertex, position), sourceIndices.data(), sourceIndices.size(), &jobs);
+    const MeshVertex* first = reinterpret_cast<const MeshVertex*>(optimized.vertices.data());
+    primitive.vertices.assign(first, first + optimized.vertexCount);
+    primitive.vertexCount = optimized.vertexCount;
+    primitive.shortIndices = optimized.shortIndices();
+    if (primitive.shortIndices)
+      primitive.indices.assign(optimized.indices16.begin(), optimized.indices16.end());
+    else
+      primitive.indices = std::move(optimized.indices);
+    primitive.material = source.material >= 0 && source.material < static_cast<int>(model.materials.size())
+      ? static_cast<uint32_t>(source.material) : static_cast<uint32_t>(model.materials.size());
+    primitive.blend = primitive.material < model.materials.size() && model.materials[primitive.material].alphaMode == "BLEND";
+    primitive.valid = true;
+  }
+
+  // each level is the finest grid with at most half the triangles of the level before, binary searched
+  // since fewer cells give fewer triangles; all levels simplify LOD 0, errors don't add up
+  void buildLods(CookedPrimitive& primitive) {
+    primitive.lods.reserve(MAX_LODS - 1);
+    const std::vector<uint32_t>& full = primitive.indices;
+    const MeshVertex* vertices = primitive.vertices.data();
+    size_t vertexCount = primitive.vertices.size();
+    float low[3] = {INFINITY, INFINITY, INFINITY}, high[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t index : full)
+      for (int axis = 0; axis < 3; axis++) {
+        low[axis] = std::min(low[axis], vertices[index].position[axis]);
+        high[axis] = std::max(high[axis], vertices[index].position[axis]);
+      }
+    float extent = std::max({high[0] - low[0], high[1] - low[1], high[2] - low[2]});
+    std::vector<uint32_t> scratch(full.size());
+    unsigned int previousGrid = MAX_GRID + 1;
+    auto coarsest = [&]() -> const std::vector<uint32_t>& { return primitive.lods.empty() ? full : primitive.lods.back(); };
+    while (primitive.lods.size() + 1 < MAX_LODS && coarsest().size() / 3 >= LOD_MIN_TRIANGLES) {
+      size_t target = coarsest().size() / 6 * 3;
+      std::vector<uint32_t> best;
+      unsigned int bestGrid = 0;
+      // a coarser level needs a coarser grid
+      unsigned int lower = 1, upper = previousGrid - 1;
+      while (lower <= upper) {
+        unsigned int grid = (lower + upper) / 2;
+        size_t count = MeshOptimizer::simplifyClusters(scratch.data(), full.data(), full.size(), vertices, vertexCount,
+                                                       sizeof(MeshVertex), offsetof(MeshVertex, position), grid);
+        if (count <= target) {
+          best.assign(scratch.begin(), scratch.begin() + count);
+          bestGrid = grid;
+          lower = grid + 1;
+        } else {
+          upper = grid - 1;
+        }
+      }
+      if (best.empty())
+        break;
+      previousGrid = bestGrid;
+      MeshOptimizer::optimizeVertexCache(best.data(), best.size(), vertexCount);
+      primitive.lods.push_back(std::move(best));
+      // a vertex moves at most across its cell
+      primitive.errors.push_back(extent / bestGrid * std::sqrt(3.0f));
+    }
+  }
+
+  template <typename T>
+  void append(std::vector<uint8_t>& bytes, const T* data, size_t count) {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+    bytes.insert(bytes.end(), begin, begin + count * sizeof(T));
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned int workers = 0;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--jobs" && i + 1 < argc)
+      workers = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else
+      paths.push_back(arg);
+  }
+  if (paths.size() != 2) {
+    std::cout << "usage: asset_cooker [--jobs N] <input.gltf|input.glb> <output" << CookedMesh::EXTENSION << ">" << std::endl;
+    return 2;
+  }
+  std::string input = paths[0], output = paths[1];
+  auto start = std::chrono::steady_clock::now();
+
+  tinygltf::Model model;
+  tinygltf::TinyGLTF loader;
+  std::string error, warning;
+  bool binary = input.size() >= 4 && input.compare(input.size() - 4, 4, ".glb") == 0;
+  bool loaded = binary ? loader.LoadBinaryFromFile(&model, &error, &warning, input) : loader.LoadASCIIFromFile(&model, &error, &warning, input);
+  if (!warning.empty())
+    std::cout << "WARNING::GLTF " << warning << std::endl;
+  if (!loaded) {
+    std::cout << "ERROR::ASSET_COOKER::LOAD_FAILED " << input << "\n" << error << std::endl;
+    return 1;
+  }
+  size_t sourceBytes = 0;
+  for (const tinygltf::Buffer& buffer : model.buffers)
+    sourceBytes += buffer.data.size();
+
+  // meshes
+  // ------
+  // slots are sized before any job starts, jobs only write their own
+  JobSystem jobs(workers);
+  std::vector<CookedMeshVertices> cooked(model.meshes.size());
+  std::vector<JobSystem::JobHandle> meshJobs;
+  for (size_t m = 0; m < model.meshes.size(); m++) {
+    const tinygltf::Mesh& mesh = model.meshes[m];
+    CookedMeshVertices& target = cooked[m];
+    target.primitives.resize(mesh.primitives.size());
+    std::vector<JobSystem::JobHandle> primitiveJobs;
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+      CookedPrimitive& primitive = target.primitives[p];
+      JobSystem::JobHandle optimized = jobs.submit([&model, &mesh, &jobs, &primitive, p] { cookPrimitive(model, mesh, mesh.primitives[p], jobs, primitive); });
+      primitiveJobs.push_back(jobs.submit([&primitive] {
+        if (primitive.valid)
+          buildLods(primitive);
+      }, {optimized}));
+      primitiveJobs.push_back(jobs.submit([&primitive] {
+        if (primitive.valid)
+          primitive.meshlets = MeshOptimizer::buildMeshlets(primitive.indices.data(), primitive.indices.size(), primitive.vertices.data(),
+                                                            primitive.vertices.size(), sizeof(MeshVertex), offsetof(MeshVertex, position));
+      }, {optimized}));
+    }
+    // one position decode for the whole mesh; the full vertices go once LODs and meshlets are done with them
+    meshJobs.push_back(jobs.submit([&target] {
+      std::vector<MeshVertex> meshVertices;
+      for (CookedPrimitive& primitive : target.primitives) {
+        meshVertices.insert(meshVertices.end(), primitive.vertices.begin(), primitive.vertices.end());
+        primitive.vertices = {};
+      }
+      if (meshVertices.empty())
+        return;
+      target.vertices.resize(meshVertices.size());
+      PositionDecode decode = compressVertices(meshVertices.data(), meshVertices.size(), target.vertices.data());
+      std::copy(decode.begin(), decode.end(), target.entry.positionDecode);
+      for (int axis = 0; axis < 3; axis++) {
+        target.entry.boundsMin[axis] = INFINITY;
+        target.entry.boundsMax[axis] = -INFINITY;
+      }
+      for (const MeshVertex& vertex : meshVertices)
+        for (int axis = 0; axis < 3; axis++) {
+          target.entry.boundsMin[axis] = std::min(target.entry.boundsMin[axis], vertex.position[axis]);
+          target.entry.boundsMax[axis] = std::max(target.entry.boundsMax[axis], vertex.position[axis]);
+        }
+    }, primitiveJobs));
+  }
+  for (const JobSystem::JobHandle& job : meshJobs)
+    jobs.wait(job);
+
+  std::vector<CompressedVertex> vertices;
+  std::vector<uint8_t> indices;
+  std::vector<CookedMesh::Mesh> meshes;
+  std::vector<CookedMesh::Primitive> primitives;
+  std::vector<CookedMesh::Lod> lods;
+  std::vector<CookedMesh::Meshlet> meshlets;
+  std::vector<uint32_t> meshletVertices;
+  std::vector<uint8_t> meshletTriangles;
+  size_t triangles = 0;
+  for (CookedMeshVertices& mesh : cooked) {
+    CookedMesh::Mesh target = mesh.entry;
+    target.firstPrimitive = static_cast<uint32_t>(primitives.size());
+    size_t baseVertex = vertices.size();
+    vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    mesh.vertices = {};
+
+    for (const CookedPrimitive& primitive : mesh.primitives) {
+      if (!primitive.warning.empty())
+        std::cout << primitive.warning << std::endl;
+      if (!primitive.valid)
+        continue;
+      target.primitiveCount++;
+      CookedMesh::Primitive entry = {};
+      entry.baseVertex = static_cast<uint32_t>(baseVertex);
+      entry.vertexCount = primitive.vertexCount;
+      entry.firstLod = static_cast<uint32_t>(lods.size());
+      entry.lodCount = static_cast<uint32_t>(primitive.lods.size() + 1);
+      entry.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+      entry.meshletCount = static_cast<uint32_t>(primitive.meshlets.meshlets.size());
+      entry.material = primitive.material;
+      entry.flags = (primitive.shortIndices ? CookedMesh::PRIMITIVE_SHORT_INDICES : 0) | (primitive.blend ? CookedMesh::PRIMITIVE_BLEND : 0);
+      primitives.push_back(entry);
+      baseVertex += primitive.vertexCount;
+      triangles += primitive.indices.size() / 3;
+
+      for (size_t level = 0; level <= primitive.lods.size(); level++) {
+        const std::vector<uint32_t>& levelIndices = level == 0 ? primitive.indices : primitive.lods[level - 1];
+        indices.resize((indices.size() + 3) / 4 * 4);
+        lods.push_back({indices.size(), static_cast<uint32_t>(levelIndices.size()), level == 0 ? 0.0f : primitive.errors[level - 1]});
+        if (primitive.shortIndices) {
+          std::vector<uint16_t> narrow(levelIndices.begin(), levelIndices.end());
+          append(indices, narrow.data(), narrow.size());
+        } else {
+          append(indices, levelIndices.data(), levelIndices.size());
+        }
+      }
+
+      for (const MeshOptimizer::Meshlet& meshlet : primitive.meshlets.meshlets) {
+        CookedMesh::Meshlet entry = {static_cast<uint32_t>(meshletVertices.size() + meshlet.vertexOffset),
+                                     static_cast<uint32_t>(meshletTriangles.size() + meshlet.triangleOffset),
+                                     meshlet.vertexCount, meshlet.triangleCount, {}, meshlet.radius, {}, meshlet.coneCutoff};
+        std::copy_n(meshlet.center, 3, entry.center);
+        std::copy_n(meshlet.coneAxis, 3, entry.coneAxis);
+        meshlets.push_back(entry);
+      }
+      meshletVertices.insert(meshletVertices.end(), primitive.meshlets.vertices.begin(), primitive.meshlets.vertices.end());
+      meshletTriangles.insert(meshletTriangles.end(), primitive.meshlets.triangles.begin(), primitive.meshlets.triangles.end());
+    }
+    meshes.push_back(target);
+  }
+
+  // nodes
+  // -----
+  // matrices take the position decode along, the vertex shader doesn't need one per draw
+  std::vector<GltfScene::Node> sceneNodes = GltfScene::flattenNodes(model);
+  if (sceneNodes.empty()) {
+    std::cout << "ERROR::ASSET_COOKER::EMPTY_SCENE " << input << std::endl;
+    return 1;
+  }
+  std::vector<CookedMesh::Node> nodes;
+  std::vector<float> nodeMatrices;
+  float boundsMin[3] = {}, boundsMax[3] = {};
+  bool bounded = false;
+  for (const GltfScene::Node& node : sceneNodes) {
+    nodes.push_back({node.parent, node.mesh});
+    Matrix matrix = node.world;
+    if (node.mesh >= 0) {
+      const CookedMesh::Mesh& mesh = meshes[node.mesh];
+      const float* decode = mesh.positionDecode;
+      matrix = multiply(node.world, {decode[3], 0, 0, 0, 0, decode[3], 0, 0, 0, 0, decode[3], 0, decode[0], decode[1], decode[2], 1});
+      for (int corner = 0; corner < 8 && mesh.primitiveCount > 0; corner++) {
+        float local[3];
+        for (int axis = 0; axis < 3; axis++)
+          local[axis] = corner & (1 << axis) ? mesh.boundsMax[axis] : mesh.boundsMin[axis];
+        for (int axis = 0; axis < 3; axis++) {
+          float world = node.world[axis] * local[0] + node.world[4 + axis] * local[1] + node.world[8 + axis] * local[2] + node.world[12 + axis];
+          boundsMin[axis] = bounded ? std::min(boundsMin[axis], world) : world;
+          boundsMax[axis] = bounded ? std::max(boundsMax[axis], world) : world;
+        }
+        bounded = true;
+      }
+    }
+    nodeMatrices.insert(nodeMatrices.end(), matrix.begin(), matrix.end());
+  }
+  std::vector<float> materials = GltfScene::packMaterials(model);
+
+  // file
+  // ----
+  std::vector<uint8_t> bytes(sizeof(CookedMesh::Header));
+  CookedMesh::Header header = {};
+  header.magic = CookedMesh::MAGIC;
+  header.version = CookedMesh::VERSION;
+  header.vertexStride = sizeof(CompressedVertex);
+  std::copy_n(boundsMin, 3, header.boundsMin);
+  std::copy_n(boundsMax, 3, header.boundsMax);
+  auto section = [&](CookedMesh::Section section, const void* data, size_t size) {
+    bytes.resize(CookedMesh::alignSection(bytes.size()));
+    header.sections[section] = {bytes.size(), size};
+    append(bytes, static_cast<const uint8_t*>(data), size);
+  };
+  section(CookedMesh::Vertices, vertices.data(), vertices.size() * sizeof(CompressedVertex));
+  section(CookedMesh::Indices, indices.data(), indices.size());
+  section(CookedMesh::Meshes, meshes.data(), meshes.size() * sizeof(CookedMesh::Mesh));
+  section(CookedMesh::Primitives, primitives.data(), primitives.size() * sizeof(CookedMesh::Primitive));
+  section(CookedMesh::Lods, lods.data(), lods.size() * sizeof(CookedMesh::Lod));
+  section(CookedMesh::Meshlets, meshlets.data(), meshlets.size() * sizeof(CookedMesh::Meshlet));
+  section(CookedMesh::MeshletVertices, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+  section(CookedMesh::MeshletTriangles, meshletTriangles.data(), meshletTriangles.size());
+  section(CookedMesh::Materials, materials.data(), materials.size() * sizeof(float));
+  section(CookedMesh::NodeMatrices, nodeMatrices.data(), nodeMatrices.size() * sizeof(float));
+  section(CookedMesh::Nodes, nodes.data(), nodes.size() * sizeof(CookedMesh::Node));
+  header.fileSize = bytes.size();
+  std::memcpy(bytes.data(), &header, sizeof(header));
+
+  // write to a temporary file and rename, a failed or interrupted cook never leaves a truncated file
+  // behind that the cook target would take as up to date
+  std::string tmpOutput = output + ".tmp";
+  bool written;
+  {
+    std::ofstream file(tmpOutput, std::ios::binary | std::ios::trunc);
+    written = file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())).good();
+    file.close();
+    written = written && file.good();
+  }
+  std::error_code ec;
+  if (written)
+    std::filesystem::rename(tmpOutput, output, ec);
+  if (!written || ec) {
+    std::filesystem::remove(tmpOutput, ec);
+    std::cout << "ERROR::ASSET_COOKER::CANNOT_WRITE " << output << std::endl;
+    return 1;
+  }
+  double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "asset_cooker " << input << " -> " << output << ": " << meshes.size() << " meshes, " << primitives.size()
+            << " primitives, " << triangles << " triangles, " << lods.size() - primitives.size() << " LODs, " << meshlets.size()
+            << " meshlets, " << sourceBytes / (1024.0 * 1024.0) << " -> " << bytes.size() / (1024.0 * 1024.0) << " MB in "
+            << milliseconds << " ms" << std::endl;
+  return 0;
+}
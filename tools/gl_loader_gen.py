@@ -0,0 +1,315 @@
+#!/usr/bin/env python3
+"""GL loader generator working on top of the glad 0.1.36 output in lib/glad.
+
+usage:
+  gl_loader_gen.py trim <glad.h> <glad.c> <out.c> <sources...>
+      core-profile loader that only contains the gl* entry points and GLAD_GL_*
+      flags the given sources reference; fails on gl* calls glad doesn't know
+  gl_loader_gen.py lazy <glad.h> <out glad_lazy.c>
+      trampolines for lazy on-first-call resolution (GLAD_LAZY_LOAD), the
+      checked in lib/glad/src/glad_lazy.c is generated with
+      python3 tools/gl_loader_gen.py lazy lib/glad/include/glad/glad.h lib/glad/src/glad_lazy.c
+"""
+import re
+import sys
+
+GROUP_RE = re.compile(r'^static void load_(GL_\w+)\(GLADloadproc load\) \{\n(.*?)^\}', re.M | re.S)
+GROUP_LOAD_RE = re.compile(r'glad_(\w+) = \(PFN\w+PROC\)load\("\w+"\);')
+FLAG_RE = re.compile(r'^GLAPI int GLAD_(GL_\w+);$', re.M)
+SOURCE_CALL_RE = re.compile(r'\b(gl[A-Z]\w*)\s*\(')
+SOURCE_NAME_RE = re.compile(r'\b(gl[A-Z]\w*)\b')
+SOURCE_FLAG_RE = re.compile(r'\bGLAD_(GL_\w+)\b')
+COMMENT_RE = re.compile(r'//[^\n]*|/\*.*?\*/', re.S)
+TYPEDEF_RE = re.compile(r'^typedef (.+?) \(APIENTRYP (PFN\w+PROC)\)\((.*)\);$', re.M)
+POINTER_RE = re.compile(r'^GLAPI (PFN\w+PROC) glad_(\w+);$', re.M)
+
+
+class GLFunction:
+    def __init__(self, name, pfn, ret, params):
+        self.name = name
+        self.pfn = pfn
+        self.ret = ret.strip()
+        self.params = params.strip()
+
+    def arg_names(self):
+        if self.params in ('', 'void'):
+            return []
+        # the parameter name is always the last identifier of a declaration
+        return [re.findall(r'\w+', p)[-1] for p in self.params.split(',')]
+
+    def returns_void(self):
+        return self.ret == 'void'
+
+
+def fnv1a(name):
+    hash = 2166136261
+    for c in name.encode():
+        hash = ((hash ^ c) * 16777619) & 0xFFFFFFFF
+    return hash
+
+
+def parse_header(path):
+    with open(path) as f:
+        header = f.read()
+    typedefs = {pfn: (ret, params) for ret, pfn, params in TYPEDEF_RE.findall(header)}
+    functions = []
+    for pfn, name in POINTER_RE.findall(header):
+        ret, params = typedefs[pfn]
+        functions.append(GLFunction(name, pfn, ret, params))
+    return functions
+
+
+def parse_groups(path):
+    """load_GL_* groups of the generated glad.c: {group: [function names]}"""
+    with open(path) as f:
+        source = f.read()
+    return {group: GROUP_LOAD_RE.findall(body) for group, body in GROUP_RE.findall(source)}
+
+
+def parse_flags(path):
+    with open(path) as f:
+        return FLAG_RE.findall(f.read())
+
+
+def scan_sources(paths, known):
+    """gl* functions and GLAD_GL_* flags referenced by the sources (comments stripped)"""
+    used, flags, errors = set(), set(), []
+    for path in paths:
+        with open(path, encoding='utf-8', errors='replace') as f:
+            source = f.read()
+        # blank comments but keep newlines so error line numbers stay right
+        source = COMMENT_RE.sub(lambda m: re.sub(r'[^\n]', ' ', m.group(0)), source)
+        for match in SOURCE_NAME_RE.finditer(source):
+            if match.group(1) in known:
+                used.add(match.group(1))
+        for match in SOURCE_CALL_RE.finditer(source):
+            if match.group(1) not in known:
+                line = source.count('\n', 0, match.start()) + 1
+                errors.append('%s:%d: error: %s is not a GL entry point the loader can provide' % (path, line, match.group(1)))
+        flags.update(SOURCE_FLAG_RE.findall(source))
+    return used, flags, errors
+
+
+def write_trampolines(out, functions):
+    for fn in functions:
+        args = ', '.join(fn.arg_names())
+        out.write('static %s APIENTRY glad_lazy_%s(%s) {\n' % (fn.ret, fn.name, fn.params or 'void'))
+        out.write('    glad_%s = (%s)glad_lazy_resolve("%s");\n' % (fn.name, fn.pfn, fn.name))
+        if fn.returns_void():
+            out.write('    glad_%s(%s);\n' % (fn.name, args))
+        else:
+            out.write('    return glad_%s(%s);\n' % (fn.name, args))
+        out.write('}\n')
+
+
+LAZY_COMMENT = """/*
+    Lazy GL function resolution, generated by tools/gl_loader_gen.py - do not edit.
+
+    With GLAD_LAZY_LOAD defined, gladLoadGLLoader hands glad_lazy_trampoline to the
+    load_GL_* groups instead of the real loader, so every function pointer of an
+    available version/extension starts out as a trampoline. The first call
+    resolves the real entry point through glad_lazy_loader, patches the pointer
+    and forwards the call; later calls go straight to the driver.
+    Concurrent first calls from several threads resolve the same pointer twice,
+    which is harmless.
+*/
+"""
+
+
+def write_lazy_section(out, functions):
+    functions = sorted(functions, key=lambda fn: fn.name)
+    assert len(functions) < 65536
+    out.write('#ifdef GLAD_LAZY_LOAD\n')
+    out.write('#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n#include <glad/glad.h>\n\n')
+    out.write('extern GLADloadproc glad_lazy_loader;\n\n')
+    out.write('static void* glad_lazy_resolve(const char *name) {\n')
+    out.write('    void *proc = glad_lazy_loader(name);\n')
+    out.write('    if(proc == NULL) {\n')
+    out.write('        fprintf(stderr, "glad: %s is not provided by the driver\\n", name);\n')
+    out.write('        abort();\n')
+    out.write('    }\n')
+    out.write('    return proc;\n')
+    out.write('}\n\n')
+    write_trampolines(out, functions)
+    # open addressing table (FNV-1a, linear probing) built here, so the lookup
+    # per load() call is a hash plus one strcmp in the common case
+    size = 16
+    while size < len(functions) * 2:
+        size *= 2
+    slots = [0] * size
+    for index, fn in enumerate(functions):
+        slot = fnv1a(fn.name) & (size - 1)
+        while slots[slot] != 0:
+            slot = (slot + 1) & (size - 1)
+        slots[slot] = index + 1
+    out.write('\nstruct glad_lazy_entry { const char *name; void *proc; };\n')
+    out.write('static const struct glad_lazy_entry glad_lazy_table[] = {\n')
+    for fn in functions:
+        out.write('    {"%s", (void*)glad_lazy_%s},\n' % (fn.name, fn.name))
+    out.write('};\n\n')
+    out.write('/* 1-based indices into glad_lazy_table, 0 marks an empty slot */\n')
+    out.write('static const unsigned short glad_lazy_slots[%d] = {\n' % size)
+    for row in range(0, size, 16):
+        out.write('    %s,\n' % ', '.join(str(v) for v in slots[row:row + 16]))
+    out.write('};\n\n')
+    out.write('void* glad_lazy_trampoline(const char *name) {\n')
+    out.write('    unsigned int hash = 2166136261u;\n')
+    out.write('    const char *c;\n')
+    out.write('    for(c = name; *c != \'\\0\'; c++) {\n')
+    out.write('        hash ^= (unsigned char)*c;\n')
+    out.write('        hash *= 16777619u;\n')
+    out.write('    }\n')
+    out.write('    hash &= %du;\n' % (size - 1))
+    out.write('    while(glad_lazy_slots[hash] != 0) {\n')
+    out.write('        const struct glad_lazy_entry *entry = &glad_lazy_table[glad_lazy_slots[hash] - 1];\n')
+    out.write('        if(strcmp(entry->name, name) == 0) return entry->proc;\n')
+    out.write('        hash = (hash + 1) & %du;\n' % (size - 1))
+    out.write('    }\n')
+    out.write('    return NULL;\n')
+    out.write('}\n')
+    out.write('#endif /* GLAD_LAZY_LOAD */\n')
+
+
+def write_lazy_source(path, functions):
+    with open(path, 'w') as out:
+        out.write(LAZY_COMMENT)
+        write_lazy_section(out, functions)
+
+
+TRIM_PROLOGUE = """/*
+    Trimmed core-profile GL loader, generated by tools/gl_loader_gen.py - do not edit.
+
+    Only contains the %(functions)d entry points and %(extensions)d extension flags
+    the project sources reference (out of %(total)d in lib/glad). Uses the
+    glad.h declarations, so code keeps calling gl* exactly as with the full loader;
+    a gl* call glad doesn't know fails the generator, and a function that is not
+    defined here fails the link.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+
+struct gladGLversionStruct GLVersion = { 0, 0 };
+
+"""
+
+TRIM_LOADER = """
+static int find_coreGL(void) {
+    int major = 0, minor = 0;
+    const char *version = (const char*)glGetString(GL_VERSION);
+    if(version == NULL) return 0;
+    /* core contexts report "major.minor[.release] vendor info" */
+    major = atoi(version);
+    while(*version >= '0' && *version <= '9') version++;
+    if(*version == '.') minor = atoi(version + 1);
+    GLVersion.major = major; GLVersion.minor = minor;
+%(versions)s    /* glGetStringi and GL_NUM_EXTENSIONS need 3.0, core profiles start at 3.2 */
+    return major >= 3;
+}
+
+/* sorted, so each driver extension costs one binary search */
+struct glad_ext_flag { const char *name; int *flag; };
+static const struct glad_ext_flag glad_ext_flags[] = {
+%(ext_table)s    {NULL, NULL}
+};
+
+static void find_extensionsGL(void) {
+    const int num_flags = (int)(sizeof(glad_ext_flags) / sizeof(glad_ext_flags[0])) - 1;
+    int num_exts = 0, index;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_exts);
+    for(index = 0; index < num_exts && num_flags > 0; index++) {
+        const char *ext = (const char*)glGetStringi(GL_EXTENSIONS, index);
+        int lo = 0, hi = num_flags;
+        if(ext == NULL) continue;
+        while(lo < hi) {
+            int mid = (lo + hi) / 2;
+            int cmp = strcmp(glad_ext_flags[mid].name, ext);
+            if(cmp == 0) { *glad_ext_flags[mid].flag = 1; break; }
+            if(cmp < 0) lo = mid + 1; else hi = mid;
+        }
+    }
+}
+
+#ifdef GLAD_LAZY_LOAD
+void* glad_lazy_trampoline(const char *name);
+GLADloadproc glad_lazy_loader = NULL;
+#endif
+
+int gladLoadGLLoader(GLADloadproc load) {
+#ifdef GLAD_LAZY_LOAD
+    glad_lazy_loader = load;
+    load = (GLADloadproc)glad_lazy_trampoline;
+#endif
+    GLVersion.major = 0; GLVersion.minor = 0;
+    glad_glGetString = (PFNGLGETSTRINGPROC)load("glGetString");
+    glad_glGetIntegerv = (PFNGLGETINTEGERVPROC)load("glGetIntegerv");
+    glad_glGetStringi = (PFNGLGETSTRINGIPROC)load("glGetStringi");
+    if(glad_glGetString == NULL || glad_glGetIntegerv == NULL || glad_glGetStringi == NULL) return 0;
+    if(!find_coreGL()) return 0;
+    find_extensionsGL();
+%(loads)s    return 1;
+}
+"""
+
+
+def write_trimmed_source(path, functions, groups, flags, used, used_flags):
+    by_name = {fn.name: fn for fn in functions}
+    # the loader itself always needs these three
+    used = set(used) | {'glGetString', 'glGetIntegerv', 'glGetStringi'}
+    versions = sorted(f for f in flags if f.startswith('GL_VERSION_'))
+    extensions = set(f for f in used_flags if not f.startswith('GL_VERSION_'))
+    loads = []
+    for group, names in groups.items():
+        group_names = [n for n in names if n in used]
+        if not group_names:
+            continue
+        if not group.startswith('GL_VERSION_'):
+            extensions.add(group)
+        loads.append((group, group_names))
+    extensions = sorted(extensions)
+
+    with open(path, 'w') as out:
+        out.write(TRIM_PROLOGUE % {'functions': len(used), 'extensions': len(extensions), 'total': len(functions)})
+        for flag in versions + extensions:
+            out.write('int GLAD_%s = 0;\n' % flag)
+        out.write('\n')
+        for name in sorted(used):
+            out.write('%s glad_%s = NULL;\n' % (by_name[name].pfn, name))
+
+        version_lines = ''
+        for flag in versions:
+            major, minor = flag[len('GL_VERSION_'):].split('_')
+            version_lines += '    GLAD_%s = (major == %s && minor >= %s) || major > %s;\n' % (flag, major, minor, major)
+        ext_table = ''.join('    {"%s", &GLAD_%s},\n' % (ext, ext) for ext in extensions)
+        load_lines = ''
+        for group, names in loads:
+            load_lines += '    if(GLAD_%s) {\n' % group
+            for name in names:
+                load_lines += '        glad_%s = (%s)load("%s");\n' % (name, by_name[name].pfn, name)
+            load_lines += '    }\n'
+        out.write(TRIM_LOADER % {'versions': version_lines, 'ext_table': ext_table, 'loads': load_lines})
+        out.write('\n')
+        write_lazy_section(out, [by_name[name] for name in used])
+
+
+def main(argv):
+    if len(argv) >= 5 and argv[1] == 'trim':
+        functions = parse_header(argv[2])
+        known = set(fn.name for fn in functions)
+        used, used_flags, errors = scan_sources(argv[5:], known)
+        unknown_flags = sorted(set(used_flags) - set(parse_flags(argv[2])))
+        errors += ['error: GLAD_%s is not a flag glad knows' % flag for flag in unknown_flags]
+        if errors:
+            sys.stderr.write('\n'.join(errors) + '\n')
+            return 1
+        write_trimmed_source(argv[4], functions, parse_groups(argv[3]), parse_flags(argv[2]), used, used_flags)
+        return 0
+    if len(argv) == 4 and argv[1] == 'lazy':
+        write_lazy_source(argv[3], parse_header(argv[2]))
+        return 0
+    sys.stderr.write(__doc__)
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))